@@ -1,8 +1,13 @@
 #include <benchmark/benchmark.h>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <immintrin.h>
 #include <iostream>
+#include <memory>
 #include <random>
 #include <thread>
 #include <vector>
@@ -10,6 +15,13 @@
 #include "thread_pool.h"
 
 #include "image_convolver.h" // Твой заголовочный файл
+#include "frame_stream.h"
+#include "median_filter.h"
+#include "perf_counters.h"
+#include "blur_client.h"
+#include "blur_daemon.h"
+#include "process_shard.h"
+#include "recursive_gaussian.h"
 
 namespace {
 constexpr int64_t kMinBenchmarkIterations = 1;
@@ -53,6 +65,74 @@ std::vector<unsigned char> generateRandomImage(int w, int h) {
     return img;
 }
 
+// Перцентиль по выборке (q в диапазоне [0, 1]), выборка сортируется на месте
+double percentile(std::vector<double>& samples, double q) {
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    size_t idx = static_cast<size_t>(q * static_cast<double>(samples.size() - 1) + 0.5);
+    return samples[std::min(idx, samples.size() - 1)];
+}
+
+// Аппаратные счетчики включаются переменной окружения BLUR_PERF_COUNTERS=1
+bool perfCountersEnabled() {
+    static const bool enabled = []() {
+        const char* value = std::getenv("BLUR_PERF_COUNTERS");
+        return value != nullptr && std::strcmp(value, "0") != 0;
+    }();
+    return enabled;
+}
+
+// Снимает аппаратные счетчики на время жизни объекта (весь цикл замера)
+// и выгружает их в state.counters в пересчете на одну итерацию.
+// Если счетчики недоступны (контейнер, нет прав), выставляет perf_available=0.
+class PerfCounterScope {
+public:
+    explicit PerfCounterScope(benchmark::State& state) : m_state(state) {
+        if (!perfCountersEnabled()) return;
+
+        m_counters = std::make_unique<PerfCounters>();
+        if (!m_counters->available()) {
+            static bool warned = false;
+            if (!warned) {
+                std::cerr << "perf_event_open unavailable, hardware counters disabled" << std::endl;
+                warned = true;
+            }
+            m_counters.reset();
+            m_state.counters["perf_available"] = 0;
+            return;
+        }
+        m_counters->start();
+    }
+
+    ~PerfCounterScope() {
+        if (!m_counters) return;
+        m_counters->stop();
+        PerfCounters::Values v = m_counters->read();
+
+        for (int e = 0; e < PerfCounters::EventCount; ++e) {
+            if (v.valid[e]) {
+                m_state.counters[PerfCounters::event_name(static_cast<PerfCounters::Event>(e))] =
+                    benchmark::Counter(static_cast<double>(v.value[e]), benchmark::Counter::kAvgIterations);
+            }
+        }
+        if (v.valid[PerfCounters::Cycles] && v.valid[PerfCounters::Instructions] && v.value[PerfCounters::Cycles] > 0) {
+            m_state.counters["IPC"] = static_cast<double>(v.value[PerfCounters::Instructions]) /
+                                      static_cast<double>(v.value[PerfCounters::Cycles]);
+        }
+        // Оценка трафика памяти: каждый промах LLC - одна 64-байтная линия из DRAM
+        if (v.valid[PerfCounters::LLCMisses]) {
+            m_state.counters["llc_miss_bw"] =
+                benchmark::Counter(static_cast<double>(v.value[PerfCounters::LLCMisses]) * 64.0,
+                                   benchmark::Counter::kIsRate, benchmark::Counter::kIs1024);
+        }
+        m_state.counters["perf_available"] = 1;
+    }
+
+private:
+    benchmark::State& m_state;
+    std::unique_ptr<PerfCounters> m_counters;
+};
+
 // Класс-фикстура, чтобы подготовить данные один раз перед серией замеров
 class BlurFixture : public benchmark::Fixture {
 public:
@@ -88,6 +168,7 @@ public:
 
 // 1. Бенчмарк для DEFAULT (обычный C++)
 BENCHMARK_DEFINE_F(BlurFixture, BM_ProcessDefault)(benchmark::State& state) {
+    PerfCounterScope perf(state);
     const int64_t batch = kMinBenchmarkIterations;
     while (state.KeepRunningBatch(batch)) {
         for (int64_t i = 0; i < batch; ++i) {
@@ -107,6 +188,7 @@ BENCHMARK_DEFINE_F(BlurFixture, BM_ProcessDefault)(benchmark::State& state) {
 
 // 2. Бенчмарк для SIMD (AVX-512)
 BENCHMARK_DEFINE_F(BlurFixture, BM_ProcessSIMD)(benchmark::State& state) {
+    PerfCounterScope perf(state);
     const int64_t batch = kMinBenchmarkIterations;
     while (state.KeepRunningBatch(batch)) {
         for (int64_t i = 0; i < batch; ++i) {
@@ -120,6 +202,7 @@ BENCHMARK_DEFINE_F(BlurFixture, BM_ProcessSIMD)(benchmark::State& state) {
 
 // 3. Бенчмарк для ThreadPool (многопоточная версия)
 BENCHMARK_DEFINE_F(BlurFixture, BM_ProcessThreadPool)(benchmark::State& state) {
+    PerfCounterScope perf(state);
     size_t threads = static_cast<size_t>(state.range(2));
     const int64_t batch = kMinBenchmarkIterations;
     while (state.KeepRunningBatch(batch)) {
@@ -134,6 +217,7 @@ BENCHMARK_DEFINE_F(BlurFixture, BM_ProcessThreadPool)(benchmark::State& state) {
 
 // 4. Бенчмарк для ThreadPool (задача на каждую строку)
 BENCHMARK_DEFINE_F(BlurFixture, BM_ProcessThreadPoolFull)(benchmark::State& state) {
+    PerfCounterScope perf(state);
     size_t threads = static_cast<size_t>(state.range(2));
     const int64_t batch = kMinBenchmarkIterations;
     while (state.KeepRunningBatch(batch)) {
@@ -164,6 +248,751 @@ static void BM_ThreadPoolOverhead(benchmark::State& state) {
     state.SetItemsProcessed(total_iters);
 }
 
+// 6. Смешанная нагрузка на общем пуле: большое изображение 4096x4096 с ядром 9x9
+// (process_thread_pool_full, задача на строку - 4096 задач в очереди) крутится в фоне,
+// а замеряется задержка маленьких запросов 64x64. Маленький запрос ставится не раньше
+// чем через kLargeJobAge после старта большого: в очереди остаются тысячи строк,
+// поставленных больше 100 мс назад, и маленький запрос должен обогнать их
+// независимо от их возраста.
+// range(0) -> 0: все задачи Normal (поведение FIFO), 1: маленькие High, большие Low
+static void BM_PriorityMixedLatency(benchmark::State& state) {
+    const bool use_priority = state.range(0) != 0;
+    const int large_size = 4096;
+    const int large_kernel = 9;
+    const int small_size = 64;
+    const int small_kernel = 3;
+    constexpr auto kLargeJobAge = std::chrono::milliseconds(150);
+
+    std::vector<unsigned char> large_img = generateRandomImage(large_size, large_size);
+    std::vector<unsigned char> small_img = generateRandomImage(small_size, small_size);
+    ImageConvolver large_conv(generateKernel(large_kernel), large_kernel, large_kernel);
+    ImageConvolver small_conv(generateKernel(small_kernel), small_kernel, small_kernel);
+
+    const TaskPriority large_priority = use_priority ? TaskPriority::Low : TaskPriority::Normal;
+    const TaskPriority small_priority = use_priority ? TaskPriority::High : TaskPriority::Normal;
+
+    using Clock = std::chrono::steady_clock;
+    ThreadPool pool(0);
+    std::atomic<bool> stop{false};
+    // Момент старта текущего большого задания (0 - задание еще не запущено)
+    std::atomic<Clock::rep> large_started{0};
+    std::thread background([&]() {
+        while (!stop.load(std::memory_order_relaxed)) {
+            large_started = Clock::now().time_since_epoch().count();
+            std::vector<unsigned char> res =
+                large_conv.process_thread_pool_full(pool, large_img.data(), large_size, large_size, large_priority);
+            benchmark::DoNotOptimize(res.data());
+        }
+    });
+
+    std::vector<double> latencies_us;
+    const int64_t batch = kMinBenchmarkIterations;
+    while (state.KeepRunningBatch(batch)) {
+        for (int64_t i = 0; i < batch; ++i) {
+            // Ждем, пока текущее большое задание не "постареет"
+            state.PauseTiming();
+            while (large_started.load() == 0 ||
+                   Clock::now() - Clock::time_point(Clock::duration(large_started.load())) < kLargeJobAge) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            state.ResumeTiming();
+
+            auto start = Clock::now();
+            std::vector<unsigned char> res =
+                small_conv.process_thread_pool(pool, small_img.data(), small_size, small_size, small_priority);
+            auto stop_time = Clock::now();
+            benchmark::DoNotOptimize(res.data());
+            latencies_us.push_back(std::chrono::duration<double, std::micro>(stop_time - start).count());
+        }
+    }
+
+    stop = true;
+    background.join();
+
+    state.counters["small_p50_us"] = percentile(latencies_us, 0.50);
+    state.counters["small_p99_us"] = percentile(latencies_us, 0.99);
+    state.counters["small_max_us"] = percentile(latencies_us, 1.0);
+    state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+}
+
+// 7. Поток кадров: пересчет только измененной области против полного process_SIMD.
+// range(0) -> размер кадра, range(1) -> размер ядра,
+// range(2) -> доля измененных пикселей в процентах,
+// range(3) -> 0: прямоугольники передаются явно, 1: поиск изменений сравнением кадров,
+//             2: полная обработка process_SIMD (эталон)
+static void BM_FrameStreamDirty(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int kDim = static_cast<int>(state.range(1));
+    const double ratio = static_cast<double>(state.range(2)) / 100.0;
+    const int mode = static_cast<int>(state.range(3));
+
+    std::vector<unsigned char> frame = generateRandomImage(size, size);
+    std::vector<float> kernel = generateKernel(kDim);
+    ImageConvolver convolver(kernel, kDim, kDim);
+    FrameStreamConvolver stream(kernel, kDim, kDim);
+    stream.process_frame(frame.data(), size, size);
+
+    // Квадрат нужной площади, сдвигающийся от кадра к кадру
+    const int side = std::max(1, static_cast<int>(std::sqrt(ratio) * size));
+    const int span = std::max(1, size - side + 1);
+    int64_t frame_idx = 0;
+    double fraction_sum = 0.0;
+
+    const int64_t batch = kMinBenchmarkIterations;
+    while (state.KeepRunningBatch(batch)) {
+        for (int64_t i = 0; i < batch; ++i) {
+            DirtyRect rect;
+            rect.x = static_cast<int>((frame_idx * 37) % span);
+            rect.y = static_cast<int>((frame_idx * 53) % span);
+            rect.w = side;
+            rect.h = side;
+            ++frame_idx;
+            for (int y = rect.y; y < rect.y + rect.h; ++y) {
+                for (int x = rect.x; x < rect.x + rect.w; ++x) {
+                    frame[(static_cast<size_t>(y) * size + x) * 4] += 1;
+                }
+            }
+
+            if (mode == 2) {
+                std::vector<unsigned char> res = convolver.process_SIMD(frame.data(), size, size);
+                benchmark::DoNotOptimize(res.data());
+                fraction_sum += 1.0;
+            } else {
+                const std::vector<unsigned char>& res = (mode == 0)
+                    ? stream.process_frame(frame.data(), size, size, {rect})
+                    : stream.process_frame(frame.data(), size, size);
+                benchmark::DoNotOptimize(res.data());
+                fraction_sum += stream.last_recomputed_fraction();
+            }
+        }
+    }
+
+    const int64_t total_iters = static_cast<int64_t>(state.iterations());
+    state.counters["recomputed_fraction"] = total_iters > 0 ? fraction_sum / static_cast<double>(total_iters) : 0.0;
+    state.SetItemsProcessed(total_iters);
+}
+
+// Прореживание в 2 раза "как сейчас": полная свертка process_SIMD, затем выбрасываем 3 из 4 пикселей
+std::vector<unsigned char> blurThenSubsample(ImageConvolver& convolver, const unsigned char* img, int w, int h,
+                                             int& out_w, int& out_h) {
+    std::vector<unsigned char> full = convolver.process_SIMD(img, w, h);
+    out_w = (w + 1) / 2;
+    out_h = (h + 1) / 2;
+    std::vector<unsigned char> out(static_cast<size_t>(out_w) * out_h * 4);
+    for (int y = 0; y < out_h; ++y) {
+        for (int x = 0; x < out_w; ++x) {
+            std::memcpy(&out[(y * out_w + x) * 4], &full[((2 * y) * w + 2 * x) * 4], 4);
+        }
+    }
+    return out;
+}
+
+// 8. Гауссова пирамида до стороны 16.
+// range(0) -> размер картинки, range(1) -> размер ядра,
+// range(2) -> 0: process_SIMD + прореживание на каждом уровне,
+//             1: build_pyramid в 1 поток, 2: build_pyramid на всех ядрах
+static void BM_GaussianPyramid(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int kDim = static_cast<int>(state.range(1));
+    const int mode = static_cast<int>(state.range(2));
+    const int min_size = 16;
+
+    std::vector<unsigned char> img = generateRandomImage(size, size);
+    ImageConvolver convolver(generateKernel(kDim), kDim, kDim);
+
+    const int64_t batch = kMinBenchmarkIterations;
+    while (state.KeepRunningBatch(batch)) {
+        for (int64_t i = 0; i < batch; ++i) {
+            if (mode == 0) {
+                std::vector<unsigned char> level(img);
+                int lw = size;
+                int lh = size;
+                while ((lw + 1) / 2 >= min_size && (lh + 1) / 2 >= min_size) {
+                    int nw = 0;
+                    int nh = 0;
+                    level = blurThenSubsample(convolver, level.data(), lw, lh, nw, nh);
+                    lw = nw;
+                    lh = nh;
+                }
+                benchmark::DoNotOptimize(level.data());
+            } else {
+                std::vector<PyramidLevel> levels =
+                    convolver.build_pyramid(img.data(), size, size, min_size, mode == 1 ? 1 : 0);
+                benchmark::DoNotOptimize(levels.data());
+            }
+        }
+    }
+    const int64_t total_iters = static_cast<int64_t>(state.iterations());
+    state.SetBytesProcessed(total_iters * int64_t(size) * int64_t(size) * 4);
+}
+
+// 9. Свертка в исходном формате: 1 канал против 4, 8/16 бит и float.
+// range(0) -> размер картинки, range(1) -> размер ядра
+template<typename T, int C>
+static void BM_ProcessNative(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int kDim = static_cast<int>(state.range(1));
+
+    std::vector<T> img(static_cast<size_t>(size) * size * C);
+    for (size_t i = 0; i < img.size(); ++i) {
+        img[i] = static_cast<T>(i % 256);
+    }
+    ImageConvolver convolver(generateKernel(kDim), kDim, kDim);
+
+    PerfCounterScope perf(state);
+    const int64_t batch = kMinBenchmarkIterations;
+    while (state.KeepRunningBatch(batch)) {
+        for (int64_t i = 0; i < batch; ++i) {
+            std::vector<T> res = convolver.process_native<T, C>(img.data(), size, size);
+            benchmark::DoNotOptimize(res.data());
+        }
+    }
+    // bytes_per_second учитывает реальный размер пикселя, items_per_second - пиксели
+    const int64_t total_iters = static_cast<int64_t>(state.iterations());
+    state.SetBytesProcessed(total_iters * int64_t(size) * int64_t(size) * C * int64_t(sizeof(T)));
+    state.SetItemsProcessed(total_iters * int64_t(size) * int64_t(size));
+}
+
+// 10. Накладные расходы метрик: SIMD-свертка без реестра (0) и с реестром (1).
+// range(0) -> размер картинки, range(1) -> размер ядра, range(2) -> режим
+static void BM_MetricsOverhead(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int kDim = static_cast<int>(state.range(1));
+    const bool withMetrics = state.range(2) != 0;
+
+    std::vector<unsigned char> img = generateRandomImage(size, size);
+    ImageConvolver convolver(generateKernel(kDim), kDim, kDim);
+    MetricsRegistry metrics;
+    if (withMetrics) {
+        convolver.set_metrics(&metrics);
+    }
+
+    const int64_t batch = kMinBenchmarkIterations;
+    while (state.KeepRunningBatch(batch)) {
+        for (int64_t i = 0; i < batch; ++i) {
+            std::vector<unsigned char> res = convolver.process_SIMD(img.data(), size, size);
+            benchmark::DoNotOptimize(res.data());
+        }
+    }
+    const int64_t total_iters = static_cast<int64_t>(state.iterations());
+    state.SetBytesProcessed(total_iters * int64_t(size) * int64_t(size) * 4);
+
+    if (withMetrics) {
+        HistogramSnapshot convolve = metrics.histogram(MetricStage::Convolve, MetricVariant::SIMD,
+                                                       MetricsRegistry::size_bucket(size, size)).snapshot();
+        state.counters["p50_us"] = convolve.quantile_ns(0.5) * 1e-3;
+        state.counters["p99_us"] = convolve.quantile_ns(0.99) * 1e-3;
+        state.counters["p999_us"] = convolve.quantile_ns(0.999) * 1e-3;
+    }
+}
+
+// Пиковая производительность одного ядра на FMA AVX-512 (FLOP/s), измеряется один раз.
+// 12 независимых цепочек перекрывают задержку FMA на обоих портах;
+// берется лучший из нескольких замеров, чтобы отсечь вытеснение потока.
+double measureFmaPeakFlops() {
+    static const double peak = []() {
+        constexpr int kChains = 12;
+        constexpr int64_t kIters = 5000000;
+        constexpr int kRuns = 5;
+        const __m512 mul = _mm512_set1_ps(0.999999f);
+        const __m512 add = _mm512_set1_ps(1e-6f);
+
+        double best = 0.0;
+        for (int run = 0; run < kRuns; ++run) {
+            __m512 acc[kChains];
+            for (int j = 0; j < kChains; ++j) {
+                acc[j] = _mm512_set1_ps(static_cast<float>(j));
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            for (int64_t i = 0; i < kIters; ++i) {
+                for (int j = 0; j < kChains; ++j) {
+                    acc[j] = _mm512_fmadd_ps(acc[j], mul, add);
+                }
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            __m512 sum = acc[0];
+            for (int j = 1; j < kChains; ++j) {
+                sum = _mm512_add_ps(sum, acc[j]);
+            }
+            benchmark::DoNotOptimize(sum);
+            // 16 линий * 2 операции (умножение + сложение) на FMA
+            best = std::max(best, static_cast<double>(kIters) * kChains * 16 * 2 / seconds);
+        }
+        return best;
+    }();
+    return peak;
+}
+
+// 11. Достигнутые FLOP/s: process_SIMD (0) против блочного микроядра (1), в процентах от пика FMA.
+// Считаются FMA всех 16 линий (альфа вычисляется и затем перезаписывается),
+// т.е. 2 * kDim^2 * 4 операций на внутренний пиксель.
+// range(0) -> размер картинки, range(1) -> размер ядра, range(2) -> режим
+static void BM_MicrokernelFlops(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int kDim = static_cast<int>(state.range(1));
+    const bool blocked = state.range(2) != 0;
+
+    std::vector<unsigned char> img = generateRandomImage(size, size);
+    ImageConvolver convolver(generateKernel(kDim), kDim, kDim);
+    const double peak = measureFmaPeakFlops();
+
+    PerfCounterScope perf(state);
+    const auto start = std::chrono::steady_clock::now();
+    const int64_t batch = kMinBenchmarkIterations;
+    while (state.KeepRunningBatch(batch)) {
+        for (int64_t i = 0; i < batch; ++i) {
+            std::vector<unsigned char> res = blocked ? convolver.process_SIMD_blocked(img.data(), size, size)
+                                                     : convolver.process_SIMD(img.data(), size, size);
+            benchmark::DoNotOptimize(res.data());
+        }
+    }
+    const int64_t total_iters = static_cast<int64_t>(state.iterations());
+    state.SetBytesProcessed(total_iters * int64_t(size) * int64_t(size) * 4);
+
+    const int inner = std::max(size - 2 * (kDim / 2), 0);
+    const double flopsPerIter = 2.0 * kDim * kDim * 4 * static_cast<double>(inner) * inner;
+    state.counters["FLOPS"] = benchmark::Counter(flopsPerIter * static_cast<double>(total_iters),
+                                                 benchmark::Counter::kIsRate);
+    // Доля от пика одного ядра (вариант однопоточный)
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (seconds > 0.0 && peak > 0.0) {
+        state.counters["peak_pct"] = 100.0 * flopsPerIter * static_cast<double>(total_iters) / seconds / peak;
+    }
+}
+
+// 12. Устойчивая обработка потока кадров: размытие + прореживание в 2 раза на кадр.
+// Режим 0 - новые std::vector на каждый кадр, 1 - пул буферов, 2 - пул с огромными страницами (THP).
+// range(0) -> размер картинки, range(1) -> размер ядра, range(2) -> режим
+static void BM_FrameBufferPool(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int kDim = static_cast<int>(state.range(1));
+    const int mode = static_cast<int>(state.range(2));
+
+    std::vector<unsigned char> img = generateRandomImage(size, size);
+    ImageConvolver convolver(generateKernel(kDim), kDim, kDim);
+    BufferPool pool(mode == 2 ? BufferPool::HugePages::Transparent : BufferPool::HugePages::None);
+
+    // Вход тоже лежит в выровненном буфере пула
+    PooledBuffer input = pool.acquire(img.size());
+    std::copy(img.begin(), img.end(), input.data());
+
+    PerfCounterScope perf(state);
+    const int64_t batch = kMinBenchmarkIterations;
+    while (state.KeepRunningBatch(batch)) {
+        for (int64_t i = 0; i < batch; ++i) {
+            int ow = 0;
+            int oh = 0;
+            if (mode == 0) {
+                std::vector<unsigned char> blurred = convolver.process_SIMD(img.data(), size, size);
+                std::vector<unsigned char> half = convolver.process_decimate(blurred.data(), size, size, 2, ow, oh);
+                benchmark::DoNotOptimize(half.data());
+            } else {
+                PooledBuffer blurred = convolver.process_SIMD(pool, input.data(), size, size);
+                PooledBuffer half = convolver.process_decimate(pool, blurred.data(), size, size, 2, ow, oh);
+                benchmark::DoNotOptimize(half.data());
+            }
+        }
+    }
+    const int64_t total_iters = static_cast<int64_t>(state.iterations());
+    state.SetBytesProcessed(total_iters * int64_t(size) * int64_t(size) * 4);
+
+    if (mode != 0) {
+        BufferPool::Stats stats = pool.stats();
+        state.counters["pool_misses"] = static_cast<double>(stats.misses);
+        state.counters["huge_allocations"] = static_cast<double>(stats.huge_allocations);
+    }
+}
+
+// 13. Полосы строк в рабочих процессах (разделяемая память) против потоков одного процесса.
+// Режим 0 - ThreadPool, 1 - ProcessShardConvolver; полосы, SIMD-ядро и число исполнителей одинаковы,
+// вход уже лежит в общем буфере, поэтому разница - только накладные расходы синхронизации.
+// range(0) -> размер картинки, range(1) -> размер ядра, range(2) -> режим
+static void BM_ProcessSharding(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int kDim = static_cast<int>(state.range(1));
+    const int mode = static_cast<int>(state.range(2));
+    const size_t workers = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+    std::vector<unsigned char> img = generateRandomImage(size, size);
+    std::vector<float> kernel = generateKernel(kDim);
+    ImageConvolver convolver(kernel, kDim, kDim);
+
+    ThreadPool pool(workers);
+    std::vector<unsigned char> out(img.size());
+    std::vector<RowRange> strips = ImageConvolver::split_rows(0, size, workers);
+
+    std::unique_ptr<ProcessShardConvolver> sharded;
+    if (mode == 1) {
+        sharded = std::make_unique<ProcessShardConvolver>(kernel, kDim, kDim, workers);
+        std::copy(img.begin(), img.end(), sharded->input_buffer(size, size));
+    }
+
+    const int64_t batch = kMinBenchmarkIterations;
+    while (state.KeepRunningBatch(batch)) {
+        for (int64_t i = 0; i < batch; ++i) {
+            if (mode == 0) {
+                std::vector<std::future<void>> futures;
+                futures.reserve(strips.size());
+                for (const RowRange& rows : strips) {
+                    futures.emplace_back(pool.dispatch_task([&, rows]() {
+                        convolver.process_region(img.data(), size, size, out.data(), 0, rows.begin, size, rows.end);
+                    }));
+                }
+                for (auto& future : futures) {
+                    future.get();
+                }
+                benchmark::DoNotOptimize(out.data());
+            } else {
+                benchmark::DoNotOptimize(sharded->run());
+            }
+        }
+    }
+    const int64_t total_iters = static_cast<int64_t>(state.iterations());
+    state.SetBytesProcessed(total_iters * int64_t(size) * int64_t(size) * 4);
+    state.counters["workers"] = static_cast<double>(workers);
+}
+
+// 14. Генератор нагрузки на демон свертки: clients соединений, у каждого одно задание в полете
+// (изображение в разделяемой памяти). Итерация - раунд: все клиенты отправляют, затем ждут ответы,
+// поэтому демон видит одновременные запросы и обрабатывает их пачкой.
+// range(0) -> размер картинки, range(1) -> размер ядра, range(2) -> число клиентов
+static void BM_DaemonLoad(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int kDim = static_cast<int>(state.range(1));
+    const int clients = static_cast<int>(state.range(2));
+
+    BlurDaemon::Options options;
+    options.socket_path = "/tmp/blurd_bench_" +
+                          std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".sock";
+    std::unique_ptr<BlurDaemon> daemon;
+    try {
+        daemon = std::make_unique<BlurDaemon>(options);
+    } catch (const std::exception& e) {
+        state.SkipWithError(e.what());
+        return;
+    }
+    std::thread server([&daemon]() { daemon->run(); });
+
+    std::vector<float> kernel = generateKernel(kDim);
+    std::vector<unsigned char> img = generateRandomImage(size, size);
+    std::vector<std::unique_ptr<BlurClient>> connections;
+    std::vector<std::unique_ptr<SharedImage>> images;
+    for (int c = 0; c < clients; ++c) {
+        connections.push_back(std::make_unique<BlurClient>(options.socket_path));
+        images.push_back(std::make_unique<SharedImage>(size, size));
+        std::copy(img.begin(), img.end(), images.back()->input());
+    }
+
+    std::vector<double> latencies_us;
+    uint64_t batched = 0;
+    std::vector<std::chrono::steady_clock::time_point> sent(clients);
+    const int64_t batch = kMinBenchmarkIterations;
+    while (state.KeepRunningBatch(batch)) {
+        for (int64_t i = 0; i < batch; ++i) {
+            for (int c = 0; c < clients; ++c) {
+                sent[c] = std::chrono::steady_clock::now();
+                connections[c]->submit_shared(kernel, kDim, *images[c]);
+            }
+            for (int c = 0; c < clients; ++c) {
+                BlurJobReply reply = connections[c]->wait_reply();
+                auto done = std::chrono::steady_clock::now();
+                latencies_us.push_back(std::chrono::duration<double, std::micro>(done - sent[c]).count());
+                batched += reply.batch_size;
+                if (reply.status != BlurJobStatus::Ok) {
+                    state.SkipWithError("daemon job failed");
+                }
+            }
+            benchmark::DoNotOptimize(images[0]->output());
+        }
+    }
+
+    connections.clear();
+    daemon->stop();
+    server.join();
+
+    const int64_t total_iters = static_cast<int64_t>(state.iterations());
+    state.SetItemsProcessed(total_iters * clients);
+    state.SetBytesProcessed(total_iters * clients * int64_t(size) * int64_t(size) * 4);
+    if (!latencies_us.empty()) {
+        std::sort(latencies_us.begin(), latencies_us.end());
+        state.counters["lat_p50_us"] = latencies_us[latencies_us.size() / 2];
+        state.counters["lat_p99_us"] = latencies_us[std::min(latencies_us.size() - 1, latencies_us.size() * 99 / 100)];
+        state.counters["avg_batch"] = static_cast<double>(batched) / static_cast<double>(latencies_us.size());
+    }
+}
+
+// 15. Сложение симметричных тапов: process_SIMD (0) против process_folded (1).
+// Ядро 0 - гауссово (сепарабельное, два одномерных прохода), 1 - 2 * гауссово минус box
+// (симметричное, но ранга 2: двумерный проход с четверками тапов).
+// range(0) -> размер картинки, range(1) -> размер ядра, range(2) -> ядро, range(3) -> режим
+static void BM_SymmetricFolding(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int kDim = static_cast<int>(state.range(1));
+    const int kind = static_cast<int>(state.range(2));
+    const int mode = static_cast<int>(state.range(3));
+
+    std::vector<float> kernel = generateKernel(kDim);
+    if (kind == 1) {
+        for (float& v : kernel) {
+            v = 2.f * v - 1.f / static_cast<float>(kDim * kDim);
+        }
+    }
+    std::vector<unsigned char> img = generateRandomImage(size, size);
+    ImageConvolver convolver(kernel, kDim, kDim);
+
+    const int64_t batch = kMinBenchmarkIterations;
+    while (state.KeepRunningBatch(batch)) {
+        for (int64_t i = 0; i < batch; ++i) {
+            std::vector<unsigned char> out = (mode == 0) ? convolver.process_SIMD(img.data(), size, size)
+                                                         : convolver.process_folded(img.data(), size, size);
+            benchmark::DoNotOptimize(out.data());
+        }
+    }
+    const int64_t total_iters = static_cast<int64_t>(state.iterations());
+    state.SetBytesProcessed(total_iters * int64_t(size) * int64_t(size) * 4);
+    state.counters["mults_per_px"] = static_cast<double>(mode == 0 ? kDim * kDim : convolver.folded_multiplies());
+    state.counters["separable"] = convolver.is_separable() ? 1.0 : 0.0;
+}
+
+// 16. Медианный фильтр: сети сравнений (окна до 7) и гистограммы столбцов (9 и больше).
+// Режим 0 - один поток, 1 - полосы строк на общем ThreadPool.
+// range(0) -> размер картинки, range(1) -> размер окна, range(2) -> режим
+static void BM_MedianFilter(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int window = static_cast<int>(state.range(1));
+    const int mode = static_cast<int>(state.range(2));
+
+    std::vector<unsigned char> img = generateRandomImage(size, size);
+    MedianFilter median(window);
+    ThreadPool pool;
+
+    const int64_t batch = kMinBenchmarkIterations;
+    while (state.KeepRunningBatch(batch)) {
+        for (int64_t i = 0; i < batch; ++i) {
+            std::vector<unsigned char> out = (mode == 0) ? median.process(img.data(), size, size)
+                                                         : median.process_thread_pool(pool, img.data(), size, size);
+            benchmark::DoNotOptimize(out.data());
+        }
+    }
+    const int64_t total_iters = static_cast<int64_t>(state.iterations());
+    state.SetBytesProcessed(total_iters * int64_t(size) * int64_t(size) * 4);
+    state.counters["network_ops"] = static_cast<double>(median.network_ops());
+}
+
+// 17. Рекурсивная (IIR) гауссиана против FIR-ядра generateKernel(6 sigma + 1).
+// Режим 0 - process_folded (сепарабельное FIR, два одномерных прохода), 1 - IIR в одном
+// потоке, 2 - IIR на общем ThreadPool. Сигма переход (crossover) - наименьшая, при которой
+// режим 1 быстрее режима 0. max_err / mean_err - отклонение IIR от FIR по каналам
+// внутри изображения (FIR не трогает полосу шириной в радиус ядра у границ).
+// range(0) -> размер картинки, range(1) -> sigma, range(2) -> режим
+static void BM_RecursiveGaussian(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int kDim = 2 * static_cast<int>(3 * state.range(1)) + 1;
+    const int mode = static_cast<int>(state.range(2));
+    // Та же сигма, что использует generateKernel для этой ширины
+    const float sigma = std::max(kDim / 6.0f, 1.0f);
+
+    std::vector<unsigned char> img = generateRandomImage(size, size);
+    ImageConvolver convolver(generateKernel(kDim), kDim, kDim);
+    RecursiveGaussian iir(sigma);
+    ThreadPool pool;
+
+    if (mode != 0) {
+        std::vector<unsigned char> fir = convolver.process_folded(img.data(), size, size);
+        std::vector<unsigned char> rec = iir.process(img.data(), size, size);
+        const int r = kDim / 2;
+        int maxErr = 0;
+        double sumErr = 0.0;
+        size_t count = 0;
+        for (int y = r; y < size - r; ++y) {
+            for (int x = r; x < size - r; ++x) {
+                for (int c = 0; c < 3; ++c) {
+                    const size_t idx = (static_cast<size_t>(y) * size + x) * 4 + c;
+                    const int diff = std::abs(static_cast<int>(fir[idx]) - static_cast<int>(rec[idx]));
+                    maxErr = std::max(maxErr, diff);
+                    sumErr += diff;
+                    ++count;
+                }
+            }
+        }
+        state.counters["max_err"] = maxErr;
+        state.counters["mean_err"] = count ? sumErr / static_cast<double>(count) : 0.0;
+    }
+
+    const int64_t batch = kMinBenchmarkIterations;
+    while (state.KeepRunningBatch(batch)) {
+        for (int64_t i = 0; i < batch; ++i) {
+            std::vector<unsigned char> out;
+            if (mode == 0) {
+                out = convolver.process_folded(img.data(), size, size);
+            } else if (mode == 1) {
+                out = iir.process(img.data(), size, size);
+            } else {
+                out = iir.process_thread_pool(pool, img.data(), size, size);
+            }
+            benchmark::DoNotOptimize(out.data());
+        }
+    }
+    const int64_t total_iters = static_cast<int64_t>(state.iterations());
+    state.SetBytesProcessed(total_iters * int64_t(size) * int64_t(size) * 4);
+    state.counters["sigma"] = sigma;
+    state.counters["kernel_dim"] = kDim;
+}
+
+// 18. Разреженные ядра: a trous B3-сплайн 5x5 с шагом dilation (ядро 4 * dilation + 1).
+// Режим 0 - process_SIMD (обходит все тапы, включая нули), 1 - process_sparse (25 тапов),
+// 2 - process_sparse_thread_pool на общем ThreadPool.
+// range(0) -> размер картинки, range(1) -> dilation, range(2) -> режим
+static void BM_SparseDilated(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int dilation = static_cast<int>(state.range(1));
+    const int mode = static_cast<int>(state.range(2));
+
+    const float spline[5] = {1.f / 16, 4.f / 16, 6.f / 16, 4.f / 16, 1.f / 16};
+    std::vector<float> kernel(25);
+    for (int y = 0; y < 5; ++y) {
+        for (int x = 0; x < 5; ++x) {
+            kernel[y * 5 + x] = spline[y] * spline[x];
+        }
+    }
+    std::vector<unsigned char> img = generateRandomImage(size, size);
+    ImageConvolver convolver(kernel, 5, 5, dilation);
+    ThreadPool pool;
+
+    const int64_t batch = kMinBenchmarkIterations;
+    while (state.KeepRunningBatch(batch)) {
+        for (int64_t i = 0; i < batch; ++i) {
+            std::vector<unsigned char> out;
+            if (mode == 0) {
+                out = convolver.process_SIMD(img.data(), size, size);
+            } else if (mode == 1) {
+                out = convolver.process_sparse(img.data(), size, size);
+            } else {
+                out = convolver.process_sparse_thread_pool(pool, img.data(), size, size);
+            }
+            benchmark::DoNotOptimize(out.data());
+        }
+    }
+    const int64_t total_iters = static_cast<int64_t>(state.iterations());
+    const int dim = 4 * dilation + 1;
+    state.SetBytesProcessed(total_iters * int64_t(size) * int64_t(size) * 4);
+    state.counters["kernel_dim"] = dim;
+    state.counters["taps_per_px"] = static_cast<double>(mode == 0 ? dim * dim : convolver.sparse_tap_count());
+}
+
+// 19. Вложенный параллелизм: внешний цикл по изображениям, внутренний по полосам строк
+// (process_region). Режим 0 - только внешний parallel_for, 1 - только внутренний,
+// 2 - оба на одном пуле (ожидание внутреннего цикла выполняет задачи очереди).
+// range(0) -> размер картинки, range(1) -> количество картинок, range(2) -> режим
+static void BM_NestedParallel(benchmark::State& state) {
+    const int size = static_cast<int>(state.range(0));
+    const int count = static_cast<int>(state.range(1));
+    const int mode = static_cast<int>(state.range(2));
+
+    std::vector<std::vector<unsigned char>> images;
+    for (int i = 0; i < count; ++i) {
+        images.push_back(generateRandomImage(size, size));
+    }
+    std::vector<std::vector<unsigned char>> outputs(count, std::vector<unsigned char>(size_t(size) * size * 4));
+    ImageConvolver convolver(generateKernel(5), 5, 5);
+    ThreadPool pool;
+
+    auto blur_image = [&](int i, bool inner_parallel) {
+        if (!inner_parallel) {
+            convolver.process_region(images[i].data(), size, size, outputs[i].data(), 0, 0, size, size);
+            return;
+        }
+        pool.parallel_for(0, size, [&, i](int y0, int y1) {
+            convolver.process_region(images[i].data(), size, size, outputs[i].data(), 0, y0, size, y1);
+        });
+    };
+
+    const int64_t batch = kMinBenchmarkIterations;
+    while (state.KeepRunningBatch(batch)) {
+        for (int64_t it = 0; it < batch; ++it) {
+            if (mode == 1) {
+                for (int i = 0; i < count; ++i) {
+                    blur_image(i, true);
+                }
+            } else {
+                pool.parallel_for(0, count, [&](int begin, int end) {
+                    for (int i = begin; i < end; ++i) {
+                        blur_image(i, mode == 2);
+                    }
+                });
+            }
+            benchmark::DoNotOptimize(outputs.data());
+        }
+    }
+    const int64_t total_iters = static_cast<int64_t>(state.iterations());
+    state.SetItemsProcessed(total_iters * count);
+    state.SetBytesProcessed(total_iters * count * int64_t(size) * int64_t(size) * 4);
+    state.counters["threads"] = static_cast<double>(pool.get_thread_count());
+}
+
+// 20. Пакет маленьких изображений одного размера (тензор count x h x w x 4), ядро 5x5.
+// Режим 0 - process_SIMD по одной картинке, 1 - process_thread_pool по одной картинке
+// (полосы строк на общем пуле), 2 - process_batch в одном потоке, 3 - process_batch
+// на общем пуле (полосы четверок изображений). items_per_second - картинок в секунду.
+// range(0) -> размер картинки, range(1) -> количество картинок, range(2) -> режим
+class BatchFixture : public benchmark::Fixture {
+public:
+    std::vector<unsigned char> tensor;
+    ImageConvolver* convolver = nullptr;
+    ThreadPool* pool = nullptr;
+    int size = 0;
+    int count = 0;
+
+    void SetUp(const ::benchmark::State& state) {
+        size = static_cast<int>(state.range(0));
+        count = static_cast<int>(state.range(1));
+        if (tensor.empty()) {
+            for (int i = 0; i < count; ++i) {
+                std::vector<unsigned char> img = generateRandomImage(size, size);
+                tensor.insert(tensor.end(), img.begin(), img.end());
+            }
+            convolver = new ImageConvolver(generateKernel(5), 5, 5);
+            pool = new ThreadPool();
+        }
+    }
+
+    void TearDown(const ::benchmark::State& state) {
+        delete convolver;
+        convolver = nullptr;
+        delete pool;
+        pool = nullptr;
+        tensor.clear();
+    }
+};
+
+BENCHMARK_DEFINE_F(BatchFixture, BM_ProcessBatch)(benchmark::State& state) {
+    const int mode = static_cast<int>(state.range(2));
+    const size_t frame = static_cast<size_t>(size) * size * 4;
+
+    const int64_t batch = kMinBenchmarkIterations;
+    while (state.KeepRunningBatch(batch)) {
+        for (int64_t it = 0; it < batch; ++it) {
+            if (mode == 0 || mode == 1) {
+                for (int i = 0; i < count; ++i) {
+                    const unsigned char* img = tensor.data() + frame * i;
+                    std::vector<unsigned char> res = (mode == 0) ? convolver->process_SIMD(img, size, size)
+                                                                 : convolver->process_thread_pool(*pool, img, size, size);
+                    benchmark::DoNotOptimize(res.data());
+                }
+            } else {
+                std::vector<unsigned char> res = (mode == 2) ? convolver->process_batch(tensor.data(), count, size, size)
+                                                             : convolver->process_batch(*pool, tensor.data(), count, size, size);
+                benchmark::DoNotOptimize(res.data());
+            }
+        }
+    }
+    const int64_t total_iters = static_cast<int64_t>(state.iterations());
+    state.SetItemsProcessed(total_iters * count);
+    state.SetBytesProcessed(total_iters * count * int64_t(size) * int64_t(size) * 4);
+}
+
 static std::vector<int> BuildThreadCounts() {
     unsigned int hw = std::thread::hardware_concurrency();
     if (hw == 0) {
@@ -254,4 +1083,235 @@ BENCHMARK(BM_ThreadPoolOverhead)
     ->Unit(benchmark::kMicrosecond)
     ->MinTime(kMinBenchmarkSeconds);
 
+BENCHMARK(BM_PriorityMixedLatency)
+    ->Arg(0)
+    ->Arg(1)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(kMinBenchmarkSeconds);
+
+static void CustomArgumentsFrameStream(benchmark::internal::Benchmark* b) {
+    std::vector<int> changePercents = {1, 5, 10, 25, 50, 100};
+    for (int mode : {0, 1}) {
+        for (int pct : changePercents) {
+            b->Args({1024, 5, pct, mode});
+        }
+    }
+    b->Args({1024, 5, 100, 2});
+}
+
+BENCHMARK(BM_FrameStreamDirty)
+    ->Apply(CustomArgumentsFrameStream)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(kMinBenchmarkSeconds);
+
+static void CustomArgumentsPyramid(benchmark::internal::Benchmark* b) {
+    std::vector<int> imgSizes = {256, 512, 1024, 2048, 4096};
+    std::vector<int> kernelSizes = {5, 9};
+    for (int is : imgSizes) {
+        for (int ks : kernelSizes) {
+            for (int mode : {0, 1, 2}) {
+                b->Args({is, ks, mode});
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_GaussianPyramid)
+    ->Apply(CustomArgumentsPyramid)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(kMinBenchmarkSeconds);
+
+static void CustomArgumentsNative(benchmark::internal::Benchmark* b) {
+    std::vector<int> imgSizes = {256, 1024, 4096};
+    std::vector<int> kernelSizes = {3, 9};
+    for (int is : imgSizes) {
+        for (int ks : kernelSizes) {
+            b->Args({is, ks});
+        }
+    }
+}
+
+BENCHMARK_TEMPLATE2(BM_ProcessNative, unsigned char, 1)
+    ->Apply(CustomArgumentsNative)->UseRealTime()->Unit(benchmark::kMicrosecond)->MinTime(kMinBenchmarkSeconds);
+BENCHMARK_TEMPLATE2(BM_ProcessNative, unsigned char, 4)
+    ->Apply(CustomArgumentsNative)->UseRealTime()->Unit(benchmark::kMicrosecond)->MinTime(kMinBenchmarkSeconds);
+BENCHMARK_TEMPLATE2(BM_ProcessNative, unsigned short, 1)
+    ->Apply(CustomArgumentsNative)->UseRealTime()->Unit(benchmark::kMicrosecond)->MinTime(kMinBenchmarkSeconds);
+BENCHMARK_TEMPLATE2(BM_ProcessNative, unsigned short, 4)
+    ->Apply(CustomArgumentsNative)->UseRealTime()->Unit(benchmark::kMicrosecond)->MinTime(kMinBenchmarkSeconds);
+BENCHMARK_TEMPLATE2(BM_ProcessNative, float, 1)
+    ->Apply(CustomArgumentsNative)->UseRealTime()->Unit(benchmark::kMicrosecond)->MinTime(kMinBenchmarkSeconds);
+BENCHMARK_TEMPLATE2(BM_ProcessNative, float, 4)
+    ->Apply(CustomArgumentsNative)->UseRealTime()->Unit(benchmark::kMicrosecond)->MinTime(kMinBenchmarkSeconds);
+
+BENCHMARK(BM_MetricsOverhead)
+    ->Args({256, 3, 0})
+    ->Args({256, 3, 1})
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(kMinBenchmarkSeconds);
+
+static void CustomArgumentsMicrokernel(benchmark::internal::Benchmark* b) {
+    std::vector<int> imgSizes = {256, 1024, 4096};
+    std::vector<int> kernelSizes = {3, 5, 9};
+    for (int is : imgSizes) {
+        for (int ks : kernelSizes) {
+            for (int mode : {0, 1}) {
+                b->Args({is, ks, mode});
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_MicrokernelFlops)
+    ->Apply(CustomArgumentsMicrokernel)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(kMinBenchmarkSeconds);
+
+static void CustomArgumentsBufferPool(benchmark::internal::Benchmark* b) {
+    std::vector<int> imgSizes = {256, 1024, 4096};
+    for (int is : imgSizes) {
+        for (int mode : {0, 1, 2}) {
+            b->Args({is, 3, mode});
+        }
+    }
+}
+
+BENCHMARK(BM_FrameBufferPool)
+    ->Apply(CustomArgumentsBufferPool)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(kMinBenchmarkSeconds);
+
+static void CustomArgumentsSharding(benchmark::internal::Benchmark* b) {
+    std::vector<int> imgSizes = {256, 1024, 4096};
+    for (int is : imgSizes) {
+        for (int mode : {0, 1}) {
+            b->Args({is, 3, mode});
+        }
+    }
+}
+
+BENCHMARK(BM_ProcessSharding)
+    ->Apply(CustomArgumentsSharding)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(kMinBenchmarkSeconds);
+
+static void CustomArgumentsDaemon(benchmark::internal::Benchmark* b) {
+    std::vector<int> imgSizes = {64, 256, 1024};
+    for (int is : imgSizes) {
+        for (int clients : {1, 4, 16}) {
+            b->Args({is, 3, clients});
+        }
+    }
+}
+
+BENCHMARK(BM_DaemonLoad)
+    ->Apply(CustomArgumentsDaemon)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(kMinBenchmarkSeconds);
+
+static void CustomArgumentsFolding(benchmark::internal::Benchmark* b) {
+    std::vector<int> kernelSizes = {3, 5, 9, 15};
+    for (int ks : kernelSizes) {
+        for (int kind : {0, 1}) {
+            for (int mode : {0, 1}) {
+                b->Args({1024, ks, kind, mode});
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_SymmetricFolding)
+    ->Apply(CustomArgumentsFolding)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(kMinBenchmarkSeconds);
+
+static void CustomArgumentsMedian(benchmark::internal::Benchmark* b) {
+    std::vector<int> imgSizes = {256, 1024};
+    std::vector<int> windows = {3, 5, 7, 9, 11, 13, 15};
+    for (int is : imgSizes) {
+        for (int ws : windows) {
+            for (int mode : {0, 1}) {
+                b->Args({is, ws, mode});
+            }
+        }
+    }
+}
+
+BENCHMARK(BM_MedianFilter)
+    ->Apply(CustomArgumentsMedian)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(kMinBenchmarkSeconds);
+
+static void CustomArgumentsRecursiveGaussian(benchmark::internal::Benchmark* b) {
+    std::vector<int> sigmas = {1, 2, 3, 5, 8, 12, 20, 32, 50};
+    for (int sigma : sigmas) {
+        for (int mode : {0, 1, 2}) {
+            b->Args({1024, sigma, mode});
+        }
+    }
+}
+
+BENCHMARK(BM_RecursiveGaussian)
+    ->Apply(CustomArgumentsRecursiveGaussian)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(kMinBenchmarkSeconds);
+
+static void CustomArgumentsSparse(benchmark::internal::Benchmark* b) {
+    std::vector<int> dilations = {1, 2, 4, 8, 16};
+    for (int d : dilations) {
+        for (int mode : {0, 1, 2}) {
+            b->Args({1024, d, mode});
+        }
+    }
+}
+
+BENCHMARK(BM_SparseDilated)
+    ->Apply(CustomArgumentsSparse)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(kMinBenchmarkSeconds);
+
+static void CustomArgumentsNested(benchmark::internal::Benchmark* b) {
+    for (int count : {1, 4, 32}) {
+        for (int mode : {0, 1, 2}) {
+            b->Args({512, count, mode});
+        }
+    }
+}
+
+BENCHMARK(BM_NestedParallel)
+    ->Apply(CustomArgumentsNested)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(kMinBenchmarkSeconds);
+
+static void CustomArgumentsBatch(benchmark::internal::Benchmark* b) {
+    std::vector<int> imgSizes = {32, 64};
+    std::vector<int> counts = {1, 4, 16, 64, 256, 1024, 4096};
+    for (int is : imgSizes) {
+        for (int count : counts) {
+            for (int mode : {0, 1, 2, 3}) {
+                b->Args({is, count, mode});
+            }
+        }
+    }
+}
+
+BENCHMARK_REGISTER_F(BatchFixture, BM_ProcessBatch)
+    ->Apply(CustomArgumentsBatch)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond)
+    ->MinTime(kMinBenchmarkSeconds);
+
 BENCHMARK_MAIN();
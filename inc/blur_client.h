@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "blur_protocol.h"
+
+/**
+ * @brief Изображение в разделяемой памяти клиента: [вход | выход], по w * h * 4 байт RGBA.
+ * Дескриптор передается демону вместе с запросом, результат появляется в output().
+ */
+class SharedImage {
+public:
+    /**
+     * @throws std::runtime_error если не удалось создать или отобразить память.
+     */
+    SharedImage(int w, int h);
+    ~SharedImage();
+
+    SharedImage(const SharedImage&) = delete;
+    SharedImage& operator=(const SharedImage&) = delete;
+
+    unsigned char* input() { return m_data; }
+    const unsigned char* output() const { return m_data + bytes(); }
+
+    int w() const { return m_w; }
+    int h() const { return m_h; }
+    int fd() const { return m_fd; }
+    size_t bytes() const { return static_cast<size_t>(m_w) * m_h * 4; }
+
+private:
+    int m_w;
+    int m_h;
+    int m_fd = -1;
+    unsigned char* m_data = nullptr;
+};
+
+/**
+ * @brief Клиент демона свертки (одно соединение).
+ *
+ * Синхронные blur_file()/blur_shared() отправляют запрос и ждут ответ.
+ * submit_*() и wait_reply() позволяют держать несколько запросов в полете:
+ * ответы приходят в порядке отправки. Ошибки транспорта - std::runtime_error,
+ * ошибка самого задания - в BlurJobReply::status.
+ */
+class BlurClient {
+public:
+    /**
+     * @throws std::runtime_error если демон недоступен.
+     */
+    explicit BlurClient(const std::string& socket_path);
+    ~BlurClient();
+
+    BlurClient(const BlurClient&) = delete;
+    BlurClient& operator=(const BlurClient&) = delete;
+
+    void submit_file(const std::vector<float>& kernel, int dim,
+                     const std::string& input_path, const std::string& output_path, uint64_t id = 0);
+    void submit_shared(const std::vector<float>& kernel, int dim, const SharedImage& image, uint64_t id = 0);
+    BlurJobReply wait_reply();
+
+    BlurJobReply blur_file(const std::vector<float>& kernel, int dim,
+                           const std::string& input_path, const std::string& output_path);
+    BlurJobReply blur_shared(const std::vector<float>& kernel, int dim, const SharedImage& image);
+
+private:
+    void send_request(const BlurJobRequest& request, const std::vector<float>& kernel, int fd);
+
+    int m_fd = -1;
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "blur_protocol.h"
+#include "buffer_pool.h"
+#include "image_convolver.h"
+#include "thread_pool.h"
+
+/**
+ * @brief Долгоживущий демон свертки: принимает задания по Unix-сокету (см. blur_protocol.h).
+ *
+ * Держит прогретые ThreadPool и BufferPool и кэш ImageConvolver по ядру,
+ * поэтому задание не платит за запуск процесса, создание потоков и подготовку ядра.
+ * Цикл run() ждет в poll() и забирает все запросы, готовые к этому моменту
+ * (не больше max_batch), одной пачкой: загрузки, полосы свертки (split_rows +
+ * process_region) и сохранения всех заданий пачки идут в пул одновременно,
+ * поэтому маленькие изображения от разных клиентов занимают все потоки.
+ * Результат совпадает с process_SIMD побитово.
+ *
+ * Рассчитан на доверенных локальных клиентов: запрос читается целиком блокирующим
+ * чтением. Только POSIX; на других платформах конструктор бросает std::runtime_error.
+ */
+class BlurDaemon {
+public:
+    struct Options {
+        std::string socket_path;          ///< Путь Unix-сокета (существующий файл заменяется)
+        size_t threads = 0;               ///< Потоки пула (0 - по числу аппаратных потоков)
+        size_t max_batch = 64;            ///< Наибольшее число заданий в пачке
+        size_t max_cached_kernels = 16;   ///< Размер кэша ImageConvolver (вытеснение LRU)
+    };
+
+    struct Stats {
+        uint64_t jobs = 0;
+        uint64_t batches = 0;
+        uint64_t kernel_cache_hits = 0;
+        uint64_t kernel_cache_misses = 0;
+    };
+
+    /**
+     * @brief Создает сокет и начинает слушать.
+     * @throws std::runtime_error если сокет создать не удалось.
+     */
+    explicit BlurDaemon(const Options& options);
+    ~BlurDaemon();
+
+    BlurDaemon(const BlurDaemon&) = delete;
+    BlurDaemon& operator=(const BlurDaemon&) = delete;
+
+    /**
+     * @brief Обслуживает клиентов до вызова stop().
+     */
+    void run();
+
+    /**
+     * @brief Просит run() завершиться. Можно вызывать из другого потока и из обработчика сигнала.
+     */
+    void stop();
+
+    /**
+     * @brief Статистика (читать после завершения run()).
+     */
+    Stats stats() const { return m_stats; }
+
+private:
+    struct Job;
+    struct CachedConvolver {
+        std::unique_ptr<ImageConvolver> convolver;
+        uint64_t last_used = 0;
+    };
+
+    bool read_job(int fd, Job& job);
+    void process_batch(std::vector<Job>& batch);
+    ImageConvolver* convolver_for(const std::vector<float>& kernel, int dim);
+
+    Options m_options;
+    int m_listen_fd = -1;
+    int m_wake_pipe[2] = {-1, -1};   ///< stop() пишет байт, poll() просыпается
+    std::vector<int> m_clients;
+
+    ThreadPool m_pool;
+    BufferPool m_buffers;
+    std::unordered_map<std::string, CachedConvolver> m_convolvers;  ///< Ключ - размер и байты весов
+    uint64_t m_use_counter = 0;
+    Stats m_stats;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * @brief Протокол демона свертки (blurd) поверх потокового Unix-сокета.
+ *
+ * Запрос: BlurJobRequest, сразу за ним kernel_dim * kernel_dim float весов ядра.
+ * Для SharedMemory к первому байту запроса приложен дескриптор (SCM_RIGHTS)
+ * разделяемой памяти клиента: [вход w * h * 4 | выход w * h * 4] RGBA.
+ * Демон сворачивает вход прямо в выходную половину и отвечает BlurJobReply,
+ * пиксели по сокету не передаются. Для File демон сам читает input_path
+ * и пишет результат в output_path (JPG).
+ * На одном соединении ответы приходят в порядке запросов.
+ */
+
+constexpr uint32_t kBlurProtocolMagic = 0x424c5231;  // "BLR1"
+constexpr int kBlurMaxKernelDim = 31;
+constexpr int kBlurMaxImageSide = 1 << 15;
+constexpr int kBlurMaxPath = 256;
+
+/**
+ * @brief Откуда берется изображение.
+ */
+enum class BlurJobSource : uint32_t {
+    File = 0,          ///< Пути input_path / output_path на машине демона
+    SharedMemory = 1   ///< Приложенный дескриптор разделяемой памяти
+};
+
+/**
+ * @brief Код результата задания.
+ */
+enum class BlurJobStatus : int32_t {
+    Ok = 0,
+    BadRequest,     ///< Неверный размер ядра, изображения или путь
+    LoadFailed,     ///< Не удалось прочитать input_path
+    SaveFailed,     ///< Не удалось записать output_path
+    MapFailed       ///< Дескриптор не приложен, мал или не отображается
+};
+
+struct BlurJobRequest {
+    uint32_t magic = kBlurProtocolMagic;
+    BlurJobSource source = BlurJobSource::File;
+    uint64_t id = 0;                    ///< Возвращается в ответе без изменений
+    int32_t kernel_dim = 0;             ///< Нечетная сторона квадратного ядра
+    int32_t w = 0;                      ///< Размер изображения (SharedMemory)
+    int32_t h = 0;
+    char input_path[kBlurMaxPath] = {};
+    char output_path[kBlurMaxPath] = {};
+};
+
+struct BlurJobReply {
+    uint32_t magic = kBlurProtocolMagic;
+    BlurJobStatus status = BlurJobStatus::Ok;
+    uint64_t id = 0;
+    int32_t w = 0;                      ///< Размер обработанного изображения
+    int32_t h = 0;
+    uint32_t batch_size = 0;            ///< Сколько заданий обработано одной пачкой с этим
+    uint32_t reserved = 0;
+    uint64_t queue_ns = 0;              ///< От приема запроса до начала обработки пачки
+    uint64_t service_ns = 0;            ///< Обработка пачки до отправки ответа
+};
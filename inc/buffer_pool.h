@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+class BufferPool;
+
+/**
+ * @brief Буфер из BufferPool (владеющий, только перемещение).
+ * При уничтожении возвращается в пул, а не освобождается.
+ * Содержимое нового буфера не инициализируется.
+ */
+class PooledBuffer {
+public:
+    PooledBuffer() = default;
+    ~PooledBuffer();
+
+    PooledBuffer(PooledBuffer&& other) noexcept;
+    PooledBuffer& operator=(PooledBuffer&& other) noexcept;
+    PooledBuffer(const PooledBuffer&) = delete;
+    PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+    unsigned char* data() { return m_data; }
+    const unsigned char* data() const { return m_data; }
+
+    /**
+     * @brief Запрошенный размер в байтах.
+     */
+    size_t size() const { return m_size; }
+
+    bool empty() const { return m_data == nullptr; }
+
+    /**
+     * @brief Возвращает буфер в пул досрочно.
+     */
+    void reset();
+
+private:
+    friend class BufferPool;
+
+    BufferPool* m_pool = nullptr;
+    unsigned char* m_data = nullptr;
+    unsigned char* m_base = nullptr;   ///< Начало выделения (m_data может быть смещен)
+    size_t m_size = 0;
+    size_t m_capacity = 0;
+    size_t m_mapped_length = 0;        ///< Длина mmap-отображения (0 - aligned_alloc)
+};
+
+/**
+ * @brief Пул буферов изображений, выровненных на 64 байта (линия кэша / регистр zmm).
+ *
+ * Буферы группируются по классам размера (4 класса на степень двойки),
+ * освобожденный буфер кладется в список своего класса и отдается следующему
+ * запросу того же класса: для потока кадров одинакового размера память
+ * выделяется и "прогревается" (page faults) только на первом кадре.
+ * Большие буферы (от 2 МБ) выделяются через mmap и могут использовать
+ * огромные страницы: прозрачные (madvise MADV_HUGEPAGE) или явные (MAP_HUGETLB,
+ * при нехватке hugetlbfs-страниц - откат на прозрачные). Начало большого буфера
+ * сдвигается на "цвет" (k * (4 КБ + 64 байта)): иначе вход и выход, выровненные
+ * на 2 МБ, попадают в одни и те же наборы L1/L2 и свертка замедляется в разы.
+ * Потокобезопасен. Пул должен жить дольше всех выданных им буферов.
+ */
+class BufferPool {
+public:
+    /**
+     * @brief Режим огромных страниц для больших буферов.
+     */
+    enum class HugePages {
+        None,         ///< Обычные страницы
+        Transparent,  ///< madvise(MADV_HUGEPAGE) - THP
+        Explicit      ///< mmap(MAP_HUGETLB), откат на Transparent
+    };
+
+    static constexpr size_t kAlignment = 64;
+    static constexpr size_t kHugePageSize = size_t(2) << 20;
+
+    /**
+     * @brief Статистика пула.
+     */
+    struct Stats {
+        uint64_t hits = 0;               ///< Запросы, обслуженные из кэша
+        uint64_t misses = 0;             ///< Запросы, потребовавшие нового выделения
+        uint64_t huge_allocations = 0;   ///< Выделения с MAP_HUGETLB или MADV_HUGEPAGE
+        size_t cached_bytes = 0;         ///< Свободные буферы в кэше
+        size_t outstanding_bytes = 0;    ///< Выданные и еще не возвращенные буферы
+    };
+
+    /**
+     * @brief Конструктор.
+     *
+     * @param huge_pages Режим огромных страниц для буферов от kHugePageSize.
+     * @param max_cached_bytes Предел суммарного объема свободных буферов в кэше;
+     *                         сверх него возвращенные буферы освобождаются.
+     */
+    explicit BufferPool(HugePages huge_pages = HugePages::Transparent,
+                        size_t max_cached_bytes = size_t(1) << 30);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /**
+     * @brief Выдает буфер не меньше size байт, выровненный на kAlignment.
+     * @throws std::bad_alloc если память выделить не удалось.
+     */
+    PooledBuffer acquire(size_t size);
+
+    /**
+     * @brief Освобождает все свободные буферы из кэша.
+     */
+    void trim();
+
+    Stats stats() const;
+
+    /**
+     * @brief Класс размера (фактическая емкость буфера) для запроса size байт.
+     */
+    static size_t size_class(size_t size);
+
+private:
+    friend class PooledBuffer;
+
+    struct Block {
+        unsigned char* data = nullptr;
+        unsigned char* base = nullptr;
+        size_t capacity = 0;
+        size_t mapped_length = 0;  ///< Длина mmap-отображения (0 - aligned_alloc)
+    };
+
+    void release(const Block& block);
+    Block allocate(size_t capacity, bool& huge);
+    static void free_block(const Block& block);
+
+    HugePages m_huge_pages;
+    size_t m_max_cached_bytes;
+    std::atomic<size_t> m_next_color{0};
+
+    mutable std::mutex m_mutex;
+    std::map<size_t, std::vector<Block>> m_free;  ///< Свободные буферы по классам размера
+    Stats m_stats;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "image_convolver.h"
+
+/**
+ * @brief Прямоугольник изменившейся области кадра (в пикселях).
+ */
+struct DirtyRect {
+    int x = 0;
+    int y = 0;
+    int w = 0;
+    int h = 0;
+};
+
+/**
+ * @brief Свертка потока кадров с пересчетом только изменившихся областей.
+ *
+ * Хранит предыдущий входной кадр и результат. Для нового кадра пересчитываются
+ * только плитки выхода, которые задевают изменившиеся прямоугольники,
+ * расширенные на половину ядра (kW/2, kH/2). Остальной результат
+ * переиспользуется на месте. Результат совпадает с ImageConvolver::process_SIMD.
+ */
+class FrameStreamConvolver {
+public:
+    /**
+     * @brief Конструктор принимает ядро свертки и размер плитки.
+     *
+     * @param kernel Ядро свертки.
+     * @param kW Ширина ядра.
+     * @param kH Высота ядра.
+     * @param tile_size Сторона квадратной плитки, по которой отслеживаются изменения.
+     */
+    FrameStreamConvolver(const std::vector<float>& kernel, int kW, int kH, int tile_size = 32);
+
+    /**
+     * @brief Обрабатывает кадр с явно заданным списком измененных прямоугольников.
+     * Пиксели вне прямоугольников обязаны совпадать с предыдущим кадром.
+     * Первый кадр (или кадр другого размера) обрабатывается целиком.
+     *
+     * @param img_in Указатель на новый кадр (RGBA).
+     * @param w Ширина кадра.
+     * @param h Высота кадра.
+     * @param dirty Измененные прямоугольники входа.
+     * @return const std::vector<unsigned char>& Результат (действителен до следующего вызова).
+     */
+    const std::vector<unsigned char>& process_frame(const unsigned char* img_in, int w, int h,
+                                                    const std::vector<DirtyRect>& dirty);
+
+    /**
+     * @brief Обрабатывает кадр, находя изменившиеся плитки сравнением с предыдущим кадром.
+     */
+    const std::vector<unsigned char>& process_frame(const unsigned char* img_in, int w, int h);
+
+    /**
+     * @brief Доля пикселей, пересчитанных на последнем кадре (от 0 до 1).
+     */
+    double last_recomputed_fraction() const;
+
+    /**
+     * @brief Сбрасывает сохраненное состояние: следующий кадр будет обработан целиком.
+     */
+    void reset();
+
+private:
+    /**
+     * @brief Первый кадр или смена размера: полная обработка.
+     */
+    void process_full(const unsigned char* img_in, int w, int h);
+
+    /**
+     * @brief Помечает плитки выхода, задетые прямоугольником входа с учетом ореола ядра.
+     */
+    void mark_rect(const DirtyRect& rect);
+
+    /**
+     * @brief Пересчитывает помеченные плитки (соседние в строке объединяются).
+     */
+    void recompute_marked(const unsigned char* img_in);
+
+    ImageConvolver m_convolver;
+    int m_kW;
+    int m_kH;
+    int m_tile;
+
+    int m_w = 0;
+    int m_h = 0;
+    int m_tilesX = 0;
+    int m_tilesY = 0;
+    std::vector<unsigned char> m_prev_input;  ///< Предыдущий входной кадр
+    std::vector<unsigned char> m_output;      ///< Результат (переиспользуется между кадрами)
+    std::vector<unsigned char> m_tile_mask;   ///< Плитки выхода, требующие пересчета
+    double m_recomputed_fraction = 0.0;
+};
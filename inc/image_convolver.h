@@ -1,16 +1,70 @@
 #pragma once
 
 #include <cstddef>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "buffer_pool.h"
+#include "metrics.h"
+#include "thread_pool.h"
+
+/**
+ * @brief Уровень гауссовой пирамиды (RGBA).
+ */
+struct PyramidLevel {
+    int w = 0;
+    int h = 0;
+    std::vector<unsigned char> data;
+};
+
+/**
+ * @brief Полуинтервал строк [begin, end).
+ */
+struct RowRange {
+    int begin = 0;
+    int end = 0;
+};
+
 class ImageConvolver {
 public:
     /**
      * @brief Конструктор принимает ядро свертки и его размеры.
      * Ядро сохраняется внутри класса для последующего использования.
+     *
+     * При dilation > 1 ядро разреживается (a trous): между соседними тапами
+     * вставляется dilation - 1 нулей, и все варианты process_* работают с ядром
+     * (kW - 1) * dilation + 1 на (kH - 1) * dilation + 1. Хранится список
+     * ненулевых тапов (process_sparse, process_batch); плотное ядро, упаковка
+     * весов и сложенные тапы при dilation > 1 строятся при первом вызове
+     * плотного варианта (process_default, process_SIMD, блочного, сложенного),
+     * при dilation = 1 - сразу.
+     *
+     * @throws std::invalid_argument при dilation < 1.
+     */
+    ImageConvolver(const std::vector<float>& kernel, int kW, int kH, int dilation = 1);
+
+    /**
+     * @brief Шаг разреживания ядра (1 - плотное ядро).
+     */
+    int dilation() const { return m_dilation; }
+
+    /**
+     * @brief Количество ненулевых тапов (умножений на канал пикселя в process_sparse).
      */
-    ImageConvolver(const std::vector<float>& kernel, int kW, int kH);
+    size_t sparse_tap_count() const { return m_sparse_taps.size(); }
+
+    /**
+     * @brief Подключает реестр метрик: латентность загрузки, свертки, границ и сохранения
+     * записывается по варианту и корзине размера. nullptr (по умолчанию) отключает сбор.
+     * Реестр не принадлежит свертке и должен жить дольше нее.
+     */
+    void set_metrics(MetricsRegistry* metrics) { m_metrics = metrics; }
+
+    /**
+     * @brief Подключенный реестр метрик (или nullptr).
+     */
+    MetricsRegistry* metrics() const { return m_metrics; }
 
     /**
      * @brief Загружает изображение с диска.
@@ -24,6 +78,34 @@ public:
      */
     unsigned char* loadImage(const char* filename, int& w, int& h, int& channels);
 
+    /**
+     * @brief Загружает 8-битное изображение с исходным количеством каналов (1..4).
+     * Серое изображение остается одноканальным, а не расширяется до RGBA.
+     * Буфер освобождается через stbi_image_free().
+     */
+    unsigned char* loadImageNative(const char* filename, int& w, int& h, int& channels);
+
+    /**
+     * @brief Загружает изображение в 16-битном формате (stbi_load_16) с исходными каналами.
+     * Буфер освобождается через stbi_image_free().
+     */
+    unsigned short* loadImage16(const char* filename, int& w, int& h, int& channels);
+
+    /**
+     * @brief Загружает изображение во float (stbi_loadf) с исходными каналами.
+     * Буфер освобождается через stbi_image_free().
+     */
+    float* loadImageF(const char* filename, int& w, int& h, int& channels);
+
+    /**
+     * @brief Загружает изображение (RGBA) в выровненный буфер из пула.
+     * Декодированные данные копируются из буфера stb, который сразу освобождается.
+     *
+     * @param pool Пул буферов.
+     * @return PooledBuffer Пустой буфер, если загрузка не удалась.
+     */
+    PooledBuffer loadImage(BufferPool& pool, const char* filename, int& w, int& h, int& channels);
+
     /**
      * @brief Выполняет свертку RGB изображения.
      * Картинка передается по указателю, результат возвращается вектором (RAII).
@@ -46,6 +128,212 @@ public:
      */
     std::vector<unsigned char> process_SIMD(const unsigned char* img_in, int w, int h);
 
+    /**
+     * @brief То же, что process_SIMD, но результат пишется в буфер из пула
+     * (выровненный, без обнуления и без повторных page faults в потоке кадров).
+     */
+    PooledBuffer process_SIMD(BufferPool& pool, const unsigned char* img_in, int w, int h);
+
+    /**
+     * @brief SIMD-свертка с блокировкой по регистрам: 6 выходных строк x 4 группы
+     * по 4 пикселя за проход с независимыми аккумуляторами. Каждая загруженная
+     * входная строка используется всеми выходными строками блока, веса берутся
+     * заранее размноженными (см. конструктор). Результат совпадает с process_SIMD.
+     *
+     * @param img_in Указатель на исходные данные.
+     * @param w Ширина изображения.
+     * @param h Высота изображения.
+     * @return std::vector<unsigned char> Буфер с обработанным изображением.
+     */
+    std::vector<unsigned char> process_SIMD_blocked(const unsigned char* img_in, int w, int h);
+
+    /**
+     * @brief То же, что process_SIMD_blocked, но результат пишется в буфер из пула.
+     */
+    PooledBuffer process_SIMD_blocked(BufferPool& pool, const unsigned char* img_in, int w, int h);
+
+    /**
+     * @brief Симметрии ядра (битовые флаги symmetry()), определяются вместе с плотным ядром (см. конструктор).
+     */
+    static constexpr unsigned kSymmetryHorizontal = 1;  ///< k(y, x) == k(y, kW-1-x)
+    static constexpr unsigned kSymmetryVertical = 2;    ///< k(y, x) == k(kH-1-y, x)
+    static constexpr unsigned kSymmetryPoint = 4;       ///< k(y, x) == k(kH-1-y, kW-1-x)
+
+    unsigned symmetry() const {
+        prepare_dense();
+        return m_symmetry;
+    }
+
+    /**
+     * @brief Ядро раскладывается в произведение столбца на строку (ранг 1).
+     */
+    bool is_separable() const {
+        prepare_dense();
+        return m_separable;
+    }
+
+    /**
+     * @brief Умножений на канал пикселя в process_folded (против kW * kH в process_SIMD).
+     */
+    size_t folded_multiplies() const;
+
+    /**
+     * @brief SIMD-свертка со сверткой симметричных тапов: пиксели, которым ядро
+     * дает один вес (зеркальные пары или четверки), сначала складываются
+     * в целых числах, затем умножаются один раз. Для сепарабельного ядра -
+     * два одномерных прохода (по строкам, затем по столбцам), каждый тоже со
+     * сложенными парами. Порядок вычислений другой, поэтому результат может
+     * отличаться от process_SIMD на единицу округления.
+     *
+     * @param img_in Указатель на исходные данные.
+     * @param w Ширина изображения.
+     * @param h Высота изображения.
+     * @return std::vector<unsigned char> Буфер с обработанным изображением.
+     */
+    std::vector<unsigned char> process_folded(const unsigned char* img_in, int w, int h);
+
+    /**
+     * @brief SIMD-свертка только по ненулевым тапам ядра (смещение + вес, см. конструктор).
+     * Для разреженных ядер (лапласиан, Собель, a trous с dilation > 1) стоимость
+     * пропорциональна числу ненулевых тапов, а не kW * kH. Тапы идут в том же
+     * порядке, что и в process_SIMD, а пропущенные нулевые FMA не меняют сумму,
+     * поэтому результат совпадает с process_SIMD побитово.
+     *
+     * @param img_in Указатель на исходные данные.
+     * @param w Ширина изображения.
+     * @param h Высота изображения.
+     * @return std::vector<unsigned char> Буфер с обработанным изображением.
+     */
+    std::vector<unsigned char> process_sparse(const unsigned char* img_in, int w, int h);
+
+    /**
+     * @brief То же, что process_sparse, полосы строк (split_rows) на внешнем пуле.
+     */
+    std::vector<unsigned char> process_sparse_thread_pool(ThreadPool& pool, const unsigned char* img_in, int w, int h,
+                                                          TaskPriority priority = TaskPriority::Normal);
+
+    /**
+     * @brief То же на временном пуле из num_threads потоков (0 - по числу ядер).
+     */
+    std::vector<unsigned char> process_sparse_thread_pool(const unsigned char* img_in, int w, int h,
+                                                          size_t num_threads = 0);
+
+    /**
+     * @brief Пакетная свертка многих маленьких изображений одного размера (SIMD по изображениям).
+     * Изображения идут подряд (тензор count x h x w x 4), результат в том же формате.
+     * Четверки изображений перепаковываются так, что пиксель занимает 16 байт
+     * (один и тот же пиксель 4 изображений), и каждая загрузка zmm дает 4 соседних
+     * пикселя 4 изображений. Векторизуются все внутренние пиксели независимо от
+     * ширины, обходятся только ненулевые тапы (как в process_sparse). Границы
+     * и альфа копируются, как в остальных вариантах.
+     *
+     * @param images Указатель на count изображений w x h RGBA подряд.
+     * @param count Количество изображений.
+     * @param w Ширина каждого изображения.
+     * @param h Высота каждого изображения.
+     * @return std::vector<unsigned char> count обработанных изображений подряд.
+     */
+    std::vector<unsigned char> process_batch(const unsigned char* images, int count, int w, int h);
+
+    /**
+     * @brief То же, что process_batch, но четверки изображений делятся на полосы
+     * (split_rows) на внешнем пуле: одна задача на полосу изображений, а не на строки.
+     */
+    std::vector<unsigned char> process_batch(ThreadPool& pool, const unsigned char* images, int count, int w, int h,
+                                             TaskPriority priority = TaskPriority::Normal);
+
+    /**
+     * @brief То же для изображений в отдельных буферах: inputs[i] -> outputs[i]
+     * (каждый буфер w * h * 4 байт, выходные буферы выделяет вызывающий).
+     */
+    void process_batch(ThreadPool& pool, const unsigned char* const* inputs, unsigned char* const* outputs,
+                       int count, int w, int h, TaskPriority priority = TaskPriority::Normal);
+
+    /**
+     * @brief Свертка изображения в исходном формате (SIMD).
+     * Реализована для C = 1, 2, 3, 4 и T = unsigned char, unsigned short, float.
+     * При C = 2 и C = 4 последний канал считается альфой и копируется.
+     * Результат округляется к нулю и насыщается по диапазону T, как в process_default.
+     *
+     * @tparam T Тип компоненты пикселя.
+     * @tparam C Количество каналов.
+     * @param img_in Указатель на исходные данные (w * h * C значений).
+     * @param w Ширина изображения.
+     * @param h Высота изображения.
+     * @return std::vector<T> Буфер с обработанным изображением.
+     */
+    template<typename T, int C>
+    std::vector<T> process_native(const T* img_in, int w, int h);
+
+    /**
+     * @brief Пересчитывает прямоугольник [x0, x1) x [y0, y1) выходного изображения (SIMD).
+     * Результат совпадает с process_SIMD в пределах прямоугольника.
+     * По x пересчет может захватить до 3 соседних пикселей (выравнивание
+     * по 4-пиксельным группам), им записывается то же значение, что дал бы
+     * process_SIMD. Прямоугольник обрезается по границам изображения.
+     * Метрики этапов не пишутся: это доля кадра (полоса, плитка), и время
+     * учитывает вызывающий под своим вариантом.
+     *
+     * @param img_in Указатель на исходные данные (всё изображение).
+     * @param w Ширина изображения.
+     * @param h Высота изображения.
+     * @param img_out Выходной буфер размера w * h * 4.
+     */
+    void process_region(const unsigned char* img_in, int w, int h, unsigned char* img_out,
+                        int x0, int y0, int x1, int y1);
+
+    /**
+     * @brief Делит строки [begin, end) на не более чем parts непустых полос подряд.
+     * Первые (end - begin) % parts полос на строку длиннее остальных.
+     * Так режут работу process_thread_pool, build_pyramid и ProcessShardConvolver.
+     */
+    static std::vector<RowRange> split_rows(int begin, int end, size_t parts);
+
+    /**
+     * @brief Свертка, совмещенная с прореживанием в factor раз (SIMD).
+     * Вычисляются только пиксели (x * factor, y * factor), которые переживут
+     * прореживание, поэтому работа сокращается примерно в factor^2 раз.
+     *
+     * @param img_in Указатель на исходные данные.
+     * @param w Ширина изображения.
+     * @param h Высота изображения.
+     * @param factor Шаг прореживания (>= 1).
+     * @param out_w [out] Ширина результата: ceil(w / factor).
+     * @param out_h [out] Высота результата: ceil(h / factor).
+     * @return std::vector<unsigned char> Буфер с уменьшенным изображением.
+     */
+    std::vector<unsigned char> process_decimate(const unsigned char* img_in, int w, int h, int factor,
+                                                int& out_w, int& out_h);
+
+    /**
+     * @brief То же, что process_decimate, но результат (промежуточный уровень
+     * для дальнейшей обработки) пишется в буфер из пула.
+     */
+    PooledBuffer process_decimate(BufferPool& pool, const unsigned char* img_in, int w, int h, int factor,
+                                  int& out_w, int& out_h);
+
+    /**
+     * @brief Строит гауссову пирамиду: размытие + прореживание в 2 раза на каждом уровне.
+     * Уровни строятся последовательно (каждый из предыдущего), строки
+     * уровня делятся на полосы и считаются на пуле потоков.
+     *
+     * @param img_in Указатель на исходные данные (уровень 0, в результат не копируется).
+     * @param w Ширина изображения.
+     * @param h Высота изображения.
+     * @param min_size Минимальная сторона уровня: уровни меньше не строятся.
+     * @param num_threads Количество потоков (0 = аппаратная конфигурация).
+     * @return std::vector<PyramidLevel> Уровни 1..N (уровень i в 2^i раз меньше исходного).
+     */
+    std::vector<PyramidLevel> build_pyramid(const unsigned char* img_in, int w, int h, int min_size,
+                                            size_t num_threads = 0);
+
+    /**
+     * @brief То же, что build_pyramid, но полосы уровня считаются задачами TaskGroup
+     * на общем пуле. Безопасно вызывать из задачи того же пула.
+     */
+    std::vector<PyramidLevel> build_pyramid(ThreadPool& pool, const unsigned char* img_in, int w, int h,
+                                            int min_size, TaskPriority priority = TaskPriority::Normal);
+
     /**
      * @brief Выполняет свертку RGB изображения в несколько потоков (без SIMD).
      * Картинка передается по указателю, результат возвращается вектором (RAII).
@@ -58,6 +346,22 @@ public:
      */
     std::vector<unsigned char> process_thread_pool(const unsigned char* img_in, int w, int h, size_t num_threads = 0);
 
+    /**
+     * @brief То же, что process_thread_pool, но на внешнем (разделяемом) пуле.
+     * Все задачи ставятся в очередь с указанным приоритетом, поэтому
+     * маленькие интерактивные запросы могут обгонять большие. Полосы ждутся
+     * через TaskGroup, поэтому вызов допустим и из задачи того же пула.
+     *
+     * @param pool Пул потоков, на котором выполняется свертка.
+     * @param img_in Указатель на исходные данные.
+     * @param w Ширина изображения.
+     * @param h Высота изображения.
+     * @param priority Приоритет задач свертки.
+     * @return std::vector<unsigned char> Буфер с обработанным изображением.
+     */
+    std::vector<unsigned char> process_thread_pool(ThreadPool& pool, const unsigned char* img_in, int w, int h,
+                                                   TaskPriority priority = TaskPriority::Normal);
+
     /**
      * @brief Выполняет свертку RGB изображения, создавая задачу на каждую строку.
      * Картинка передается по указателю, результат возвращается вектором (RAII).
@@ -70,6 +374,19 @@ public:
      */
     std::vector<unsigned char> process_thread_pool_full(const unsigned char* img_in, int w, int h, size_t num_threads = 0);
 
+    /**
+     * @brief То же, что process_thread_pool_full, но на внешнем (разделяемом) пуле.
+     *
+     * @param pool Пул потоков, на котором выполняется свертка.
+     * @param img_in Указатель на исходные данные.
+     * @param w Ширина изображения.
+     * @param h Высота изображения.
+     * @param priority Приоритет задач (по одной на строку).
+     * @return std::vector<unsigned char> Буфер с обработанным изображением.
+     */
+    std::vector<unsigned char> process_thread_pool_full(ThreadPool& pool, const unsigned char* img_in, int w, int h,
+                                                        TaskPriority priority = TaskPriority::Normal);
+
     /**
      * @brief Сохраняет изображение на диск (в формате JPG).
      * 
@@ -81,9 +398,116 @@ public:
      */
     bool saveImage(const char* filename, int w, int h, const unsigned char* data);
 
+    /**
+     * @brief Сохраняет 8-битное изображение с заданным количеством каналов (в формате JPG).
+     */
+    bool saveImage(const char* filename, int w, int h, int channels, const unsigned char* data);
+
+    /**
+     * @brief Сохраняет 16-битное изображение (1..4 канала) в PNG с глубиной 16 бит без потерь.
+     * Результат process_native<unsigned short, C> читается обратно через loadImage16.
+     */
+    bool saveImage16(const char* filename, int w, int h, int channels, const unsigned short* data);
+
+    /**
+     * @brief Сохраняет float-изображение в Radiance HDR (stbi_write_hdr), читается loadImageF.
+     * Формат RGBE: 8 бит мантиссы на канал при общей экспоненте (относительная точность
+     * около 1/256 от наибольшего канала пикселя), отрицательные значения не представимы,
+     * альфа не сохраняется (при загрузке 3 канала, серое - 3 одинаковых).
+     */
+    bool saveImageF(const char* filename, int w, int h, int channels, const float* data);
+
 private:
-    // Внутреннее состояние: только параметры ядра
-    std::vector<float> m_kernel;
+    /**
+     * @brief Тапы ядра с одинаковым весом (орбита под найденными симметриями).
+     */
+    struct FoldedTap {
+        float weight = 0.f;
+        int count = 0;     ///< 1, 2 или 4 тапа
+        int dx[4] = {};    ///< Смещения от центра ядра
+        int dy[4] = {};
+    };
+
+    /**
+     * @brief Находит симметрии и разложение ядра, строит списки сложенных тапов.
+     */
+    void prepare_folded_taps() const;
+
+    /**
+     * @brief Плотное ядро m_kW x m_kH из m_sparse_taps, упаковка весов и сложенные тапы.
+     * Выполняется один раз (call_once), безопасно из нескольких потоков.
+     */
+    void prepare_dense() const;
+
+    static unsigned detect_symmetry(const std::vector<float>& kernel, int kW, int kH);
+    static std::vector<FoldedTap> fold_taps(const std::vector<float>& kernel, int kW, int kH, unsigned symmetry);
+
+    /**
+     * @brief Копирует границы (kW / 2 столбцов и kH / 2 строк) из img_in в out без изменений.
+     */
+    void copy_border(const unsigned char* img_in, int w, int h, unsigned char* out) const;
+
+    /**
+     * @brief Внутренняя часть process_region: свертка без границ и без замеров времени.
+     * Прямоугольник уже обрезан по изображению.
+     */
+    void convolve_region_SIMD(const unsigned char* img_in, int w, int h, unsigned char* img_out,
+                              int x0, int y0, int x1, int y1) const;
+
+    /**
+     * @brief Ненулевой тап ядра: смещение от центра и вес.
+     */
+    struct SparseTap {
+        int dx = 0;
+        int dy = 0;
+        float weight = 0.f;
+    };
+
+    /**
+     * @brief Собирает ненулевые тапы исходного ядра kW x kH построчно (в порядке
+     * process_SIMD) со смещениями, умноженными на dilation.
+     */
+    void prepare_sparse_taps(const std::vector<float>& kernel, int kW, int kH);
+
+    /**
+     * @brief Внутренние строки [y0, y1) результата process_sparse (без границ).
+     */
+    void sparse_rows(const unsigned char* img_in, int w, unsigned char* img_out, int y0, int y1) const;
+
+    /**
+     * @brief Четверки изображений [g0, g1) пакетной свертки (последняя может быть неполной).
+     */
+    void batch_groups(const unsigned char* const* inputs, unsigned char* const* outputs, int count,
+                      int w, int h, int g0, int g1) const;
+
+    void process_folded_2d(const unsigned char* img_in, int w, int h, unsigned char* img_out) const;
+    void process_folded_separable(const unsigned char* img_in, int w, int h, unsigned char* img_out) const;
+
+    /**
+     * @brief Блочная свертка (см. process_SIMD_blocked) в готовый буфер w * h * 4.
+     */
+    void process_blocked_into(const unsigned char* img_in, int w, int h, unsigned char* img_out);
+
+    /**
+     * @brief Строки [oyStart, oyStop) прореженного результата (см. process_decimate).
+     */
+    void decimate_rows(const unsigned char* img_in, int w, int h, int factor,
+                       unsigned char* img_out, int out_w, int oyStart, int oyStop) const;
+
+    // Внутреннее состояние: параметры ядра и необязательный реестр метрик
     int m_kW;
     int m_kH;
+    int m_dilation = 1;
+    std::vector<SparseTap> m_sparse_taps;  ///< Ненулевые тапы ядра - основное представление
+
+    // Плотное представление (prepare_dense): кэш, заполняемый один раз
+    mutable std::once_flag m_dense_once;
+    mutable std::vector<float> m_kernel;
+    mutable std::vector<float> m_packed_weights;  ///< Каждый вес ядра, размноженный на 16 линий zmm
+    mutable unsigned m_symmetry = 0;
+    mutable std::vector<FoldedTap> m_folded_taps;  ///< Ядро целиком, тапы сложены по m_symmetry
+    mutable bool m_separable = false;
+    mutable std::vector<FoldedTap> m_row_taps;     ///< Сепарабельное ядро: проход по x (dy = 0)
+    mutable std::vector<FoldedTap> m_col_taps;     ///< Сепарабельное ядро: проход по y (dx = 0)
+    MetricsRegistry* m_metrics = nullptr;
 };
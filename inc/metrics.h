@@ -0,0 +1,234 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Этап обработки изображения, для которого собирается латентность.
+ */
+enum class MetricStage {
+    Load = 0,   ///< Загрузка с диска (loadImage*)
+    Convolve,   ///< Свертка внутренней области
+    Border,     ///< Копирование границ
+    Save,       ///< Сохранение на диск (saveImage)
+    Count
+};
+
+/**
+ * @brief Вариант реализации (метка variant).
+ */
+enum class MetricVariant {
+    Io = 0,          ///< Загрузка и сохранение (не зависят от варианта свертки)
+    Default,
+    SIMD,
+    SIMDBlocked,
+    ThreadPool,
+    ThreadPoolFull,
+    Native,
+    Decimate,
+    Folded,
+    Sparse,
+    Batch,
+    Count
+};
+
+/**
+ * @brief Снимок одной гистограммы.
+ */
+struct HistogramSnapshot {
+    uint64_t count = 0;             ///< Количество измерений
+    uint64_t sum_ns = 0;            ///< Сумма измерений
+    uint64_t max_ns = 0;            ///< Максимальное измерение
+    std::vector<uint64_t> buckets;  ///< Счетчики по корзинам (см. LatencyHistogram)
+
+    /**
+     * @brief Квантиль q из [0, 1] (верхняя граница корзины, не больше max_ns).
+     */
+    uint64_t quantile_ns(double q) const;
+
+    /**
+     * @brief Среднее значение.
+     */
+    double mean_ns() const;
+};
+
+/**
+ * @brief Гистограмма латентности с фиксированными log-linear корзинами (в стиле HDR Histogram).
+ *
+ * Каждая степень двойки делится на 16 равных корзин, поэтому относительная
+ * погрешность квантилей не превышает 1/16 (6.25%). Диапазон от 1 нс до ~18 минут.
+ * Запись - несколько relaxed-операций над атомиками, без блокировок.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 4;
+    static constexpr int kSubBuckets = 1 << kSubBucketBits;
+    static constexpr int kMaxExponent = 40;
+    static constexpr int kBucketCount = kSubBuckets + (kMaxExponent - kSubBucketBits) * kSubBuckets;
+
+    LatencyHistogram() = default;
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    /**
+     * @brief Добавляет измерение.
+     */
+    void record(uint64_t value_ns);
+
+    /**
+     * @brief Снимок текущих значений (не атомарен по отношению к параллельной записи).
+     */
+    HistogramSnapshot snapshot() const;
+
+    /**
+     * @brief Обнуляет гистограмму.
+     */
+    void reset();
+
+    /**
+     * @brief Номер корзины для значения.
+     */
+    static int bucket_index(uint64_t value_ns);
+
+    /**
+     * @brief Верхняя граница корзины (включительно).
+     */
+    static uint64_t bucket_upper(int index);
+
+private:
+    std::atomic<uint64_t> m_buckets[kBucketCount] = {};
+    std::atomic<uint64_t> m_sum{0};
+    std::atomic<uint64_t> m_max{0};
+};
+
+/**
+ * @brief Снимок всех непустых гистограмм реестра.
+ */
+struct MetricsSnapshot {
+    struct Entry {
+        MetricStage stage;
+        MetricVariant variant;
+        int size_bucket;
+        HistogramSnapshot histogram;
+    };
+    std::vector<Entry> entries;
+};
+
+/**
+ * @brief Реестр гистограмм латентности: этап x вариант x корзина размера.
+ *
+ * Все гистограммы выделяются в конструкторе, поэтому запись не аллоцирует
+ * память и не берет блокировок. Подключается к ImageConvolver через set_metrics().
+ */
+class MetricsRegistry {
+public:
+    /**
+     * @brief Количество корзин размера: <= 64^2, <= 256^2, <= 1024^2, <= 4096^2 пикселей и больше.
+     */
+    static constexpr int kSizeBuckets = 5;
+
+    MetricsRegistry();
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    /**
+     * @brief Записывает длительность этапа для изображения w x h.
+     */
+    void record(MetricStage stage, MetricVariant variant, int w, int h, uint64_t duration_ns);
+
+    /**
+     * @brief Гистограмма для конкретной комбинации меток.
+     */
+    const LatencyHistogram& histogram(MetricStage stage, MetricVariant variant, int size_bucket) const;
+
+    /**
+     * @brief Снимок всех непустых гистограмм.
+     */
+    MetricsSnapshot snapshot() const;
+
+    /**
+     * @brief Обнуляет все гистограммы.
+     */
+    void reset();
+
+    /**
+     * @brief Текстовый формат экспозиции Prometheus (summary с квантилями 0.5/0.9/0.99/0.999).
+     */
+    std::string expose_text() const;
+
+    /**
+     * @brief Корзина размера для изображения w x h.
+     */
+    static int size_bucket(int w, int h);
+
+    static const char* stage_name(MetricStage stage);
+    static const char* variant_name(MetricVariant variant);
+    static const char* size_bucket_name(int size_bucket);
+
+    /**
+     * @brief Монотонное время в наносекундах.
+     */
+    static uint64_t now_ns();
+
+private:
+    static size_t slot(MetricStage stage, MetricVariant variant, int size_bucket);
+
+    std::unique_ptr<LatencyHistogram[]> m_histograms;
+};
+
+/**
+ * @brief Замер этапа: время от конструктора до stop() (или деструктора).
+ * Если реестр не задан (nullptr), часы не читаются вовсе.
+ */
+class StageTimer {
+public:
+    StageTimer(MetricsRegistry* registry, MetricStage stage, MetricVariant variant, int w, int h)
+        : m_registry(registry), m_stage(stage), m_variant(variant), m_w(w), m_h(h),
+          m_start(registry ? MetricsRegistry::now_ns() : 0)
+    {
+    }
+
+    ~StageTimer() {
+        stop();
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    /**
+     * @brief Уточняет размер (например, после загрузки изображения).
+     */
+    void set_size(int w, int h) {
+        m_w = w;
+        m_h = h;
+    }
+
+    /**
+     * @brief Не записывать замер (например, если этап завершился ошибкой).
+     */
+    void cancel() {
+        m_registry = nullptr;
+    }
+
+    /**
+     * @brief Записывает замер; повторные вызовы ничего не делают.
+     */
+    void stop() {
+        if (m_registry) {
+            m_registry->record(m_stage, m_variant, m_w, m_h, MetricsRegistry::now_ns() - m_start);
+            m_registry = nullptr;
+        }
+    }
+
+private:
+    MetricsRegistry* m_registry;
+    MetricStage m_stage;
+    MetricVariant m_variant;
+    int m_w;
+    int m_h;
+    uint64_t m_start;
+};
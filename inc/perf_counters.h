@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Аппаратные счетчики производительности (Linux perf_event_open).
+ *
+ * Каждый счетчик открывается отдельно с наследованием в дочерние потоки,
+ * поэтому в сумму попадают и рабочие потоки ThreadPool, созданные после start().
+ * Если счетчик недоступен (нет прав, контейнер, виртуальная машина без PMU),
+ * он просто помечается невалидным; если недоступны все - available() == false.
+ * На платформах кроме Linux класс компилируется в заглушку.
+ */
+class PerfCounters {
+public:
+    /**
+     * @brief Набор отслеживаемых событий.
+     */
+    enum Event {
+        Cycles = 0,
+        Instructions,
+        L1DMisses,
+        LLCMisses,
+        BranchMisses,
+        EventCount
+    };
+
+    /**
+     * @brief Значения счетчиков (с поправкой на мультиплексирование).
+     */
+    struct Values {
+        std::array<uint64_t, EventCount> value{};  ///< Значение события
+        std::array<bool, EventCount> valid{};      ///< Удалось ли открыть счетчик
+    };
+
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * @brief Есть ли хотя бы один рабочий счетчик.
+     */
+    bool available() const;
+
+    /**
+     * @brief Обнуляет и запускает счетчики.
+     */
+    void start();
+
+    /**
+     * @brief Останавливает счетчики.
+     */
+    void stop();
+
+    /**
+     * @brief Считывает накопленные значения.
+     */
+    Values read() const;
+
+    /**
+     * @brief Короткое имя события (для отчетов).
+     */
+    static const char* event_name(Event event);
+
+private:
+    std::array<int, EventCount> m_fds;
+};
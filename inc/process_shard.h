@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "image_convolver.h"
+
+/**
+ * @brief Свертка в нескольких процессах через разделяемую память POSIX.
+ *
+ * Координатор (процесс, создавший объект) один раз порождает num_workers
+ * рабочих процессов (fork) и держит сегмент shm_open с входным и выходным
+ * изображением. Кадр: координатор кладет вход в input_buffer(), run() будит
+ * каждого рабочего его процессным семафором запуска, рабочие сворачивают
+ * свои полосы строк прямо в выходную половину сегмента и поднимают общий
+ * семафор завершения. Вместе семафоры работают как барьер, но координатор
+ * ждет с таймаутом и проверяет рабочих (waitpid WNOHANG): если рабочий умер,
+ * run() бросает исключение вместо вечного ожидания.
+ * Полосы те же, что у process_thread_pool (ImageConvolver::split_rows);
+ * соседние kH/2 строк (ореол) рабочий читает из общего входа, без копий.
+ * Результат совпадает с process_SIMD побитово.
+ *
+ * Только POSIX (Linux); на других платформах конструктор бросает
+ * std::runtime_error. Рабочие завершаются вместе с координатором
+ * (PR_SET_PDEATHSIG). Объект не потокобезопасен: кадры идут по одному.
+ * После смерти рабочего остальные завершаются, и объект годится только
+ * для разрушения.
+ */
+class ProcessShardConvolver {
+public:
+    /**
+     * @brief Порождает рабочие процессы.
+     *
+     * @param num_workers Количество процессов (0 - по числу аппаратных потоков).
+     * @throws std::runtime_error если не удалось создать процессы или семафоры.
+     */
+    ProcessShardConvolver(const std::vector<float>& kernel, int kW, int kH, size_t num_workers = 0);
+
+    /**
+     * @brief Останавливает и дожидается рабочих, удаляет разделяемую память.
+     */
+    ~ProcessShardConvolver();
+
+    ProcessShardConvolver(const ProcessShardConvolver&) = delete;
+    ProcessShardConvolver& operator=(const ProcessShardConvolver&) = delete;
+
+    /**
+     * @brief Входной буфер w * h * 4 в разделяемой памяти для следующего run().
+     * Сегмент пересоздается, если кадр не помещается в текущий или рабочий
+     * не смог отобразить текущий в прошлом run().
+     * @throws std::runtime_error если не удалось создать сегмент.
+     */
+    unsigned char* input_buffer(int w, int h);
+
+    /**
+     * @brief Сворачивает текущее содержимое input_buffer() в рабочих процессах.
+     * @return Выход w * h * 4 в разделяемой памяти; действителен до следующего
+     *         input_buffer() или run().
+     * @throws std::runtime_error если рабочий не смог отобразить сегмент (объект
+     *         остается рабочим: повторный run() повторит отображение, а
+     *         input_buffer() создаст новый сегмент) или рабочий процесс
+     *         завершился (тогда завершаются и остальные).
+     */
+    const unsigned char* run();
+
+    /**
+     * @brief Копирует вход в разделяемую память, выполняет run() и копирует результат.
+     */
+    std::vector<unsigned char> process(const unsigned char* img_in, int w, int h);
+
+    size_t worker_count() const { return m_workers.size(); }
+
+    /**
+     * @brief pid живых рабочих процессов (пусто после сбоя run()).
+     */
+    const std::vector<int>& worker_pids() const { return m_workers; }
+
+private:
+    struct Control;
+
+    void map_segment(size_t half_capacity);
+    void unmap_segment();
+    void unlink_segment();
+    void stop_workers();
+    void kill_workers();
+    void destroy_control(size_t start_semaphores, bool done_semaphore);
+
+    /**
+     * @brief Ждет семафор завершения от всех рабочих; при таймауте проверяет,
+     * не завершился ли кто-то из них.
+     * @throws std::runtime_error если рабочий умер (остальные убиваются).
+     */
+    void wait_frame_done();
+
+    /**
+     * @brief Собирает завершившегося рабочего (waitpid WNOHANG), убирает его
+     * из m_workers и возвращает описание причины; пусто, если все живы.
+     */
+    std::string find_exited_worker();
+
+    static void worker_main(Control* control, ImageConvolver& convolver, size_t index);
+
+    ImageConvolver m_convolver;
+    std::vector<int> m_workers;     ///< pid рабочих процессов
+    Control* m_control = nullptr;   ///< Анонимное MAP_SHARED-отображение, общее с рабочими
+    size_t m_control_size = 0;
+
+    unsigned char* m_segment = nullptr;   ///< [вход | выход], по half_capacity байт
+    size_t m_segment_size = 0;
+    std::string m_segment_name;
+    bool m_segment_linked = false;        ///< Имя еще не удалено (рабочие не отобразили сегмент)
+    bool m_segment_failed = false;        ///< Рабочий не отобразил сегмент: input_buffer() создаст новый
+    bool m_broken = false;                ///< Рабочий умер, остальные убиты: run() больше невозможен
+    int m_w = 0;
+    int m_h = 0;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <immintrin.h>
+#include <vector>
+
+#include "thread_pool.h"
+
+/**
+ * @brief Рекурсивное (IIR) гауссово размытие Young - van Vliet 3-го порядка для RGBA.
+ *
+ * Задается сигмой, а не ядром: каждая строка и каждый столбец проходятся
+ * прямым (каузальным) и обратным фильтром с 3 коэффициентами, поэтому стоимость
+ * на пиксель не зависит от сигмы (в отличие от FIR-ядра шириной ~6 sigma + 1).
+ * Проход по строкам идет сразу по 4 строкам (4 пикселя RGBA в одном zmm),
+ * проход по столбцам - по 4 соседним пикселям строки (16 float подряд).
+ * Край продолжается повтором крайнего пикселя (на правом и нижнем краю -
+ * точные начальные условия Triggs - Sdika), поэтому обрабатывается все
+ * изображение, включая границы. Альфа-канал копируется из исходного изображения.
+ * Приближение гауссианы: погрешность около 1% для sigma >= 1, для меньших
+ * сигм точнее FIR-ядро (см. BM_RecursiveGaussian).
+ */
+class RecursiveGaussian {
+public:
+    /// Нижняя граница сигмы, для которой справедливы коэффициенты Young - van Vliet
+    static constexpr float kMinSigma = 0.5f;
+
+    /**
+     * @param sigma Среднеквадратичное отклонение в пикселях (>= kMinSigma).
+     * @throws std::invalid_argument для sigma < kMinSigma.
+     */
+    explicit RecursiveGaussian(float sigma);
+
+    float sigma() const { return m_sigma; }
+
+    /**
+     * @brief Размытие в одном потоке.
+     *
+     * @param img_in Указатель на исходные данные (RGBA).
+     * @param w Ширина изображения.
+     * @param h Высота изображения.
+     * @return std::vector<unsigned char> Буфер с обработанным изображением.
+     */
+    std::vector<unsigned char> process(const unsigned char* img_in, int w, int h);
+
+    /**
+     * @brief То же, проходы по строкам и по столбцам делятся на полосы на внешнем пуле.
+     */
+    std::vector<unsigned char> process_thread_pool(ThreadPool& pool, const unsigned char* img_in, int w, int h);
+
+    /**
+     * @brief То же на временном пуле из num_threads потоков (0 - по числу ядер).
+     */
+    std::vector<unsigned char> process_thread_pool(const unsigned char* img_in, int w, int h, size_t num_threads = 0);
+
+private:
+    /**
+     * @brief Состояние (y[N], y[N+1], y[N+2]) обратного прохода по последнему входу
+     * и трем последним значениям прямого прохода.
+     */
+    void edge_state(__m512 last, __m512 w1, __m512 w2, __m512 w3, __m512& y1, __m512& y2, __m512& y3) const;
+
+    /**
+     * @brief Строки [y0, y1): вход u8 -> промежуточный float RGBA.
+     */
+    void horizontal_rows(const unsigned char* img_in, int w, int h, float* tmp, int y0, int y1) const;
+
+    /**
+     * @brief Группы столбцов [g0, g1) по 4 пикселя: float (на месте) -> выход u8.
+     */
+    void vertical_columns(const unsigned char* img_in, int w, int h, float* tmp, unsigned char* img_out,
+                          int g0, int g1) const;
+
+    float m_sigma;
+    float m_B;    ///< Нормирующий множитель входа
+    float m_a1;   ///< b1 / b0
+    float m_a2;   ///< b2 / b0
+    float m_a3;   ///< b3 / b0
+    float m_edge[3][3];  ///< Матрица Triggs - Sdika для правого (нижнего) края
+};
@@ -1,23 +1,49 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <future>
 #include <thread>
 #include <vector>
-#include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
+#include <memory>
 #include <atomic>
+#include <exception>
+#include <algorithm>
 #include <type_traits>
 #include <utility>
 #include <stdexcept>
 
+/**
+ * @brief Класс приоритета задачи.
+ *
+ * Классы строгие: задача берется из самого высокого непустого класса
+ * (от голодания низших классов защищает квота ThreadPool::kStarvationQuota).
+ */
+enum class TaskPriority {
+    High = 0,    ///< Интерактивные задачи (маленькие изображения)
+    Normal = 1,  ///< Приоритет по умолчанию
+    Low = 2      ///< Фоновые задачи (большие изображения)
+};
+
+class TaskGroup;
+
 /**
  * @brief Пул потоков для асинхронного выполнения задач.
  *
  * Класс предоставляет интерфейс для выполнения задач в отдельных потоках.
  * Задачи помещаются в очередь и выполняются доступными потоками.
  * Деструктор гарантирует завершение всех поставленных задач.
+ *
+ * Для каждого класса приоритета своя очередь. Поток берет задачу из самого
+ * высокого непустого класса, поэтому интерактивная задача обгоняет все уже
+ * поставленные фоновые задачи независимо от того, как давно они ждут.
+ * Низший класс не голодает: если он непуст и был пропущен kStarvationQuota
+ * раз подряд, следующая задача берется из него. Внутри класса задачи
+ * упорядочены по явному дедлайну, при равных дедлайнах - FIFO.
  */
 class ThreadPool {
 public:
@@ -43,16 +69,57 @@ public:
      */
     ~ThreadPool();
 
+    using Clock = std::chrono::steady_clock;
+
     /**
      * @brief Добавляет задачу в очередь на выполнение.
      *
      * @tparam Fn Тип функции задачи.
      * @tparam T Тип возвращаемого значения функции.
      * @param f Функция для выполнения.
+     * @param priority Приоритет задачи.
      * @return std::future<T> Объект для получения результата выполнения.
      */
     template<typename Fn, typename T = typename std::invoke_result_t<Fn>>
-    std::future<T> dispatch_task(Fn&& f);
+    std::future<T> dispatch_task(Fn&& f, TaskPriority priority = TaskPriority::Normal);
+
+    /**
+     * @brief Добавляет задачу в очередь с явным дедлайном.
+     *
+     * Дедлайн упорядочивает задачи только внутри своего класса приоритета:
+     * задача выполняется раньше задач того же класса с более поздним дедлайном
+     * и задач без дедлайна.
+     *
+     * @param f Функция для выполнения.
+     * @param priority Приоритет задачи.
+     * @param deadline Желаемый момент начала выполнения.
+     * @return std::future<T> Объект для получения результата выполнения.
+     */
+    template<typename Fn, typename T = typename std::invoke_result_t<Fn>>
+    std::future<T> dispatch_task(Fn&& f, TaskPriority priority, Clock::time_point deadline);
+
+    /**
+     * @brief Делит [begin, end) на не более чем get_thread_count() непрерывных частей
+     * и вызывает body(part_begin, part_end) для каждой. Последняя часть выполняется
+     * в вызывающем потоке, остальные - задачами TaskGroup; ожидание выполняет еще
+     * не взятые части. Поэтому вызов безопасен внутри задачи пула (вложенные
+     * parallel_for не блокируют рабочие потоки). Исключение из body пробрасывается.
+     *
+     * @param begin Начало диапазона.
+     * @param end Конец диапазона (не включается).
+     * @param body Вызываемый объект void(int, int).
+     * @param priority Приоритет задач частей.
+     */
+    template<typename Fn>
+    void parallel_for(int begin, int end, Fn&& body, TaskPriority priority = TaskPriority::Normal);
+
+    /**
+     * @brief Сколько выборок подряд непустой класс может быть пропущен ради более
+     * высоких классов. Гарантирует низшему классу не меньше 1 / (kStarvationQuota + 1)
+     * выборок, а интерактивной задаче - ожидание не дольше kStarvationQuota
+     * фоновых задач на поток.
+     */
+    static constexpr unsigned kStarvationQuota = 8;
 
     /**
      * @brief Возвращает количество рабочих потоков.
@@ -65,6 +132,8 @@ public:
     size_t get_queue_size() const;
 
 private:
+    friend class TaskGroup;
+
     /**
      * @brief Структура для хранения задачи в очереди.
      *
@@ -73,6 +142,11 @@ private:
      */
     struct Task {
         std::function<void()> func;  ///< Функция для выполнения
+        Clock::time_point deadline;  ///< Явный дедлайн (ключ очереди внутри класса)
+        uint64_t seq = 0;            ///< Порядковый номер (FIFO при равных дедлайнах)
+        uint64_t enqueue_ns = 0;     ///< Время постановки для трассировки (0 - не трассируется)
+        uint64_t flow_id = 0;        ///< Стрелка "поставлена -> взята" на временной шкале
+        TaskPriority priority = TaskPriority::Normal;
 
         Task() = default;
 
@@ -83,12 +157,48 @@ private:
         explicit Task(std::function<void()> f) : func(std::move(f)) {}
     };
 
+    /**
+     * @brief Компаратор кучи: наверху задача с самым ранним дедлайном.
+     */
+    struct TaskLater {
+        bool operator()(const Task& a, const Task& b) const {
+            if (a.deadline != b.deadline) {
+                return a.deadline > b.deadline;
+            }
+            return a.seq > b.seq;
+        }
+    };
+
+    /**
+     * @brief Ставит задачу в очередь ее класса приоритета.
+     */
+    void enqueue_task(std::function<void()> func, TaskPriority priority, Clock::time_point deadline);
+
+    /**
+     * @brief Извлекает следующую задачу: самый высокий непустой класс, если ни один
+     * низший класс не исчерпал квоту пропусков. Вызывается под m_queue_mutex,
+     * хотя бы одна очередь непуста.
+     */
+    Task pop_task();
+
+    /**
+     * @brief Суммарное число задач во всех классах (под m_queue_mutex).
+     */
+    size_t queued_tasks() const;
+
+    /**
+     * @brief Выполняет задачу (с записью в трассировку, если она включена).
+     */
+    void execute(Task& task);
+
     /**
      * @brief Основной цикл рабочего потока.
      *
      * Ожидает задачи из очереди и выполняет их.
+     *
+     * @param index Номер потока (имя на временной шкале трассировки).
      */
-    void worker_thread();
+    void worker_thread(size_t index);
 
     /**
      * @brief Останавливает все рабочие потоки.
@@ -98,14 +208,135 @@ private:
     void stop_all_threads();
 
     std::vector<std::thread> m_workers;        ///< Вектор рабочих потоков
-    std::queue<Task> m_tasks;                  ///< Очередь задач
+    static constexpr size_t kPriorityCount = 3;
+
+    std::vector<Task> m_tasks[kPriorityCount]; ///< Очереди классов (двоичные кучи по дедлайну)
+    unsigned m_skipped[kPriorityCount] = {};   ///< Пропуски непустого класса подряд
+    uint64_t m_next_seq = 0;                   ///< Счетчик для порядковых номеров задач
     mutable std::mutex m_queue_mutex;          ///< Мьютекс для синхронизации доступа к очереди
     std::condition_variable m_condition;       ///< Условная переменная для уведомления потоков
     std::atomic<bool> m_stop{false};           ///< Флаг остановки пула потоков
 };
 
+/**
+ * @brief Группа задач на пуле с ожиданием, которое выполняет задачи своей группы.
+ *
+ * Задачи группы лежат в ее собственной очереди, а в очередь пула для каждой
+ * ставится "билет" с приоритетом группы: рабочий поток, взявший билет, берет
+ * первую еще не взятую задачу группы (или ничего, если их уже разобрали).
+ * wait() не блокирует поток, пока у группы есть не взятые задачи: он выполняет
+ * их сам. Поэтому задача пула может ставить подзадачи и ждать их, не рискуя
+ * взаимной блокировкой, даже когда все рабочие потоки делают то же самое
+ * (вложенный параллелизм на любую глубину). Чужие задачи ожидающий поток
+ * не берет: ожидание группы High не застрянет в длинной задаче Low.
+ */
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool, TaskPriority priority = TaskPriority::Normal)
+        : m_pool(pool), m_priority(priority), m_state(std::make_shared<State>()) {}
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    /**
+     * @brief Дожидается оставшихся задач (исключения при этом теряются).
+     */
+    ~TaskGroup();
+
+    /**
+     * @brief Ставит задачу в очередь группы и билет на нее в очередь пула.
+     */
+    template<typename Fn>
+    void run(Fn&& f);
+
+    /**
+     * @brief Ждет все задачи группы, выполняя еще не взятые задачи этой группы.
+     * Пробрасывает первое исключение, выброшенное задачами группы.
+     */
+    void wait();
+
+private:
+    /**
+     * @brief Общее с билетами состояние: билет может быть взят из очереди пула
+     * уже после разрушения группы и тогда не находит задач.
+     */
+    struct State {
+        std::mutex mutex;
+        std::condition_variable changed;          ///< Новая задача или завершение последней
+        std::deque<std::function<void()>> queue;  ///< Еще не взятые задачи группы
+        size_t pending = 0;                       ///< Поставленные, но еще не завершенные задачи
+        std::exception_ptr error;                 ///< Первое исключение задач группы
+    };
+
+    /**
+     * @brief Берет и выполняет первую не взятую задачу группы.
+     * @return false, если очередь группы пуста.
+     */
+    static bool run_one(State& state);
+
+    /**
+     * @brief Выполняет задачи группы, пока есть не взятые, затем ждет завершения остальных.
+     */
+    void help_until_done();
+
+    ThreadPool& m_pool;
+    TaskPriority m_priority;
+    std::shared_ptr<State> m_state;
+};
+
+template<typename Fn>
+void TaskGroup::run(Fn&& f) {
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->queue.emplace_back(std::forward<Fn>(f));
+        ++m_state->pending;
+    }
+    m_state->changed.notify_all();
+    try {
+        m_pool.enqueue_task([state = m_state]() { run_one(*state); },
+                            m_priority, ThreadPool::Clock::time_point::max());
+    } catch (...) {
+        // Пул остановлен: задача снимается (группу наполняет один поток)
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        m_state->queue.pop_back();
+        --m_state->pending;
+        throw;
+    }
+}
+
+template<typename Fn>
+void ThreadPool::parallel_for(int begin, int end, Fn&& body, TaskPriority priority) {
+    if (begin >= end) {
+        return;
+    }
+    // Разбиение как у ImageConvolver::split_rows: первые total % parts частей длиннее на 1
+    const int total = end - begin;
+    const int parts = static_cast<int>(std::min<size_t>(std::max<size_t>(get_thread_count(), 1),
+                                                        static_cast<size_t>(total)));
+    const int base = total / parts;
+    const int rem = total % parts;
+
+    TaskGroup group(*this, priority);
+    int start = begin;
+    for (int i = 0; i < parts; ++i) {
+        const int stop = start + base + (i < rem ? 1 : 0);
+        if (i + 1 == parts) {
+            body(start, stop);
+        } else {
+            group.run([&body, start, stop]() { body(start, stop); });
+        }
+        start = stop;
+    }
+    group.wait();
+}
+
 template<typename Fn, typename T>
-std::future<T> ThreadPool::dispatch_task(Fn&& f) {
+std::future<T> ThreadPool::dispatch_task(Fn&& f, TaskPriority priority) {
+    return dispatch_task<Fn, T>(std::forward<Fn>(f), priority, Clock::time_point::max());
+}
+
+template<typename Fn, typename T>
+std::future<T> ThreadPool::dispatch_task(Fn&& f, TaskPriority priority, Clock::time_point deadline) {
     auto promise = std::make_shared<std::promise<T>>();
     std::future<T> future = promise->get_future();
 
@@ -125,15 +356,7 @@ std::future<T> ThreadPool::dispatch_task(Fn&& f) {
         }
     };
 
-    {
-        std::unique_lock<std::mutex> lock(m_queue_mutex);
-        if (m_stop) {
-            throw std::runtime_error("Cannot dispatch task: ThreadPool is stopped");
-        }
-        m_tasks.emplace(std::move(task_func));
-    }
-
-    m_condition.notify_one();
+    enqueue_task(std::move(task_func), priority, deadline);
 
     return future;
 }
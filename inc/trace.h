@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Запись временной шкалы выполнения в формате Chrome Trace Event (JSON).
+ *
+ * События пишутся в буфер текущего потока без блокировок: мьютекс берется
+ * только один раз при первой записи потока (регистрация буфера). Пока запись
+ * выключена, каждая точка трассировки стоит одну relaxed-загрузку атомарного флага.
+ * Результат открывается в chrome://tracing или https://ui.perfetto.dev.
+ *
+ * start() и write_json() нужно вызывать, когда трассируемая работа не выполняется.
+ * Имена событий и аргументов должны быть строковыми литералами (хранятся указатели).
+ */
+class Trace {
+public:
+    /**
+     * @brief Очищает накопленные события и включает запись.
+     */
+    static void start();
+
+    /**
+     * @brief Выключает запись (накопленные события сохраняются до write_json/start).
+     */
+    static void stop();
+
+    /**
+     * @brief Включена ли запись.
+     */
+    static bool enabled() {
+        return s_enabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Текущее время трассировки в наносекундах (steady_clock от старта процесса).
+     */
+    static uint64_t now_ns();
+
+    /**
+     * @brief Записывает завершенный интервал (фаза "X").
+     */
+    static void complete(const char* name, const char* category, uint64_t start_ns, uint64_t end_ns,
+                         const char* arg0_name = nullptr, int64_t arg0 = 0,
+                         const char* arg1_name = nullptr, int64_t arg1 = 0);
+
+    /**
+     * @brief Новый идентификатор стрелки (flow) между потоками.
+     */
+    static uint64_t next_flow_id();
+
+    /**
+     * @brief Начало стрелки: задача поставлена в очередь (фаза "s").
+     */
+    static void flow_begin(const char* name, uint64_t id, uint64_t ts_ns);
+
+    /**
+     * @brief Конец стрелки: задача взята на выполнение (фаза "f").
+     */
+    static void flow_end(const char* name, uint64_t id, uint64_t ts_ns);
+
+    /**
+     * @brief Задает имя текущего потока на временной шкале.
+     * Имя запоминается потоком и переживает start(): достаточно вызвать один раз,
+     * в том числе пока запись выключена.
+     */
+    static void set_thread_name(const std::string& name);
+
+    /**
+     * @brief Сохраняет все события в JSON-файл.
+     * @return true если успешно, false если ошибка записи.
+     */
+    static bool write_json(const char* path);
+
+private:
+    inline static std::atomic<bool> s_enabled{false};
+};
+
+/**
+ * @brief RAII-интервал: записывает событие "X" от конструктора до деструктора.
+ */
+class TraceScope {
+public:
+    TraceScope(const char* name, const char* category,
+               const char* arg0_name = nullptr, int64_t arg0 = 0,
+               const char* arg1_name = nullptr, int64_t arg1 = 0)
+        : m_name(name), m_category(category),
+          m_arg0_name(arg0_name), m_arg0(arg0), m_arg1_name(arg1_name), m_arg1(arg1),
+          m_start(Trace::enabled() ? Trace::now_ns() : 0)
+    {
+    }
+
+    ~TraceScope() {
+        if (m_start != 0 && Trace::enabled()) {
+            Trace::complete(m_name, m_category, m_start, Trace::now_ns(),
+                            m_arg0_name, m_arg0, m_arg1_name, m_arg1);
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_name;
+    const char* m_category;
+    const char* m_arg0_name;
+    int64_t m_arg0;
+    const char* m_arg1_name;
+    int64_t m_arg1;
+    uint64_t m_start;
+};
@@ -93,6 +93,17 @@ else:
     TPF_TITLE_TEMPLATE = 'ThreadPool Rows (Kernel {k}x{k})'
     VALUE_FORMAT = '%.3f'
 
+# Аппаратные счетчики (есть в JSON, если бенчмарк запущен с BLUR_PERF_COUNTERS=1)
+PERF_COUNTERS = {
+    'IPC': 'IPC (инструкций за такт)',
+    'cycles': 'Такты на итерацию',
+    'instructions': 'Инструкции на итерацию',
+    'l1d_misses': 'Промахи L1D на итерацию',
+    'llc_misses': 'Промахи LLC на итерацию',
+    'branch_misses': 'Ошибки предсказания переходов на итерацию',
+    'llc_miss_bw': 'Трафик промахов LLC (байт/с)',
+}
+
 # 1. Парсинг данных
 records = []
 for bench in data['benchmarks']:
@@ -106,6 +117,9 @@ for bench in data['benchmarks']:
     # далее: параметры (размер, ядро, потоки и т.д.)
     if len(name_parts) < 3:
         continue
+    # Остальные бенчмарки (пирамида, поток кадров и т.д.) имеют другие параметры
+    if name_parts[0] != 'BlurFixture':
+        continue
     
     method_raw = name_parts[1]
     numeric_parts = [int(part) for part in name_parts[2:] if part.isdigit()]
@@ -157,14 +171,18 @@ for bench in data['benchmarks']:
         method_group = 'Default'
         method = 'Default (C++)'
 
-    records.append({
+    record = {
         'Method': method,
         'Method Group': method_group,
         'Image Size': img_size,
         'Kernel Size': kernel_size,
         'Threads': threads,
         METRIC_FIELD: metric_value
-    })
+    }
+    for counter in PERF_COUNTERS:
+        if counter in bench:
+            record[counter] = bench[counter]
+    records.append(record)
 
 df = pd.DataFrame(records)
 
@@ -190,24 +208,25 @@ kernel_sizes = sorted(df['Kernel Size'].unique())
 
 saved_files = []
 
-def save_plot(subset, title, filename, hue, legend_title, hue_order=None):
+def save_plot(subset, title, filename, hue, legend_title, hue_order=None,
+              y=METRIC_FIELD, ylabel=METRIC_LABEL, value_format=VALUE_FORMAT):
     if subset.empty:
         return
     plt.figure(figsize=(12, 8))
     ax = sns.barplot(
         data=subset,
         x='Image Size',
-        y=METRIC_FIELD,
+        y=y,
         hue=hue,
         hue_order=hue_order,
         palette="viridis"
     )
     plt.title(title, fontsize=16, pad=20)
-    plt.ylabel(METRIC_LABEL, fontsize=14)
+    plt.ylabel(ylabel, fontsize=14)
     plt.xlabel('Размер изображения (NxN)', fontsize=14)
     plt.legend(title=legend_title, fontsize=12, title_fontsize=12)
     for container in ax.containers:
-        ax.bar_label(container, fmt=VALUE_FORMAT, padding=3, fontsize=10)
+        ax.bar_label(container, fmt=value_format, padding=3, fontsize=10)
     plt.tight_layout()
     plt.savefig(filename, dpi=150)
     print(f"Сохранено: {filename}")
@@ -254,6 +273,24 @@ for k_size in kernel_sizes:
             hue_order=THREAD_LABELS
         )
 
+# 4. Графики аппаратных счетчиков по вариантам и размерам
+for counter, counter_label in PERF_COUNTERS.items():
+    if counter not in df_main.columns:
+        continue
+    counter_df = df_main[df_main[counter].notna()]
+    for k_size in kernel_sizes:
+        subset = counter_df[counter_df['Kernel Size'] == k_size]
+        save_plot(
+            subset,
+            f'{counter_label} (Kernel {k_size}x{k_size})',
+            f'perf_{counter}_kernel_{k_size}.png',
+            hue='Method',
+            legend_title='Метод',
+            y=counter,
+            ylabel=counter_label,
+            value_format='%.2f' if counter == 'IPC' else '%.3g'
+        )
+
 if saved_files:
     print(f"\nГотово! Создано изображений: {len(saved_files)}.")
 else:
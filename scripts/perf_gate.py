@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+"""Проверка регрессии производительности по JSON-выводу Google Benchmark.
+
+Запускает run_image_benchmark с фильтром (или читает готовый JSON) и сравнивает
+пропускную способность каждого бенчмарка с сохраненным эталоном.
+Код возврата 1, если хотя бы один бенчмарк замедлился больше порога или пропал
+из текущего запуска (переименование или случайно суженный фильтр не должны
+проходить молча; намеренное удаление разрешается через --allow-missing).
+
+Примеры:
+  # записать эталон
+  python3 scripts/perf_gate.py --benchmark build/run_image_benchmark --update
+  # проверить (порог 10%)
+  python3 scripts/perf_gate.py --benchmark build/run_image_benchmark --threshold 10
+  # бенчмарк удален намеренно (регулярное выражение по имени, до обновления эталона)
+  python3 scripts/perf_gate.py --current out.json --allow-missing 'BM_ProcessDefault/1024/'
+"""
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+SCRIPT_DIR = os.path.dirname(os.path.abspath(__file__))
+DEFAULT_BASELINE = os.path.join(SCRIPT_DIR, '..', 'test', 'baseline', 'results_image_baseline.json')
+DEFAULT_FILTER = 'BlurFixture/BM_Process(Default|SIMD)/(256|1024)/(3|9)/'
+
+
+def run_benchmark(binary, bench_filter, repetitions):
+    fd, out_path = tempfile.mkstemp(suffix='.json')
+    os.close(fd)
+    cmd = [
+        binary,
+        f'--benchmark_filter={bench_filter}',
+        f'--benchmark_out={out_path}',
+        '--benchmark_out_format=json',
+    ]
+    if repetitions > 1:
+        cmd += [f'--benchmark_repetitions={repetitions}', '--benchmark_report_aggregates_only=true']
+    print('[perf_gate] ' + ' '.join(cmd))
+    subprocess.run(cmd, check=True, stdout=subprocess.DEVNULL)
+    with open(out_path, 'r') as f:
+        data = json.load(f)
+    os.remove(out_path)
+    return data
+
+
+def throughput(bench):
+    """Пропускная способность: bytes/s, items/s или 1/время (больше - лучше)."""
+    for key in ('bytes_per_second', 'items_per_second'):
+        if key in bench:
+            return float(bench[key])
+    real_time = bench.get('real_time')
+    if real_time:
+        return 1.0 / float(real_time)
+    return None
+
+
+def collect(data):
+    result = {}
+    for bench in data.get('benchmarks', []):
+        # При повторах сравниваем медиану, остальные агрегаты пропускаем
+        if bench.get('run_type') == 'aggregate' and bench.get('aggregate_name') != 'median':
+            continue
+        name = bench.get('run_name', bench['name'])
+        value = throughput(bench)
+        if value is not None:
+            result[name] = value
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Гейт регрессии производительности.')
+    parser.add_argument('--benchmark', help='Путь к run_image_benchmark (запуск с фильтром).')
+    parser.add_argument('--current', help='Готовый JSON с результатами вместо запуска.')
+    parser.add_argument('--baseline', default=DEFAULT_BASELINE, help='JSON с эталонными результатами.')
+    parser.add_argument('--filter', default=DEFAULT_FILTER, help='--benchmark_filter для запуска.')
+    parser.add_argument('--threshold', type=float, default=10.0,
+                        help='Допустимое падение пропускной способности, %%.')
+    parser.add_argument('--repetitions', type=int, default=3, help='Повторы (сравнивается медиана).')
+    parser.add_argument('--update', action='store_true', help='Перезаписать эталон текущими результатами.')
+    parser.add_argument('--allow-missing', action='append', default=[], metavar='REGEX',
+                        help='Не считать ошибкой отсутствие бенчмарков эталона с подходящим именем '
+                             '(можно повторять; \'.*\' - любые).')
+    args = parser.parse_args()
+
+    if args.current:
+        with open(args.current, 'r') as f:
+            current_data = json.load(f)
+    elif args.benchmark:
+        current_data = run_benchmark(args.benchmark, args.filter, args.repetitions)
+    else:
+        parser.error('нужен --benchmark или --current')
+
+    if args.update:
+        os.makedirs(os.path.dirname(os.path.abspath(args.baseline)), exist_ok=True)
+        with open(args.baseline, 'w') as f:
+            json.dump(current_data, f, indent=2)
+        print(f'[perf_gate] Эталон сохранен: {args.baseline}')
+        return 0
+
+    if not os.path.exists(args.baseline):
+        print(f'[perf_gate] Эталон не найден: {args.baseline}. Запустите с --update.')
+        return 1
+
+    with open(args.baseline, 'r') as f:
+        baseline = collect(json.load(f))
+    current = collect(current_data)
+
+    allowed_missing = [re.compile(pattern) for pattern in args.allow_missing]
+
+    failures = 0
+    missing = 0
+    compared = 0
+    for name, base_value in sorted(baseline.items()):
+        if name not in current:
+            if any(pattern.search(name) for pattern in allowed_missing):
+                print(f'[perf_gate] {"REMOVED":10s} {name}: разрешено --allow-missing')
+            else:
+                print(f'[perf_gate] {"MISSING":10s} {name}: нет в текущем запуске')
+                missing += 1
+            continue
+        compared += 1
+        change = (current[name] - base_value) / base_value * 100.0
+        status = 'OK'
+        if change < -args.threshold:
+            status = 'REGRESSION'
+            failures += 1
+        print(f'[perf_gate] {status:10s} {name}: {change:+.1f}%')
+
+    if compared == 0:
+        print('[perf_gate] Нет общих бенчмарков с эталоном.')
+        return 1
+
+    print(f'[perf_gate] Сравнено: {compared}, регрессий: {failures} (порог {args.threshold}%), '
+          f'пропало: {missing}')
+    return 1 if failures or missing else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
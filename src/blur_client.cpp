@@ -0,0 +1,235 @@
+#include "blur_client.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#if !defined(_WIN32)
+
+namespace {
+
+std::atomic<unsigned> g_shared_counter{0};
+
+std::runtime_error system_error(const char* what) {
+    return std::runtime_error(std::string("BlurClient: ") + what + ": " + std::strerror(errno));
+}
+
+void copy_path(char (&dst)[kBlurMaxPath], const std::string& src) {
+    if (src.size() >= kBlurMaxPath) {
+        throw std::runtime_error("BlurClient: path too long: " + src);
+    }
+    std::memcpy(dst, src.c_str(), src.size() + 1);
+}
+
+}  // namespace
+
+SharedImage::SharedImage(int w, int h)
+    : m_w(w), m_h(h)
+{
+    if (w <= 0 || h <= 0) {
+        throw std::runtime_error("SharedImage: invalid size");
+    }
+
+    // Имя нужно только на время создания: дальше память живет по дескриптору
+    char name[64];
+    std::snprintf(name, sizeof(name), "/blur_client_%d_%u", static_cast<int>(getpid()),
+                  g_shared_counter.fetch_add(1, std::memory_order_relaxed));
+    m_fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (m_fd < 0) {
+        throw system_error("shm_open");
+    }
+    shm_unlink(name);
+    fcntl(m_fd, F_SETFD, FD_CLOEXEC);
+
+    const size_t length = 2 * bytes();
+    void* p = MAP_FAILED;
+    if (ftruncate(m_fd, static_cast<off_t>(length)) == 0) {
+        p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    }
+    if (p == MAP_FAILED) {
+        std::runtime_error error = system_error("ftruncate/mmap");
+        close(m_fd);
+        throw error;
+    }
+    m_data = static_cast<unsigned char*>(p);
+}
+
+SharedImage::~SharedImage() {
+    munmap(m_data, 2 * bytes());
+    close(m_fd);
+}
+
+BlurClient::BlurClient(const std::string& socket_path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.empty() || socket_path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("BlurClient: invalid socket path: " + socket_path);
+    }
+    std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+
+    m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_fd < 0) {
+        throw system_error("socket");
+    }
+    fcntl(m_fd, F_SETFD, FD_CLOEXEC);
+    if (connect(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        std::runtime_error error = system_error("connect");
+        close(m_fd);
+        throw error;
+    }
+}
+
+BlurClient::~BlurClient() {
+    close(m_fd);
+}
+
+void BlurClient::send_request(const BlurJobRequest& request, const std::vector<float>& kernel, int fd) {
+    if (kernel.size() != static_cast<size_t>(request.kernel_dim) * request.kernel_dim) {
+        throw std::runtime_error("BlurClient: kernel size does not match kernel_dim");
+    }
+
+    iovec iov[2];
+    iov[0].iov_base = const_cast<BlurJobRequest*>(&request);
+    iov[0].iov_len = sizeof(request);
+    iov[1].iov_base = const_cast<float*>(kernel.data());
+    iov[1].iov_len = kernel.size() * sizeof(float);
+
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    if (fd >= 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        cmsghdr* c = CMSG_FIRSTHDR(&msg);
+        c->cmsg_level = SOL_SOCKET;
+        c->cmsg_type = SCM_RIGHTS;
+        c->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(c), &fd, sizeof(int));
+    }
+
+    int flags = 0;
+#if defined(MSG_NOSIGNAL)
+    flags |= MSG_NOSIGNAL;
+#endif
+    // Дескриптор уходит с первым отправленным байтом, остаток дописываем без него
+    const size_t total = iov[0].iov_len + iov[1].iov_len;
+    size_t sent = 0;
+    while (sent < total) {
+        ssize_t n = sendmsg(m_fd, &msg, flags);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw system_error("sendmsg");
+        }
+        sent += static_cast<size_t>(n);
+        msg.msg_control = nullptr;
+        msg.msg_controllen = 0;
+
+        size_t skip = static_cast<size_t>(n);
+        while (msg.msg_iovlen > 0 && skip >= msg.msg_iov[0].iov_len) {
+            skip -= msg.msg_iov[0].iov_len;
+            ++msg.msg_iov;
+            --msg.msg_iovlen;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov[0].iov_base = static_cast<char*>(msg.msg_iov[0].iov_base) + skip;
+            msg.msg_iov[0].iov_len -= skip;
+        }
+    }
+}
+
+void BlurClient::submit_file(const std::vector<float>& kernel, int dim,
+                             const std::string& input_path, const std::string& output_path, uint64_t id) {
+    BlurJobRequest request;
+    request.source = BlurJobSource::File;
+    request.id = id;
+    request.kernel_dim = dim;
+    copy_path(request.input_path, input_path);
+    copy_path(request.output_path, output_path);
+    send_request(request, kernel, -1);
+}
+
+void BlurClient::submit_shared(const std::vector<float>& kernel, int dim, const SharedImage& image, uint64_t id) {
+    BlurJobRequest request;
+    request.source = BlurJobSource::SharedMemory;
+    request.id = id;
+    request.kernel_dim = dim;
+    request.w = image.w();
+    request.h = image.h();
+    send_request(request, kernel, image.fd());
+}
+
+BlurJobReply BlurClient::wait_reply() {
+    BlurJobReply reply;
+    size_t got = 0;
+    while (got < sizeof(reply)) {
+        ssize_t n = recv(m_fd, reinterpret_cast<char*>(&reply) + got, sizeof(reply) - got, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            throw std::runtime_error("BlurClient: connection closed by daemon");
+        }
+        got += static_cast<size_t>(n);
+    }
+    if (reply.magic != kBlurProtocolMagic) {
+        throw std::runtime_error("BlurClient: bad reply");
+    }
+    return reply;
+}
+
+BlurJobReply BlurClient::blur_file(const std::vector<float>& kernel, int dim,
+                                   const std::string& input_path, const std::string& output_path) {
+    submit_file(kernel, dim, input_path, output_path);
+    return wait_reply();
+}
+
+BlurJobReply BlurClient::blur_shared(const std::vector<float>& kernel, int dim, const SharedImage& image) {
+    submit_shared(kernel, dim, image);
+    return wait_reply();
+}
+
+#else
+
+SharedImage::SharedImage(int w, int h)
+    : m_w(w), m_h(h)
+{
+    throw std::runtime_error("SharedImage: POSIX shared memory is not supported on this platform");
+}
+
+SharedImage::~SharedImage() = default;
+
+BlurClient::BlurClient(const std::string&) {
+    throw std::runtime_error("BlurClient: Unix domain sockets are not supported on this platform");
+}
+
+BlurClient::~BlurClient() = default;
+
+void BlurClient::submit_file(const std::vector<float>&, int, const std::string&, const std::string&, uint64_t) {}
+
+void BlurClient::submit_shared(const std::vector<float>&, int, const SharedImage&, uint64_t) {}
+
+BlurJobReply BlurClient::wait_reply() {
+    return {};
+}
+
+BlurJobReply BlurClient::blur_file(const std::vector<float>&, int, const std::string&, const std::string&) {
+    return {};
+}
+
+BlurJobReply BlurClient::blur_shared(const std::vector<float>&, int, const SharedImage&) {
+    return {};
+}
+
+#endif
@@ -0,0 +1,446 @@
+#include "blur_daemon.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#if !defined(_WIN32)
+
+namespace {
+
+uint64_t now_ns() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
+
+std::runtime_error system_error(const char* what) {
+    return std::runtime_error(std::string("BlurDaemon: ") + what + ": " + std::strerror(errno));
+}
+
+/**
+ * @brief Читает ровно len байт; дескриптор из SCM_RIGHTS (если приложен) - в passed_fd.
+ */
+bool recv_full(int fd, void* buf, size_t len, int* passed_fd) {
+    size_t got = 0;
+    while (got < len) {
+        iovec iov;
+        iov.iov_base = static_cast<char*>(buf) + got;
+        iov.iov_len = len - got;
+
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        if (passed_fd) {
+            msg.msg_control = control;
+            msg.msg_controllen = sizeof(control);
+        }
+
+        int flags = 0;
+#if defined(MSG_CMSG_CLOEXEC)
+        flags |= MSG_CMSG_CLOEXEC;
+#endif
+        ssize_t n = recvmsg(fd, &msg, flags);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+
+        if (passed_fd) {
+            for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+                if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_RIGHTS) {
+                    int received = -1;
+                    std::memcpy(&received, CMSG_DATA(c), sizeof(received));
+                    if (*passed_fd >= 0) {
+                        close(received);
+                    } else {
+                        *passed_fd = received;
+                    }
+                }
+            }
+        }
+        got += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool send_full(int fd, const void* buf, size_t len) {
+    int flags = 0;
+#if defined(MSG_NOSIGNAL)
+    flags |= MSG_NOSIGNAL;
+#endif
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = send(fd, static_cast<const char*>(buf) + sent, len - sent, flags);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool has_pending_data(int fd) {
+    pollfd p{fd, POLLIN, 0};
+    return poll(&p, 1, 0) > 0 && (p.revents & POLLIN);
+}
+
+bool path_terminated(const char* path) {
+    return std::memchr(path, '\0', kBlurMaxPath) != nullptr && path[0] != '\0';
+}
+
+}  // namespace
+
+/**
+ * @brief Задание в пачке: запрос, разрешенная свертка и буферы входа/выхода.
+ */
+struct BlurDaemon::Job {
+    int client_fd = -1;
+    BlurJobRequest request;
+    std::vector<float> kernel;
+    int shm_fd = -1;
+    uint64_t received_ns = 0;
+
+    BlurJobStatus status = BlurJobStatus::Ok;
+    ImageConvolver* convolver = nullptr;
+    int w = 0;
+    int h = 0;
+    const unsigned char* in = nullptr;
+    unsigned char* out = nullptr;
+
+    void* mapping = nullptr;   ///< Отображение памяти клиента (SharedMemory)
+    size_t mapping_length = 0;
+    PooledBuffer file_in;      ///< Декодированный вход и результат (File)
+    PooledBuffer file_out;
+};
+
+BlurDaemon::BlurDaemon(const Options& options)
+    : m_options(options), m_pool(options.threads)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (options.socket_path.empty() || options.socket_path.size() >= sizeof(addr.sun_path)) {
+        throw std::runtime_error("BlurDaemon: invalid socket path: " + options.socket_path);
+    }
+    std::memcpy(addr.sun_path, options.socket_path.c_str(), options.socket_path.size() + 1);
+
+    if (pipe(m_wake_pipe) != 0) {
+        throw system_error("pipe");
+    }
+    fcntl(m_wake_pipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(m_wake_pipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(m_wake_pipe[1], F_SETFL, O_NONBLOCK);
+
+    m_listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listen_fd < 0) {
+        std::runtime_error error = system_error("socket");
+        close(m_wake_pipe[0]);
+        close(m_wake_pipe[1]);
+        throw error;
+    }
+    fcntl(m_listen_fd, F_SETFD, FD_CLOEXEC);
+
+    unlink(options.socket_path.c_str());
+    if (bind(m_listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(m_listen_fd, 128) != 0) {
+        std::runtime_error error = system_error("bind/listen");
+        close(m_listen_fd);
+        close(m_wake_pipe[0]);
+        close(m_wake_pipe[1]);
+        throw error;
+    }
+}
+
+BlurDaemon::~BlurDaemon() {
+    for (int fd : m_clients) {
+        close(fd);
+    }
+    close(m_listen_fd);
+    unlink(m_options.socket_path.c_str());
+    close(m_wake_pipe[0]);
+    close(m_wake_pipe[1]);
+}
+
+void BlurDaemon::stop() {
+    // write() допустим в обработчике сигнала
+    char byte = 1;
+    ssize_t ignored = write(m_wake_pipe[1], &byte, 1);
+    (void)ignored;
+}
+
+void BlurDaemon::run() {
+    std::vector<pollfd> fds;
+    std::vector<Job> batch;
+
+    while (true) {
+        fds.clear();
+        fds.push_back({m_wake_pipe[0], POLLIN, 0});
+        fds.push_back({m_listen_fd, POLLIN, 0});
+        for (int fd : m_clients) {
+            fds.push_back({fd, POLLIN, 0});
+        }
+
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw system_error("poll");
+        }
+        if (fds[0].revents & POLLIN) {
+            return;
+        }
+
+        // Все запросы, готовые к этому моменту, - одна пачка
+        std::vector<int> closed;
+        for (size_t i = 2; i < fds.size(); ++i) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            const int fd = fds[i].fd;
+            do {
+                Job job;
+                if (!read_job(fd, job)) {
+                    closed.push_back(fd);
+                    break;
+                }
+                batch.push_back(std::move(job));
+            } while (batch.size() < m_options.max_batch && has_pending_data(fd));
+
+            if (batch.size() >= m_options.max_batch) {
+                break;
+            }
+        }
+
+        if (!batch.empty()) {
+            process_batch(batch);
+            batch.clear();
+        }
+
+        for (int fd : closed) {
+            close(fd);
+            m_clients.erase(std::remove(m_clients.begin(), m_clients.end(), fd), m_clients.end());
+        }
+
+        if (fds[1].revents & POLLIN) {
+            int client = accept(m_listen_fd, nullptr, nullptr);
+            if (client >= 0) {
+                fcntl(client, F_SETFD, FD_CLOEXEC);
+                m_clients.push_back(client);
+            }
+        }
+    }
+}
+
+bool BlurDaemon::read_job(int fd, Job& job) {
+    job.client_fd = fd;
+    if (!recv_full(fd, &job.request, sizeof(job.request), &job.shm_fd)) {
+        if (job.shm_fd >= 0) {
+            close(job.shm_fd);
+        }
+        return false;
+    }
+    job.received_ns = now_ns();
+
+    // Без верного заголовка границу следующего запроса не найти: соединение закрывается
+    const BlurJobRequest& request = job.request;
+    const int dim = request.kernel_dim;
+    if (request.magic != kBlurProtocolMagic || dim < 1 || dim > kBlurMaxKernelDim || dim % 2 == 0) {
+        if (job.shm_fd >= 0) {
+            close(job.shm_fd);
+        }
+        return false;
+    }
+
+    job.kernel.resize(static_cast<size_t>(dim) * dim);
+    if (!recv_full(fd, job.kernel.data(), job.kernel.size() * sizeof(float), nullptr)) {
+        if (job.shm_fd >= 0) {
+            close(job.shm_fd);
+        }
+        return false;
+    }
+    return true;
+}
+
+ImageConvolver* BlurDaemon::convolver_for(const std::vector<float>& kernel, int dim) {
+    std::string key(reinterpret_cast<const char*>(&dim), sizeof(dim));
+    key.append(reinterpret_cast<const char*>(kernel.data()), kernel.size() * sizeof(float));
+
+    auto it = m_convolvers.find(key);
+    if (it != m_convolvers.end()) {
+        ++m_stats.kernel_cache_hits;
+        it->second.last_used = ++m_use_counter;
+        return it->second.convolver.get();
+    }
+
+    ++m_stats.kernel_cache_misses;
+    CachedConvolver& entry = m_convolvers[key];
+    entry.convolver = std::make_unique<ImageConvolver>(kernel, dim, dim);
+    entry.last_used = ++m_use_counter;
+    return entry.convolver.get();
+}
+
+void BlurDaemon::process_batch(std::vector<Job>& batch) {
+    TraceScope trace("daemon_batch", "BlurDaemon", "jobs", static_cast<int64_t>(batch.size()));
+    const uint64_t batchStart = now_ns();
+
+    // Свертки выбираются до запуска задач, кэш трогает только этот поток
+    for (Job& job : batch) {
+        job.convolver = convolver_for(job.kernel, job.request.kernel_dim);
+    }
+
+    // --- 1. Входы: отображение памяти клиента или загрузка файла
+    std::vector<std::future<void>> futures;
+    for (Job& job : batch) {
+        const BlurJobRequest& request = job.request;
+        if (request.source == BlurJobSource::SharedMemory) {
+            if (request.w <= 0 || request.h <= 0 || request.w > kBlurMaxImageSide || request.h > kBlurMaxImageSide) {
+                job.status = BlurJobStatus::BadRequest;
+                continue;
+            }
+            const size_t bytes = static_cast<size_t>(request.w) * request.h * 4;
+            struct stat st;
+            if (job.shm_fd < 0 || fstat(job.shm_fd, &st) != 0 || static_cast<size_t>(st.st_size) < 2 * bytes) {
+                job.status = BlurJobStatus::MapFailed;
+                continue;
+            }
+            void* p = mmap(nullptr, 2 * bytes, PROT_READ | PROT_WRITE, MAP_SHARED, job.shm_fd, 0);
+            if (p == MAP_FAILED) {
+                job.status = BlurJobStatus::MapFailed;
+                continue;
+            }
+            job.mapping = p;
+            job.mapping_length = 2 * bytes;
+            job.w = request.w;
+            job.h = request.h;
+            job.in = static_cast<unsigned char*>(p);
+            job.out = static_cast<unsigned char*>(p) + bytes;
+        } else if (request.source == BlurJobSource::File) {
+            if (!path_terminated(request.input_path) || !path_terminated(request.output_path)) {
+                job.status = BlurJobStatus::BadRequest;
+                continue;
+            }
+            futures.push_back(m_pool.dispatch_task([this, &job]() {
+                int channels = 0;
+                try {
+                    job.file_in = job.convolver->loadImage(m_buffers, job.request.input_path, job.w, job.h, channels);
+                    if (job.file_in.empty()) {
+                        job.status = BlurJobStatus::LoadFailed;
+                        return;
+                    }
+                    job.file_out = m_buffers.acquire(static_cast<size_t>(job.w) * job.h * 4);
+                } catch (const std::exception&) {
+                    job.status = BlurJobStatus::LoadFailed;
+                    return;
+                }
+                job.in = job.file_in.data();
+                job.out = job.file_out.data();
+            }));
+        } else {
+            job.status = BlurJobStatus::BadRequest;
+        }
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+    futures.clear();
+
+    // --- 2. Полосы всех заданий пачки в пул одновременно
+    const size_t threads = m_pool.get_thread_count();
+    for (Job& job : batch) {
+        if (job.status != BlurJobStatus::Ok) {
+            continue;
+        }
+        for (const RowRange& rows : ImageConvolver::split_rows(0, job.h, threads)) {
+            futures.push_back(m_pool.dispatch_task([&job, rows]() {
+                job.convolver->process_region(job.in, job.w, job.h, job.out, 0, rows.begin, job.w, rows.end);
+            }));
+        }
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+    futures.clear();
+
+    // --- 3. Сохранение результатов File
+    for (Job& job : batch) {
+        if (job.status != BlurJobStatus::Ok || job.request.source != BlurJobSource::File) {
+            continue;
+        }
+        futures.push_back(m_pool.dispatch_task([&job]() {
+            if (!job.convolver->saveImage(job.request.output_path, job.w, job.h, job.out)) {
+                job.status = BlurJobStatus::SaveFailed;
+            }
+        }));
+    }
+    for (auto& future : futures) {
+        future.get();
+    }
+
+    // --- 4. Ответы (пиксели SharedMemory уже лежат в памяти клиента)
+    const uint64_t batchEnd = now_ns();
+    for (Job& job : batch) {
+        BlurJobReply reply;
+        reply.status = job.status;
+        reply.id = job.request.id;
+        reply.w = job.w;
+        reply.h = job.h;
+        reply.batch_size = static_cast<uint32_t>(batch.size());
+        reply.queue_ns = batchStart - job.received_ns;
+        reply.service_ns = batchEnd - batchStart;
+        // Ошибка отправки - клиент ушел, соединение закроется на следующем poll()
+        send_full(job.client_fd, &reply, sizeof(reply));
+
+        if (job.mapping) {
+            munmap(job.mapping, job.mapping_length);
+        }
+        if (job.shm_fd >= 0) {
+            close(job.shm_fd);
+        }
+    }
+
+    m_stats.jobs += batch.size();
+    ++m_stats.batches;
+
+    // Вытеснение LRU только между пачками: свертки текущей пачки уже не нужны
+    while (m_convolvers.size() > std::max<size_t>(m_options.max_cached_kernels, 1)) {
+        auto oldest = std::min_element(m_convolvers.begin(), m_convolvers.end(),
+                                       [](const auto& a, const auto& b) { return a.second.last_used < b.second.last_used; });
+        m_convolvers.erase(oldest);
+    }
+}
+
+#else
+
+struct BlurDaemon::Job {};
+
+BlurDaemon::BlurDaemon(const Options& options)
+    : m_options(options)
+{
+    throw std::runtime_error("BlurDaemon: Unix domain sockets are not supported on this platform");
+}
+
+BlurDaemon::~BlurDaemon() = default;
+
+void BlurDaemon::run() {}
+
+void BlurDaemon::stop() {}
+
+#endif
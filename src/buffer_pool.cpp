@@ -0,0 +1,228 @@
+#include "buffer_pool.h"
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <malloc.h>
+#endif
+
+namespace {
+
+constexpr size_t kMinClass = 4096;
+// Шаг и число "цветов" смещения больших буферов
+constexpr size_t kColorStride = 4096 + 64;
+constexpr size_t kColors = 16;
+
+size_t round_up(size_t value, size_t step) {
+    return (value + step - 1) / step * step;
+}
+
+int highest_bit(unsigned long long value) {
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+}  // namespace
+
+PooledBuffer::~PooledBuffer() {
+    reset();
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer&& other) noexcept {
+    *this = std::move(other);
+}
+
+PooledBuffer& PooledBuffer::operator=(PooledBuffer&& other) noexcept {
+    if (this != &other) {
+        reset();
+        m_pool = std::exchange(other.m_pool, nullptr);
+        m_data = std::exchange(other.m_data, nullptr);
+        m_base = std::exchange(other.m_base, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+        m_capacity = std::exchange(other.m_capacity, 0);
+        m_mapped_length = std::exchange(other.m_mapped_length, 0);
+    }
+    return *this;
+}
+
+void PooledBuffer::reset() {
+    if (m_pool && m_data) {
+        BufferPool::Block block;
+        block.data = m_data;
+        block.base = m_base;
+        block.capacity = m_capacity;
+        block.mapped_length = m_mapped_length;
+        m_pool->release(block);
+    }
+    m_pool = nullptr;
+    m_data = nullptr;
+    m_base = nullptr;
+    m_size = 0;
+    m_capacity = 0;
+    m_mapped_length = 0;
+}
+
+BufferPool::BufferPool(HugePages huge_pages, size_t max_cached_bytes)
+    : m_huge_pages(huge_pages), m_max_cached_bytes(max_cached_bytes)
+{
+}
+
+BufferPool::~BufferPool() {
+    trim();
+}
+
+size_t BufferPool::size_class(size_t size) {
+    if (size <= kMinClass) {
+        return kMinClass;
+    }
+    // 4 класса на октаву (2^e, 2^(e+1)]: потери не больше 25%
+    int exponent = highest_bit(static_cast<unsigned long long>(size - 1));
+    size_t cls = round_up(size, size_t(1) << (exponent - 2));
+    // Большие буферы кратны огромной странице
+    if (cls >= kHugePageSize) {
+        cls = round_up(cls, kHugePageSize);
+    }
+    return cls;
+}
+
+BufferPool::Block BufferPool::allocate(size_t capacity, bool& huge) {
+    huge = false;
+    Block block;
+    block.capacity = capacity;
+#if defined(__linux__)
+    if (capacity >= kHugePageSize) {
+        size_t color = m_next_color.fetch_add(1, std::memory_order_relaxed) % kColors;
+        size_t length = capacity + kHugePageSize;  // запас под смещение, кратен огромной странице
+
+        void* p = MAP_FAILED;
+        if (m_huge_pages == HugePages::Explicit) {
+            p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            huge = p != MAP_FAILED;
+        }
+        if (p == MAP_FAILED) {
+            // Нет зарезервированных hugetlbfs-страниц: обычное отображение + THP
+            p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED) {
+                throw std::bad_alloc();
+            }
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+            if (m_huge_pages == HugePages::None) {
+                madvise(p, length, MADV_NOHUGEPAGE);
+            } else {
+                huge = madvise(p, length, MADV_HUGEPAGE) == 0;
+            }
+#endif
+        }
+        block.base = static_cast<unsigned char*>(p);
+        block.data = block.base + color * kColorStride;
+        block.mapped_length = length;
+        return block;
+    }
+#endif
+    // capacity кратна kMinClass, а значит и kAlignment, как требует aligned_alloc
+#if defined(_MSC_VER)
+    void* p = _aligned_malloc(capacity, kAlignment);
+#else
+    void* p = std::aligned_alloc(kAlignment, capacity);
+#endif
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    block.base = static_cast<unsigned char*>(p);
+    block.data = block.base;
+    return block;
+}
+
+void BufferPool::free_block(const Block& block) {
+#if defined(__linux__)
+    if (block.mapped_length != 0) {
+        munmap(block.base, block.mapped_length);
+        return;
+    }
+#endif
+#if defined(_MSC_VER)
+    _aligned_free(block.base);
+#else
+    std::free(block.base);
+#endif
+}
+
+PooledBuffer BufferPool::acquire(size_t size) {
+    const size_t capacity = size_class(size);
+
+    Block block;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_free.find(capacity);
+        if (it != m_free.end() && !it->second.empty()) {
+            block = it->second.back();
+            it->second.pop_back();
+            m_stats.cached_bytes -= capacity;
+            m_stats.outstanding_bytes += capacity;
+            ++m_stats.hits;
+        }
+    }
+
+    if (!block.data) {
+        // Выделение (mmap больших буферов) - вне мьютекса
+        bool huge = false;
+        block = allocate(capacity, huge);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.outstanding_bytes += capacity;
+        ++m_stats.misses;
+        if (huge) {
+            ++m_stats.huge_allocations;
+        }
+    }
+
+    PooledBuffer buffer;
+    buffer.m_pool = this;
+    buffer.m_data = block.data;
+    buffer.m_base = block.base;
+    buffer.m_size = size;
+    buffer.m_capacity = block.capacity;
+    buffer.m_mapped_length = block.mapped_length;
+    return buffer;
+}
+
+void BufferPool::release(const Block& block) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.outstanding_bytes -= block.capacity;
+        if (m_stats.cached_bytes + block.capacity <= m_max_cached_bytes) {
+            m_free[block.capacity].push_back(block);
+            m_stats.cached_bytes += block.capacity;
+            return;
+        }
+    }
+    free_block(block);
+}
+
+void BufferPool::trim() {
+    std::map<size_t, std::vector<Block>> blocks;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        blocks.swap(m_free);
+        m_stats.cached_bytes = 0;
+    }
+    for (const auto& entry : blocks) {
+        for (const Block& block : entry.second) {
+            free_block(block);
+        }
+    }
+}
+
+BufferPool::Stats BufferPool::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
@@ -0,0 +1,147 @@
+#include "frame_stream.h"
+#include <algorithm>
+#include <cstring>
+
+FrameStreamConvolver::FrameStreamConvolver(const std::vector<float>& kernel, int kW, int kH, int tile_size)
+    : m_convolver(kernel, kW, kH), m_kW(kW), m_kH(kH), m_tile(std::max(tile_size, 1))
+{
+}
+
+void FrameStreamConvolver::reset() {
+    m_w = 0;
+    m_h = 0;
+    m_prev_input.clear();
+    m_output.clear();
+    m_tile_mask.clear();
+    m_recomputed_fraction = 0.0;
+}
+
+double FrameStreamConvolver::last_recomputed_fraction() const {
+    return m_recomputed_fraction;
+}
+
+void FrameStreamConvolver::process_full(const unsigned char* img_in, int w, int h) {
+    size_t bytes = static_cast<size_t>(w) * static_cast<size_t>(h) * 4;
+    m_w = w;
+    m_h = h;
+    m_tilesX = (w + m_tile - 1) / m_tile;
+    m_tilesY = (h + m_tile - 1) / m_tile;
+    m_prev_input.assign(img_in, img_in + bytes);
+    m_output.resize(bytes);
+    m_tile_mask.assign(static_cast<size_t>(m_tilesX) * static_cast<size_t>(m_tilesY), 0);
+
+    m_convolver.process_region(img_in, w, h, m_output.data(), 0, 0, w, h);
+    m_recomputed_fraction = 1.0;
+}
+
+void FrameStreamConvolver::mark_rect(const DirtyRect& rect) {
+    // Выходной пиксель зависит от входа в окне ядра, поэтому расширяем на ореол
+    int x0 = std::max(rect.x - m_kW / 2, 0);
+    int y0 = std::max(rect.y - m_kH / 2, 0);
+    int x1 = std::min(rect.x + rect.w + m_kW / 2, m_w);
+    int y1 = std::min(rect.y + rect.h + m_kH / 2, m_h);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    for (int ty = y0 / m_tile; ty <= (y1 - 1) / m_tile; ++ty) {
+        for (int tx = x0 / m_tile; tx <= (x1 - 1) / m_tile; ++tx) {
+            m_tile_mask[ty * m_tilesX + tx] = 1;
+        }
+    }
+}
+
+void FrameStreamConvolver::recompute_marked(const unsigned char* img_in) {
+    size_t recomputed = 0;
+
+    for (int ty = 0; ty < m_tilesY; ++ty) {
+        int y0 = ty * m_tile;
+        int y1 = std::min(y0 + m_tile, m_h);
+
+        int tx = 0;
+        while (tx < m_tilesX) {
+            if (!m_tile_mask[ty * m_tilesX + tx]) {
+                ++tx;
+                continue;
+            }
+            // Объединяем подряд идущие плитки в одну полосу, чтобы SIMD-цикл шел длиннее
+            int txEnd = tx;
+            while (txEnd < m_tilesX && m_tile_mask[ty * m_tilesX + txEnd]) {
+                m_tile_mask[ty * m_tilesX + txEnd] = 0;
+                ++txEnd;
+            }
+
+            int x0 = tx * m_tile;
+            int x1 = std::min(txEnd * m_tile, m_w);
+            m_convolver.process_region(img_in, m_w, m_h, m_output.data(), x0, y0, x1, y1);
+            recomputed += static_cast<size_t>(x1 - x0) * static_cast<size_t>(y1 - y0);
+            tx = txEnd;
+        }
+    }
+
+    m_recomputed_fraction = static_cast<double>(recomputed) /
+                            (static_cast<double>(m_w) * static_cast<double>(m_h));
+}
+
+const std::vector<unsigned char>& FrameStreamConvolver::process_frame(const unsigned char* img_in, int w, int h,
+                                                                      const std::vector<DirtyRect>& dirty) {
+    if (!img_in || w <= 0 || h <= 0) {
+        reset();
+        return m_output;
+    }
+    if (w != m_w || h != m_h || m_output.empty()) {
+        process_full(img_in, w, h);
+        return m_output;
+    }
+
+    for (const DirtyRect& r : dirty) {
+        int x0 = std::max(r.x, 0);
+        int y0 = std::max(r.y, 0);
+        int x1 = std::min(r.x + r.w, w);
+        int y1 = std::min(r.y + r.h, h);
+        if (x0 >= x1 || y0 >= y1) continue;
+
+        // Обновляем сохраненный вход только в измененной области
+        size_t rowBytes = static_cast<size_t>(x1 - x0) * 4;
+        for (int y = y0; y < y1; ++y) {
+            size_t idx = (static_cast<size_t>(y) * w + x0) * 4;
+            std::memcpy(&m_prev_input[idx], &img_in[idx], rowBytes);
+        }
+        mark_rect({x0, y0, x1 - x0, y1 - y0});
+    }
+
+    recompute_marked(img_in);
+    return m_output;
+}
+
+const std::vector<unsigned char>& FrameStreamConvolver::process_frame(const unsigned char* img_in, int w, int h) {
+    if (!img_in || w <= 0 || h <= 0) {
+        reset();
+        return m_output;
+    }
+    if (w != m_w || h != m_h || m_output.empty()) {
+        process_full(img_in, w, h);
+        return m_output;
+    }
+
+    // Ищем изменившиеся плитки входа построчным сравнением с предыдущим кадром
+    std::vector<DirtyRect> changed;
+    for (int ty = 0; ty < m_tilesY; ++ty) {
+        int y0 = ty * m_tile;
+        int y1 = std::min(y0 + m_tile, h);
+        for (int tx = 0; tx < m_tilesX; ++tx) {
+            int x0 = tx * m_tile;
+            int x1 = std::min(x0 + m_tile, w);
+            size_t rowBytes = static_cast<size_t>(x1 - x0) * 4;
+
+            bool tileChanged = false;
+            for (int y = y0; y < y1 && !tileChanged; ++y) {
+                size_t idx = (static_cast<size_t>(y) * w + x0) * 4;
+                tileChanged = std::memcmp(&m_prev_input[idx], &img_in[idx], rowBytes) != 0;
+            }
+            if (tileChanged) {
+                changed.push_back({x0, y0, x1 - x0, y1 - y0});
+            }
+        }
+    }
+
+    return process_frame(img_in, w, h, changed);
+}
@@ -1,8 +1,11 @@
 #include "image_convolver.h"
 #include "thread_pool.h"
+#include "trace.h"
 #include <iostream>
 #include <algorithm>
-#include <future>
+#include <array>
+#include <fstream>
+#include <stdexcept>
 
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
@@ -15,23 +18,113 @@
 #include "stb_image_write.h"
 #include <immintrin.h>
 
-ImageConvolver::ImageConvolver(const std::vector<float>& kernel, int kW, int kH)
-    : m_kernel(kernel), m_kW(kW), m_kH(kH) 
+ImageConvolver::ImageConvolver(const std::vector<float>& kernel, int kW, int kH, int dilation)
+    : m_kW(kW), m_kH(kH), m_dilation(dilation)
 {
+    if (dilation < 1) {
+        throw std::invalid_argument("ImageConvolver: dilation must be >= 1");
+    }
+    // A trous: тап (y, x) переезжает в (y * dilation, x * dilation), между ними нули
+    m_kW = (kW - 1) * dilation + 1;
+    m_kH = (kH - 1) * dilation + 1;
+    prepare_sparse_taps(kernel, kW, kH);
+
+    // Плотное ядро a trous растет как dilation^2 (9x9 при dilation 32 - 66k тапов,
+    // с упаковкой ~4 МБ), поэтому строится только при первом плотном варианте
+    if (dilation == 1) {
+        prepare_dense();
+    }
+}
+
+void ImageConvolver::prepare_dense() const {
+    std::call_once(m_dense_once, [this]() {
+        const int kHalfW = m_kW / 2;
+        const int kHalfH = m_kH / 2;
+        m_kernel.assign(static_cast<size_t>(m_kW) * m_kH, 0.f);
+        for (const SparseTap& tap : m_sparse_taps) {
+            m_kernel[static_cast<size_t>(tap.dy + kHalfH) * m_kW + (tap.dx + kHalfW)] = tap.weight;
+        }
+
+        // Упаковка для process_SIMD_blocked: один готовый вектор на тап вместо broadcast в цикле
+        m_packed_weights.resize(m_kernel.size() * 16);
+        for (size_t i = 0; i < m_kernel.size(); ++i) {
+            std::fill_n(m_packed_weights.begin() + i * 16, 16, m_kernel[i]);
+        }
+        prepare_folded_taps();
+    });
 }
 
 unsigned char* ImageConvolver::loadImage(const char* filename, int& w, int& h, int& channels) {
+    StageTimer timer(m_metrics, MetricStage::Load, MetricVariant::Io, 0, 0);
     unsigned char* img = stbi_load(filename, &w, &h, &channels, 4);
     if (!img) {
+        timer.cancel();
         std::cerr << "Error loading image: " << stbi_failure_reason() << std::endl;
         return nullptr;
     }
+    timer.set_size(w, h);
     channels = 4;
     return img;
 }
 
+unsigned char* ImageConvolver::loadImageNative(const char* filename, int& w, int& h, int& channels) {
+    StageTimer timer(m_metrics, MetricStage::Load, MetricVariant::Io, 0, 0);
+    unsigned char* img = stbi_load(filename, &w, &h, &channels, 0);
+    if (!img) {
+        timer.cancel();
+        std::cerr << "Error loading image: " << stbi_failure_reason() << std::endl;
+        return nullptr;
+    }
+    timer.set_size(w, h);
+    return img;
+}
+
+unsigned short* ImageConvolver::loadImage16(const char* filename, int& w, int& h, int& channels) {
+    StageTimer timer(m_metrics, MetricStage::Load, MetricVariant::Io, 0, 0);
+    unsigned short* img = stbi_load_16(filename, &w, &h, &channels, 0);
+    if (!img) {
+        timer.cancel();
+        std::cerr << "Error loading image: " << stbi_failure_reason() << std::endl;
+        return nullptr;
+    }
+    timer.set_size(w, h);
+    return img;
+}
+
+PooledBuffer ImageConvolver::loadImage(BufferPool& pool, const char* filename, int& w, int& h, int& channels) {
+    StageTimer timer(m_metrics, MetricStage::Load, MetricVariant::Io, 0, 0);
+    unsigned char* img = stbi_load(filename, &w, &h, &channels, 4);
+    if (!img) {
+        timer.cancel();
+        std::cerr << "Error loading image: " << stbi_failure_reason() << std::endl;
+        return {};
+    }
+    channels = 4;
+    timer.set_size(w, h);
+
+    // stb выделяет результат внутри декодера через malloc, поэтому копируем
+    // в выровненный буфер пула (копия много дешевле декодирования)
+    PooledBuffer buffer = pool.acquire(static_cast<size_t>(w) * h * 4);
+    std::copy(img, img + static_cast<size_t>(w) * h * 4, buffer.data());
+    stbi_image_free(img);
+    return buffer;
+}
+
+float* ImageConvolver::loadImageF(const char* filename, int& w, int& h, int& channels) {
+    StageTimer timer(m_metrics, MetricStage::Load, MetricVariant::Io, 0, 0);
+    float* img = stbi_loadf(filename, &w, &h, &channels, 0);
+    if (!img) {
+        timer.cancel();
+        std::cerr << "Error loading image: " << stbi_failure_reason() << std::endl;
+        return nullptr;
+    }
+    timer.set_size(w, h);
+    return img;
+}
+
 std::vector<unsigned char> ImageConvolver::process_default(const unsigned char* img_in, int w, int h) {
     if (!img_in) return {};
+    prepare_dense();
 
     std::vector<unsigned char> img_out(w * h * 4);
     
@@ -39,6 +132,7 @@ std::vector<unsigned char> ImageConvolver::process_default(const unsigned char*
     int kHalfH = m_kH / 2;
 
     // 1. Основная область свертки
+    StageTimer convolveTimer(m_metrics, MetricStage::Convolve, MetricVariant::Default, w, h);
     for (int y = kHalfH; y < h - kHalfH; ++y) {
         for (int x = kHalfW; x < w - kHalfW; ++x) {
 
@@ -69,7 +163,10 @@ std::vector<unsigned char> ImageConvolver::process_default(const unsigned char*
         }
     }
 
+    convolveTimer.stop();
+
     // 2. Обработка границ
+    StageTimer borderTimer(m_metrics, MetricStage::Border, MetricVariant::Default, w, h);
     for (int y = 0; y < h; ++y) {
         for (int x = 0; x < w; ++x) {
             if (y < kHalfH || y >= h - kHalfH ||
@@ -89,18 +186,85 @@ std::vector<unsigned char> ImageConvolver::process_default(const unsigned char*
 std::vector<unsigned char> ImageConvolver::process_SIMD(const unsigned char* img_in, int w, int h) {
     if (!img_in) return {};
 
+    TraceScope trace("process_SIMD", "ImageConvolver", "w", w, "h", h);
     std::vector<unsigned char> img_out(w * h * 4);
-    
+    StageTimer convolveTimer(m_metrics, MetricStage::Convolve, MetricVariant::SIMD, w, h);
+    convolve_region_SIMD(img_in, w, h, img_out.data(), 0, 0, w, h);
+    convolveTimer.stop();
+    StageTimer borderTimer(m_metrics, MetricStage::Border, MetricVariant::SIMD, w, h);
+    copy_border(img_in, w, h, img_out.data());
+    return img_out;
+}
+
+PooledBuffer ImageConvolver::process_SIMD(BufferPool& pool, const unsigned char* img_in, int w, int h) {
+    if (!img_in) return {};
+
+    TraceScope trace("process_SIMD", "ImageConvolver", "w", w, "h", h);
+    PooledBuffer img_out = pool.acquire(static_cast<size_t>(w) * h * 4);
+    StageTimer convolveTimer(m_metrics, MetricStage::Convolve, MetricVariant::SIMD, w, h);
+    convolve_region_SIMD(img_in, w, h, img_out.data(), 0, 0, w, h);
+    convolveTimer.stop();
+    StageTimer borderTimer(m_metrics, MetricStage::Border, MetricVariant::SIMD, w, h);
+    copy_border(img_in, w, h, img_out.data());
+    return img_out;
+}
+
+void ImageConvolver::process_region(const unsigned char* img_in, int w, int h, unsigned char* img_out,
+                                    int x0, int y0, int x1, int y1) {
+    if (!img_in || !img_out) return;
+
+    x0 = std::max(x0, 0);
+    y0 = std::max(y0, 0);
+    x1 = std::min(x1, w);
+    y1 = std::min(y1, h);
+    if (x0 >= x1 || y0 >= y1) return;
+
+    // Без StageTimer: полосы и плитки - доли кадра, их время учитывают вызывающие
+    convolve_region_SIMD(img_in, w, h, img_out, x0, y0, x1, y1);
+
+    // Обработка границ (копирование)
+    const int kHalfW = m_kW / 2;
+    const int kHalfH = m_kH / 2;
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            if (y < kHalfH || y >= h - kHalfH || x < kHalfW || x >= w - kHalfW) {
+                int idx = (y * w + x) * 4;
+                img_out[idx + 0] = img_in[idx + 0];
+                img_out[idx + 1] = img_in[idx + 1];
+                img_out[idx + 2] = img_in[idx + 2];
+                img_out[idx + 3] = img_in[idx + 3];
+            }
+        }
+    }
+}
+
+void ImageConvolver::convolve_region_SIMD(const unsigned char* img_in, int w, int h, unsigned char* img_out,
+                                          int x0, int y0, int x1, int y1) const {
+    prepare_dense();
     int kHalfW = m_kW / 2;
     int kHalfH = m_kH / 2;
 
-    int xEnd = w - kHalfW; 
-    // Выравниваем цикл по 4 пикселя
-    int xSimdEnd = kHalfW + ((xEnd - kHalfW) / 4) * 4;
+    // Внутренняя (сворачиваемая) часть прямоугольника
+    int xBegin = std::max(x0, kHalfW);
+    int xEnd = std::min(x1, w - kHalfW);
+    int yBegin = std::max(y0, kHalfH);
+    int yEnd = std::min(y1, h - kHalfH);
+
+    // Выравниваем цикл по 4 пикселя. Группы привязаны к сетке всего изображения
+    // (от kHalfW), чтобы каждый пиксель считался тем же путем (SIMD или хвост),
+    // что и в process_SIMD; поэтому группа может выйти за x0/x1 прямоугольника.
+    int xFullEnd = w - kHalfW;
+    int xFullSimdEnd = (xFullEnd > kHalfW) ? kHalfW + ((xFullEnd - kHalfW) / 4) * 4 : kHalfW;
+    int xSimdBegin = xBegin;
+    int xSimdEnd = xBegin;
+    if (xBegin < xEnd && xBegin < xFullSimdEnd) {
+        xSimdBegin = kHalfW + ((xBegin - kHalfW) / 4) * 4;
+        xSimdEnd = std::min(xFullSimdEnd, kHalfW + ((xEnd - kHalfW + 3) / 4) * 4);
+    }
 
-    for (int y = kHalfH; y < h - kHalfH; ++y) {
+    for (int y = yBegin; y < yEnd; ++y) {
         
-        int x = kHalfW;
+        int x = xSimdBegin;
         
         // 4 пикселя за итерацию)
         for (; x < xSimdEnd; x += 4) {
@@ -131,8 +295,9 @@ std::vector<unsigned char> ImageConvolver::process_SIMD(const unsigned char* img
                 }
             }
 
-            // 1. Конвертируем float -> int32
-            __m512i vRes32 = _mm512_cvtps_epi32(vSum);
+            // 1. Конвертируем float -> int32 с отбрасыванием дробной части, как в скалярных
+            //    вариантах; отрицательные суммы обнуляем, иначе беззнаковое насыщение даст 255
+            __m512i vRes32 = _mm512_cvttps_epi32(_mm512_max_ps(vSum, _mm512_setzero_ps()));
 
             // 2. Упаковка 32-бит int -> 8-бит uchar
             __m128i vRes8 = _mm512_cvtusepi32_epi8(vRes32);
@@ -149,7 +314,7 @@ std::vector<unsigned char> ImageConvolver::process_SIMD(const unsigned char* img
         }
 
         // --- Хвост (дорабатываем оставшиеся)
-        for (; x < xEnd; ++x) {
+        for (x = std::max(x, xBegin); x < xEnd; ++x) {
             float sumR = 0.f, sumG = 0.f, sumB = 0.f;
             for (int ky = -kHalfH; ky <= kHalfH; ++ky) {
                 for (int kx = -kHalfW; kx <= kHalfW; ++kx) {
@@ -167,27 +332,40 @@ std::vector<unsigned char> ImageConvolver::process_SIMD(const unsigned char* img
             img_out[dstIdx + 3] = img_in[dstIdx + 3];
         }
     }
-    
+}
 
-    // Обработка границ (копирование)
-    for (int y = 0; y < h; ++y) {
-        for (int x = 0; x < w; ++x) {
-            if (y < kHalfH || y >= h - kHalfH || x < kHalfW || x >= w - kHalfW) {
-                int idx = (y * w + x) * 4;
-                img_out[idx + 0] = img_in[idx + 0];
-                img_out[idx + 1] = img_in[idx + 1];
-                img_out[idx + 2] = img_in[idx + 2];
-                img_out[idx + 3] = img_in[idx + 3];
-            }
-        }
+std::vector<RowRange> ImageConvolver::split_rows(int begin, int end, size_t parts) {
+    std::vector<RowRange> ranges;
+    if (begin >= end) return ranges;
+
+    const int totalRows = end - begin;
+    const int count = static_cast<int>(std::min<size_t>(std::max<size_t>(parts, 1), static_cast<size_t>(totalRows)));
+    const int rowsPerPart = totalRows / count;
+    const int remainder = totalRows % count;
+
+    ranges.reserve(count);
+    int y = begin;
+    for (int t = 0; t < count; ++t) {
+        int stop = y + rowsPerPart + (t < remainder ? 1 : 0);
+        ranges.push_back({y, stop});
+        y = stop;
     }
-
-    return img_out;
+    return ranges;
 }
 
 std::vector<unsigned char> ImageConvolver::process_thread_pool(const unsigned char* img_in, int w, int h, size_t num_threads) {
     if (!img_in) return {};
 
+    ThreadPool pool(num_threads);
+    return process_thread_pool(pool, img_in, w, h);
+}
+
+std::vector<unsigned char> ImageConvolver::process_thread_pool(ThreadPool& pool, const unsigned char* img_in, int w, int h,
+                                                               TaskPriority priority) {
+    if (!img_in) return {};
+    prepare_dense();
+
+    TraceScope trace("process_thread_pool", "ImageConvolver", "w", w, "h", h);
     std::vector<unsigned char> img_out(w * h * 4);
     
     int kHalfW = m_kW / 2;
@@ -198,32 +376,20 @@ std::vector<unsigned char> ImageConvolver::process_thread_pool(const unsigned ch
     int xBegin = kHalfW;
     int xEnd = w - kHalfW;
 
-    ThreadPool pool(num_threads);
     size_t threads = pool.get_thread_count();
-    auto calc_task_count = [threads](int totalRows) {
-        size_t base = threads == 0 ? 1 : threads;
-        return std::min<size_t>(base, static_cast<size_t>(totalRows));
-    };
 
     if (yBegin < yEnd && xBegin < xEnd) {
-        int totalRows = yEnd - yBegin;
-        size_t taskCount = calc_task_count(totalRows);
-
-        int rowsPerTask = totalRows / static_cast<int>(taskCount);
-        int remainder = totalRows % static_cast<int>(taskCount);
+        StageTimer convolveTimer(m_metrics, MetricStage::Convolve, MetricVariant::ThreadPool, w, h);
+        std::vector<RowRange> bands = split_rows(yBegin, yEnd, threads);
 
-        std::vector<std::future<void>> futures;
-        futures.reserve(taskCount);
+        // Ожидание через TaskGroup: вызов безопасен и изнутри задачи этого же пула
+        TaskGroup group(pool, priority);
 
-        int yStart = yBegin;
-        for (size_t t = 0; t < taskCount; ++t) {
-            int extra = (static_cast<int>(t) < remainder) ? 1 : 0;
-            int yStop = yStart + rowsPerTask + extra;
-            if (yStart >= yStop) {
-                break;
-            }
-
-            futures.emplace_back(pool.dispatch_task([=, &img_out]() {
+        for (const RowRange& rows : bands) {
+            const int yStart = rows.begin;
+            const int yStop = rows.end;
+            group.run([=, &img_out]() {
+                TraceScope band("convolve_band", "ImageConvolver", "y0", yStart, "y1", yStop);
                 for (int y = yStart; y < yStop; ++y) {
                     for (int x = xBegin; x < xEnd; ++x) {
                         float sumR = 0.f, sumG = 0.f, sumB = 0.f;
@@ -251,35 +417,25 @@ std::vector<unsigned char> ImageConvolver::process_thread_pool(const unsigned ch
                         img_out[dstIdx + 3] = img_in[dstIdx + 3];
                     }
                 }
-            }));
-            yStart = yStop;
+            });
         }
 
-        for (auto& future : futures) {
-            future.get();
-        }
+        TraceScope join("join_convolve", "ImageConvolver", "tasks", static_cast<int64_t>(bands.size()));
+        group.wait();
     }
 
     // Обработка границ (копирование) в несколько потоков
     if (h > 0 && w > 0) {
-        int totalRows = h;
-        size_t taskCount = calc_task_count(totalRows);
+        StageTimer borderTimer(m_metrics, MetricStage::Border, MetricVariant::ThreadPool, w, h);
+        std::vector<RowRange> bands = split_rows(0, h, threads);
 
-        int rowsPerTask = totalRows / static_cast<int>(taskCount);
-        int remainder = totalRows % static_cast<int>(taskCount);
-
-        std::vector<std::future<void>> futures;
-        futures.reserve(taskCount);
-
-        int yStart = 0;
-        for (size_t t = 0; t < taskCount; ++t) {
-            int extra = (static_cast<int>(t) < remainder) ? 1 : 0;
-            int yStop = yStart + rowsPerTask + extra;
-            if (yStart >= yStop) {
-                break;
-            }
+        TaskGroup group(pool, priority);
 
-            futures.emplace_back(pool.dispatch_task([=, &img_out]() {
+        for (const RowRange& rows : bands) {
+            const int yStart = rows.begin;
+            const int yStop = rows.end;
+            group.run([=, &img_out]() {
+                TraceScope band("border_band", "ImageConvolver", "y0", yStart, "y1", yStop);
                 for (int y = yStart; y < yStop; ++y) {
                     for (int x = 0; x < w; ++x) {
                         if (y < kHalfH || y >= h - kHalfH || x < kHalfW || x >= w - kHalfW) {
@@ -291,13 +447,11 @@ std::vector<unsigned char> ImageConvolver::process_thread_pool(const unsigned ch
                         }
                     }
                 }
-            }));
-            yStart = yStop;
+            });
         }
 
-        for (auto& future : futures) {
-            future.get();
-        }
+        TraceScope join("join_border", "ImageConvolver", "tasks", static_cast<int64_t>(bands.size()));
+        group.wait();
     }
 
     return img_out;
@@ -306,6 +460,16 @@ std::vector<unsigned char> ImageConvolver::process_thread_pool(const unsigned ch
 std::vector<unsigned char> ImageConvolver::process_thread_pool_full(const unsigned char* img_in, int w, int h, size_t num_threads) {
     if (!img_in) return {};
 
+    ThreadPool pool(num_threads);
+    return process_thread_pool_full(pool, img_in, w, h);
+}
+
+std::vector<unsigned char> ImageConvolver::process_thread_pool_full(ThreadPool& pool, const unsigned char* img_in, int w, int h,
+                                                                    TaskPriority priority) {
+    if (!img_in) return {};
+    prepare_dense();
+
+    TraceScope trace("process_thread_pool_full", "ImageConvolver", "w", w, "h", h);
     std::vector<unsigned char> img_out(w * h * 4);
     
     int kHalfW = m_kW / 2;
@@ -314,14 +478,13 @@ std::vector<unsigned char> ImageConvolver::process_thread_pool_full(const unsign
     int xBegin = kHalfW;
     int xEnd = w - kHalfW;
 
-    ThreadPool pool(num_threads);
-    std::vector<std::future<void>> futures;
-    if (h > 0) {
-        futures.reserve(static_cast<size_t>(h));
-    }
+    // Границы копируются внутри задач строк, поэтому весь проход учитывается как свертка
+    StageTimer convolveTimer(m_metrics, MetricStage::Convolve, MetricVariant::ThreadPoolFull, w, h);
+    TaskGroup group(pool, priority);
 
     for (int y = 0; y < h; ++y) {
-        futures.emplace_back(pool.dispatch_task([=, &img_out]() {
+        group.run([=, &img_out]() {
+            TraceScope row("row", "ImageConvolver", "y", y);
             const bool y_border = (y < kHalfH) || (y >= h - kHalfH);
             if (y_border || xBegin >= xEnd) {
                 for (int x = 0; x < w; ++x) {
@@ -375,18 +538,321 @@ std::vector<unsigned char> ImageConvolver::process_thread_pool_full(const unsign
                 img_out[idx + 2] = img_in[idx + 2];
                 img_out[idx + 3] = img_in[idx + 3];
             }
-        }));
+        });
     }
 
-    for (auto& future : futures) {
-        future.get();
-    }
+    TraceScope join("join_rows", "ImageConvolver", "tasks", static_cast<int64_t>(std::max(h, 0)));
+    group.wait();
+
+    return img_out;
+}
+
+std::vector<unsigned char> ImageConvolver::process_decimate(const unsigned char* img_in, int w, int h, int factor,
+                                                            int& out_w, int& out_h) {
+    out_w = 0;
+    out_h = 0;
+    if (!img_in || w <= 0 || h <= 0) return {};
+
+    factor = std::max(factor, 1);
+    out_w = (w + factor - 1) / factor;
+    out_h = (h + factor - 1) / factor;
+
+    StageTimer timer(m_metrics, MetricStage::Convolve, MetricVariant::Decimate, w, h);
+    std::vector<unsigned char> img_out(static_cast<size_t>(out_w) * out_h * 4);
+    decimate_rows(img_in, w, h, factor, img_out.data(), out_w, 0, out_h);
+    return img_out;
+}
+
+PooledBuffer ImageConvolver::process_decimate(BufferPool& pool, const unsigned char* img_in, int w, int h,
+                                              int factor, int& out_w, int& out_h) {
+    out_w = 0;
+    out_h = 0;
+    if (!img_in || w <= 0 || h <= 0) return {};
+
+    factor = std::max(factor, 1);
+    out_w = (w + factor - 1) / factor;
+    out_h = (h + factor - 1) / factor;
 
+    StageTimer timer(m_metrics, MetricStage::Convolve, MetricVariant::Decimate, w, h);
+    PooledBuffer img_out = pool.acquire(static_cast<size_t>(out_w) * out_h * 4);
+    decimate_rows(img_in, w, h, factor, img_out.data(), out_w, 0, out_h);
     return img_out;
 }
 
+void ImageConvolver::decimate_rows(const unsigned char* img_in, int w, int h, int factor,
+                                   unsigned char* img_out, int out_w, int oyStart, int oyStop) const {
+    prepare_dense();
+    int kHalfW = m_kW / 2;
+    int kHalfH = m_kH / 2;
+
+    // Выходные x, у которых исходный пиксель (x * factor) лежит во внутренней области
+    int oxBegin = std::min((kHalfW + factor - 1) / factor, out_w);
+    int oxEnd = std::max(oxBegin, (w - kHalfW + factor - 1) / factor);
+    // Выравниваем цикл по 4 выходных пикселя
+    int oxSimdEnd = oxBegin + ((oxEnd - oxBegin) / 4) * 4;
+
+    // Смещения исходных пикселей группы относительно первого (в пикселях)
+    const __m128i vStep = _mm_setr_epi32(0, factor, 2 * factor, 3 * factor);
+    // Для factor == 2: из 8 подряд идущих пикселей берем четные
+    const __m256i vEven = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+    auto copy_pixel = [&](int ox, int oy) {
+        int srcIdx = ((oy * factor) * w + ox * factor) * 4;
+        int dstIdx = (oy * out_w + ox) * 4;
+        img_out[dstIdx + 0] = img_in[srcIdx + 0];
+        img_out[dstIdx + 1] = img_in[srcIdx + 1];
+        img_out[dstIdx + 2] = img_in[srcIdx + 2];
+        img_out[dstIdx + 3] = img_in[srcIdx + 3];
+    };
+
+    for (int oy = oyStart; oy < oyStop; ++oy) {
+        int y = oy * factor;
+
+        // Граничные строки просто копируются
+        if (y < kHalfH || y >= h - kHalfH) {
+            for (int ox = 0; ox < out_w; ++ox) {
+                copy_pixel(ox, oy);
+            }
+            continue;
+        }
+
+        for (int ox = 0; ox < oxBegin; ++ox) {
+            copy_pixel(ox, oy);
+        }
+
+        int ox = oxBegin;
+        // 4 выходных пикселя за итерацию: исходные пиксели идут с шагом factor,
+        // поэтому вместо одной загрузки 16 байт собираем их gather-ом
+        for (; ox < oxSimdEnd; ox += 4) {
+            __m512 vSum = _mm512_setzero_ps();
+            __m128i vBase = _mm_add_epi32(_mm_set1_epi32(ox * factor), vStep);
+            // Загрузка 8 пикселей читает один лишний пиксель справа, он должен быть в строке
+            const bool contiguous = (factor == 2) && ((ox + 3) * 2 + kHalfW + 1 < w);
+
+            for (int ky = -kHalfH; ky <= kHalfH; ++ky) {
+                const int* row = reinterpret_cast<const int*>(&img_in[((y + ky) * w) * 4]);
+                for (int kx = -kHalfW; kx <= kHalfW; ++kx) {
+                    __m512 vWgt = _mm512_set1_ps(m_kernel[(ky + kHalfH) * m_kW + (kx + kHalfW)]);
+                    __m128i vPx8;
+                    if (contiguous) {
+                        __m256i v8 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + ox * 2 + kx));
+                        vPx8 = _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v8, vEven));
+                    } else {
+                        __m128i vIdx = _mm_add_epi32(vBase, _mm_set1_epi32(kx));
+                        vPx8 = _mm_i32gather_epi32(row, vIdx, 4);
+                    }
+                    __m512 vPxFloat = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(vPx8));
+                    vSum = _mm512_fmadd_ps(vPxFloat, vWgt, vSum);
+                }
+            }
+
+            __m128i vRes8 = _mm512_cvtusepi32_epi8(_mm512_cvttps_epi32(_mm512_max_ps(vSum, _mm512_setzero_ps())));
+            int dstIdx = (oy * out_w + ox) * 4;
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(&img_out[dstIdx]), vRes8);
+
+            // Восстанавливаем Alpha-канал для 4 пикселей
+            for (int p = 0; p < 4; ++p) {
+                img_out[dstIdx + p * 4 + 3] = img_in[(y * w + (ox + p) * factor) * 4 + 3];
+            }
+        }
+
+        // --- Хвост (дорабатываем оставшиеся)
+        for (; ox < oxEnd; ++ox) {
+            int x = ox * factor;
+            float sumR = 0.f, sumG = 0.f, sumB = 0.f;
+            for (int ky = -kHalfH; ky <= kHalfH; ++ky) {
+                for (int kx = -kHalfW; kx <= kHalfW; ++kx) {
+                    int srcIdx = ((y + ky) * w + (x + kx)) * 4;
+                    float wgt = m_kernel[(ky + kHalfH) * m_kW + (kx + kHalfW)];
+                    sumR += wgt * img_in[srcIdx + 0];
+                    sumG += wgt * img_in[srcIdx + 1];
+                    sumB += wgt * img_in[srcIdx + 2];
+                }
+            }
+            int dstIdx = (oy * out_w + ox) * 4;
+            img_out[dstIdx + 0] = (unsigned char)std::clamp(sumR, 0.f, 255.f);
+            img_out[dstIdx + 1] = (unsigned char)std::clamp(sumG, 0.f, 255.f);
+            img_out[dstIdx + 2] = (unsigned char)std::clamp(sumB, 0.f, 255.f);
+            img_out[dstIdx + 3] = img_in[(y * w + x) * 4 + 3];
+        }
+
+        for (; ox < out_w; ++ox) {
+            copy_pixel(ox, oy);
+        }
+    }
+}
+
+std::vector<PyramidLevel> ImageConvolver::build_pyramid(const unsigned char* img_in, int w, int h, int min_size,
+                                                        size_t num_threads) {
+    if (!img_in || w <= 0 || h <= 0) return {};
+
+    ThreadPool pool(num_threads);
+    return build_pyramid(pool, img_in, w, h, min_size);
+}
+
+std::vector<PyramidLevel> ImageConvolver::build_pyramid(ThreadPool& pool, const unsigned char* img_in, int w, int h,
+                                                        int min_size, TaskPriority priority) {
+    std::vector<PyramidLevel> levels;
+    if (!img_in || w <= 0 || h <= 0) return levels;
+
+    min_size = std::max(min_size, 1);
+    size_t threads = std::max<size_t>(pool.get_thread_count(), 1);
+
+    const unsigned char* src = img_in;
+    int srcW = w;
+    int srcH = h;
+
+    while (true) {
+        int dstW = (srcW + 1) / 2;
+        int dstH = (srcH + 1) / 2;
+        if (std::min(dstW, dstH) < min_size || (dstW == srcW && dstH == srcH)) {
+            break;
+        }
+
+        PyramidLevel level;
+        level.w = dstW;
+        level.h = dstH;
+        level.data.resize(static_cast<size_t>(dstW) * dstH * 4);
+
+        // Строки уровня делим на полосы так же, как в process_thread_pool
+        std::vector<RowRange> bands = split_rows(0, dstH, threads);
+
+        unsigned char* dst = level.data.data();
+        int64_t levelIndex = static_cast<int64_t>(levels.size()) + 1;
+        TaskGroup group(pool, priority);
+        for (const RowRange& rows : bands) {
+            const int yStart = rows.begin;
+            const int yStop = rows.end;
+            group.run([=]() {
+                TraceScope band("pyramid_band", "ImageConvolver", "level", levelIndex, "y0", yStart);
+                decimate_rows(src, srcW, srcH, 2, dst, dstW, yStart, yStop);
+            });
+        }
+        // Следующий уровень читает этот: ждем всю группу
+        group.wait();
+
+        levels.push_back(std::move(level));
+        src = levels.back().data.data();
+        srcW = dstW;
+        srcH = dstH;
+    }
+
+    return levels;
+}
+
+namespace {
+
+uint32_t png_crc32(const unsigned char* data, size_t size, uint32_t crc = 0xFFFFFFFFu) {
+    static const auto table = []() {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[n] = c;
+        }
+        return t;
+    }();
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+void put_be32(std::vector<unsigned char>& out, uint32_t v) {
+    out.push_back(static_cast<unsigned char>(v >> 24));
+    out.push_back(static_cast<unsigned char>(v >> 16));
+    out.push_back(static_cast<unsigned char>(v >> 8));
+    out.push_back(static_cast<unsigned char>(v));
+}
+
+void put_png_chunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& body) {
+    put_be32(out, static_cast<uint32_t>(body.size()));
+    const size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), body.begin(), body.end());
+    put_be32(out, png_crc32(out.data() + start, out.size() - start) ^ 0xFFFFFFFFu);
+}
+
+/**
+ * @brief 16-битный PNG (stb_image_write умеет только 8 бит). Отсчеты big-endian,
+ * фильтр строк 0, zlib-поток из несжатых (stored) блоков: файл крупнее сжатого,
+ * зато кодер тривиален, а значения сохраняются точно; читается stbi_load_16.
+ */
+std::vector<unsigned char> encode_png16(int w, int h, int channels, const unsigned short* data) {
+    static const unsigned char kColorType[5] = {0, 0, 4, 2, 6};  // серый, серый+альфа, RGB, RGBA
+    const size_t rowBytes = static_cast<size_t>(w) * channels * 2;
+
+    std::vector<unsigned char> raw;
+    raw.reserve((rowBytes + 1) * h);
+    for (int y = 0; y < h; ++y) {
+        raw.push_back(0);
+        const unsigned short* row = data + static_cast<size_t>(y) * w * channels;
+        for (size_t i = 0; i < static_cast<size_t>(w) * channels; ++i) {
+            raw.push_back(static_cast<unsigned char>(row[i] >> 8));
+            raw.push_back(static_cast<unsigned char>(row[i] & 0xFF));
+        }
+    }
+
+    std::vector<unsigned char> zlib = {0x78, 0x01};
+    uint32_t a = 1, b = 0;
+    for (unsigned char v : raw) {
+        a = (a + v) % 65521u;
+        b = (b + a) % 65521u;
+    }
+    size_t pos = 0;
+    do {
+        const size_t len = std::min<size_t>(raw.size() - pos, 65535);
+        const bool last = pos + len == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<unsigned char>(len & 0xFF));
+        zlib.push_back(static_cast<unsigned char>(len >> 8));
+        zlib.push_back(static_cast<unsigned char>(~len & 0xFF));
+        zlib.push_back(static_cast<unsigned char>((~len >> 8) & 0xFF));
+        zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + len);
+        pos += len;
+    } while (pos < raw.size());
+    put_be32(zlib, (b << 16) | a);
+
+    std::vector<unsigned char> ihdr;
+    put_be32(ihdr, static_cast<uint32_t>(w));
+    put_be32(ihdr, static_cast<uint32_t>(h));
+    ihdr.insert(ihdr.end(), {16, kColorType[channels], 0, 0, 0});
+
+    std::vector<unsigned char> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    put_png_chunk(png, "IHDR", ihdr);
+    put_png_chunk(png, "IDAT", zlib);
+    put_png_chunk(png, "IEND", {});
+    return png;
+}
+
+}  // namespace
+
 bool ImageConvolver::saveImage(const char* filename, int w, int h, const unsigned char* data) {
     if (!data) return false;
+    StageTimer timer(m_metrics, MetricStage::Save, MetricVariant::Io, w, h);
     // Качество JPG 90
     return stbi_write_jpg(filename, w, h, 4, data, 90) != 0;
 }
+
+bool ImageConvolver::saveImage(const char* filename, int w, int h, int channels, const unsigned char* data) {
+    if (!data || channels < 1 || channels > 4) return false;
+    StageTimer timer(m_metrics, MetricStage::Save, MetricVariant::Io, w, h);
+    return stbi_write_jpg(filename, w, h, channels, data, 90) != 0;
+}
+
+bool ImageConvolver::saveImage16(const char* filename, int w, int h, int channels, const unsigned short* data) {
+    if (!data || w <= 0 || h <= 0 || channels < 1 || channels > 4) return false;
+    StageTimer timer(m_metrics, MetricStage::Save, MetricVariant::Io, w, h);
+    const std::vector<unsigned char> png = encode_png16(w, h, channels, data);
+    std::ofstream file(filename, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+    return static_cast<bool>(file);
+}
+
+bool ImageConvolver::saveImageF(const char* filename, int w, int h, int channels, const float* data) {
+    if (!data || channels < 1 || channels > 4) return false;
+    StageTimer timer(m_metrics, MetricStage::Save, MetricVariant::Io, w, h);
+    return stbi_write_hdr(filename, w, h, channels, data) != 0;
+}
@@ -0,0 +1,182 @@
+#include "image_convolver.h"
+#include "trace.h"
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+
+namespace {
+
+// Изображений в одной перепакованной группе: пиксель группы - 16 байт, 4 пикселя - один zmm
+constexpr int kBatchLanes = 4;
+
+// Пиксель 4 изображений (16 байт) -> 16 float
+inline __m512 load_lanes_ps(const unsigned char* p) {
+    return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+}
+
+/**
+ * @brief Результат для одного пикселя 4 изображений: отбрасывание дробной части и насыщение,
+ * альфа из перепакованного входа, затем запись в lanes выходных изображений.
+ */
+inline void store_lanes(__m512 acc, const unsigned char* packed_src, unsigned char* const* outputs, int lanes,
+                        size_t idx) {
+    __m128i res8 = _mm512_cvtusepi32_epi8(_mm512_cvttps_epi32(_mm512_max_ps(acc, _mm512_setzero_ps())));
+    // Каждый 4-й байт - альфа
+    res8 = _mm_mask_blend_epi8(0x8888, res8, _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed_src)));
+    alignas(16) uint32_t px[kBatchLanes];
+    _mm_store_si128(reinterpret_cast<__m128i*>(px), res8);
+    for (int i = 0; i < lanes; ++i) {
+        std::memcpy(outputs[i] + idx, &px[i], 4);
+    }
+}
+
+}  // namespace
+
+std::vector<unsigned char> ImageConvolver::process_batch(const unsigned char* images, int count, int w, int h) {
+    if (!images || count <= 0) return {};
+
+    TraceScope trace("process_batch", "ImageConvolver", "count", count, "w", w);
+    const size_t frame = static_cast<size_t>(w) * h * 4;
+    std::vector<unsigned char> result(frame * count);
+    std::vector<const unsigned char*> inputs(count);
+    std::vector<unsigned char*> outputs(count);
+    for (int i = 0; i < count; ++i) {
+        inputs[i] = images + frame * i;
+        outputs[i] = result.data() + frame * i;
+    }
+
+    StageTimer convolveTimer(m_metrics, MetricStage::Convolve, MetricVariant::Batch, w, h);
+    batch_groups(inputs.data(), outputs.data(), count, w, h, 0, (count + kBatchLanes - 1) / kBatchLanes);
+    return result;
+}
+
+std::vector<unsigned char> ImageConvolver::process_batch(ThreadPool& pool, const unsigned char* images, int count,
+                                                         int w, int h, TaskPriority priority) {
+    if (!images || count <= 0) return {};
+
+    const size_t frame = static_cast<size_t>(w) * h * 4;
+    std::vector<unsigned char> result(frame * count);
+    std::vector<const unsigned char*> inputs(count);
+    std::vector<unsigned char*> outputs(count);
+    for (int i = 0; i < count; ++i) {
+        inputs[i] = images + frame * i;
+        outputs[i] = result.data() + frame * i;
+    }
+    process_batch(pool, inputs.data(), outputs.data(), count, w, h, priority);
+    return result;
+}
+
+void ImageConvolver::process_batch(ThreadPool& pool, const unsigned char* const* inputs, unsigned char* const* outputs,
+                                   int count, int w, int h, TaskPriority priority) {
+    if (!inputs || !outputs || count <= 0) return;
+
+    TraceScope trace("process_batch_thread_pool", "ImageConvolver", "count", count, "w", w);
+    StageTimer convolveTimer(m_metrics, MetricStage::Convolve, MetricVariant::Batch, w, h);
+
+    // Делятся группы изображений, а не строки: на маленьких изображениях постановка
+    // задачи дороже свертки одной картинки
+    TaskGroup group(pool, priority);
+    const int groups = (count + kBatchLanes - 1) / kBatchLanes;
+    for (const RowRange& band : split_rows(0, groups, pool.get_thread_count())) {
+        group.run([=]() {
+            TraceScope scope("batch_band", "ImageConvolver", "g0", band.begin, "g1", band.end);
+            batch_groups(inputs, outputs, count, w, h, band.begin, band.end);
+        });
+    }
+    group.wait();
+}
+
+void ImageConvolver::batch_groups(const unsigned char* const* inputs, unsigned char* const* outputs, int count,
+                                  int w, int h, int g0, int g1) const {
+    if (w <= 0 || h <= 0 || g0 >= g1) {
+        return;
+    }
+    const int kHalfW = m_kW / 2;
+    const int kHalfH = m_kH / 2;
+    const int xBegin = kHalfW;
+    const int xEnd = w - kHalfW;
+    const size_t pixels = static_cast<size_t>(w) * h;
+
+    // Смещения ненулевых тапов в байтах перепакованного буфера (16 байт на пиксель)
+    const size_t tapCount = m_sparse_taps.size();
+    std::vector<long> offsets(tapCount);
+    for (size_t t = 0; t < tapCount; ++t) {
+        offsets[t] = (static_cast<long>(m_sparse_taps[t].dy) * w + m_sparse_taps[t].dx) * 16;
+    }
+
+    std::vector<unsigned char> packed(pixels * 16);
+
+    for (int g = g0; g < g1; ++g) {
+        const int first = g * kBatchLanes;
+        const int lanes = std::min(kBatchLanes, count - first);
+        // Неполная группа дублирует последнее изображение (результат не пишется)
+        const unsigned char* src[kBatchLanes];
+        for (int i = 0; i < kBatchLanes; ++i) {
+            src[i] = inputs[first + std::min(i, lanes - 1)];
+        }
+        unsigned char* const* dst = outputs + first;
+
+        // --- 1. Перепаковка: транспонирование 4x4 по 32-битным пикселям
+        size_t p = 0;
+        for (; p + 4 <= pixels; p += 4) {
+            __m128 r0 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src[0] + p * 4)));
+            __m128 r1 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src[1] + p * 4)));
+            __m128 r2 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src[2] + p * 4)));
+            __m128 r3 = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src[3] + p * 4)));
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            float* out = reinterpret_cast<float*>(packed.data() + p * 16);
+            _mm_storeu_ps(out, r0);
+            _mm_storeu_ps(out + 4, r1);
+            _mm_storeu_ps(out + 8, r2);
+            _mm_storeu_ps(out + 12, r3);
+        }
+        for (; p < pixels; ++p) {
+            for (int i = 0; i < kBatchLanes; ++i) {
+                std::memcpy(packed.data() + p * 16 + i * 4, src[i] + p * 4, 4);
+            }
+        }
+
+        // --- 2. Границы каждого изображения копируются без изменений
+        for (int i = 0; i < lanes; ++i) {
+            copy_border(src[i], w, h, dst[i]);
+        }
+        if (xBegin >= xEnd) {
+            continue;
+        }
+
+        // --- 3. Внутренние пиксели: 4 соседних пикселя x 4 изображения за итерацию
+        for (int y = kHalfH; y < h - kHalfH; ++y) {
+            int x = xBegin;
+            for (; x + 4 <= xEnd; x += 4) {
+                const size_t pix = static_cast<size_t>(y) * w + x;
+                const unsigned char* center = packed.data() + pix * 16;
+                __m512 acc0 = _mm512_setzero_ps();
+                __m512 acc1 = _mm512_setzero_ps();
+                __m512 acc2 = _mm512_setzero_ps();
+                __m512 acc3 = _mm512_setzero_ps();
+                for (size_t t = 0; t < tapCount; ++t) {
+                    const __m512 wgt = _mm512_set1_ps(m_sparse_taps[t].weight);
+                    const unsigned char* q = center + offsets[t];
+                    acc0 = _mm512_fmadd_ps(load_lanes_ps(q), wgt, acc0);
+                    acc1 = _mm512_fmadd_ps(load_lanes_ps(q + 16), wgt, acc1);
+                    acc2 = _mm512_fmadd_ps(load_lanes_ps(q + 32), wgt, acc2);
+                    acc3 = _mm512_fmadd_ps(load_lanes_ps(q + 48), wgt, acc3);
+                }
+                store_lanes(acc0, center, dst, lanes, pix * 4);
+                store_lanes(acc1, center + 16, dst, lanes, (pix + 1) * 4);
+                store_lanes(acc2, center + 32, dst, lanes, (pix + 2) * 4);
+                store_lanes(acc3, center + 48, dst, lanes, (pix + 3) * 4);
+            }
+            // Хвост строки тоже векторный: один пиксель 4 изображений
+            for (; x < xEnd; ++x) {
+                const size_t pix = static_cast<size_t>(y) * w + x;
+                const unsigned char* center = packed.data() + pix * 16;
+                __m512 acc = _mm512_setzero_ps();
+                for (size_t t = 0; t < tapCount; ++t) {
+                    acc = _mm512_fmadd_ps(load_lanes_ps(center + offsets[t]), _mm512_set1_ps(m_sparse_taps[t].weight), acc);
+                }
+                store_lanes(acc, center, dst, lanes, pix * 4);
+            }
+        }
+    }
+}
@@ -0,0 +1,172 @@
+#include "image_convolver.h"
+#include "trace.h"
+#include <algorithm>
+#include <immintrin.h>
+
+namespace {
+
+/**
+ * @brief Микроядро: R выходных строк x G групп по 4 пикселя (RGBA) одним проходом.
+ *
+ * Аккумуляторы R * G независимы, поэтому цепочки FMA не ждут друг друга.
+ * Входная строка iy загружается и конвертируется во float один раз на тап kx
+ * и используется всеми выходными строками r, для которых она попадает в окно ядра.
+ * Порядок накопления для каждого выходного пикселя (ky, затем kx по возрастанию)
+ * совпадает с process_SIMD, поэтому результат совпадает побитово.
+ *
+ * @param packed Веса ядра, размноженные на 16 линий: тап (ky, kx) -> packed + (ky * kW + kx) * 16.
+ * @param x Первый пиксель блока (начало первой группы).
+ * @param y Первая выходная строка блока.
+ */
+template<int R, int G>
+inline void microkernel(const unsigned char* img_in, unsigned char* img_out, int w,
+                        const float* packed, int kW, int kH, int x, int y) {
+    const int kHalfW = kW / 2;
+    const int kHalfH = kH / 2;
+
+    __m512 acc[R][G];
+    for (int r = 0; r < R; ++r) {
+        for (int g = 0; g < G; ++g) {
+            acc[r][g] = _mm512_setzero_ps();
+        }
+    }
+
+    // Входные строки, которые задевает хотя бы одна из R выходных строк
+    for (int iy = y - kHalfH; iy < y + R + kHalfH; ++iy) {
+        const unsigned char* row = img_in + (static_cast<size_t>(iy) * w + (x - kHalfW)) * 4;
+
+        for (int kx = 0; kx < kW; ++kx) {
+            __m512 in[G];
+            for (int g = 0; g < G; ++g) {
+                __m128i px8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + (kx + g * 4) * 4));
+                in[g] = _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(px8));
+            }
+
+            for (int r = 0; r < R; ++r) {
+                // Строка iy для выходной строки y + r соответствует тапу ky
+                const int ky = iy - (y + r) + kHalfH;
+                if (ky < 0 || ky >= kH) {
+                    continue;
+                }
+                const __m512 wgt = _mm512_loadu_ps(packed + (ky * kW + kx) * 16);
+                for (int g = 0; g < G; ++g) {
+                    acc[r][g] = _mm512_fmadd_ps(in[g], wgt, acc[r][g]);
+                }
+            }
+        }
+    }
+
+    const __m512 zero = _mm512_setzero_ps();
+    for (int r = 0; r < R; ++r) {
+        for (int g = 0; g < G; ++g) {
+            size_t dstIdx = (static_cast<size_t>(y + r) * w + x + g * 4) * 4;
+            __m128i res8 = _mm512_cvtusepi32_epi8(_mm512_cvttps_epi32(_mm512_max_ps(acc[r][g], zero)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(img_out + dstIdx), res8);
+
+            // Альфа-канал берется из исходного пикселя
+            img_out[dstIdx + 3] = img_in[dstIdx + 3];
+            img_out[dstIdx + 7] = img_in[dstIdx + 7];
+            img_out[dstIdx + 11] = img_in[dstIdx + 11];
+            img_out[dstIdx + 15] = img_in[dstIdx + 15];
+        }
+    }
+}
+
+/**
+ * @brief Строки [y, y + R): полные блоки по G групп, затем оставшиеся группы по одной.
+ */
+template<int R, int G>
+inline void microkernel_rows(const unsigned char* img_in, unsigned char* img_out, int w,
+                             const float* packed, int kW, int kH, int y, int xBegin, int xSimdEnd) {
+    int x = xBegin;
+    for (; x + 4 * G <= xSimdEnd; x += 4 * G) {
+        microkernel<R, G>(img_in, img_out, w, packed, kW, kH, x, y);
+    }
+    for (; x < xSimdEnd; x += 4) {
+        microkernel<R, 1>(img_in, img_out, w, packed, kW, kH, x, y);
+    }
+}
+
+// 6 строк x 4 группы: 24 аккумулятора + 4 входных вектора + вес = 29 из 32 регистров zmm
+constexpr int kBlockRows = 6;
+constexpr int kBlockGroups = 4;
+
+}  // namespace
+
+std::vector<unsigned char> ImageConvolver::process_SIMD_blocked(const unsigned char* img_in, int w, int h) {
+    if (!img_in) return {};
+
+    std::vector<unsigned char> img_out(static_cast<size_t>(w) * h * 4);
+    process_blocked_into(img_in, w, h, img_out.data());
+    return img_out;
+}
+
+PooledBuffer ImageConvolver::process_SIMD_blocked(BufferPool& pool, const unsigned char* img_in, int w, int h) {
+    if (!img_in) return {};
+
+    PooledBuffer img_out = pool.acquire(static_cast<size_t>(w) * h * 4);
+    process_blocked_into(img_in, w, h, img_out.data());
+    return img_out;
+}
+
+void ImageConvolver::process_blocked_into(const unsigned char* img_in, int w, int h, unsigned char* out) {
+    TraceScope trace("process_SIMD_blocked", "ImageConvolver", "w", w, "h", h);
+    prepare_dense();
+
+    const int kHalfW = m_kW / 2;
+    const int kHalfH = m_kH / 2;
+    const float* packed = m_packed_weights.data();
+
+    const int xBegin = kHalfW;
+    const int xEnd = w - kHalfW;
+    const int yBegin = kHalfH;
+    const int yEnd = h - kHalfH;
+    // Та же сетка 4-пиксельных групп, что и в process_region
+    const int xSimdEnd = (xEnd > xBegin) ? xBegin + ((xEnd - xBegin) / 4) * 4 : xBegin;
+
+    StageTimer convolveTimer(m_metrics, MetricStage::Convolve, MetricVariant::SIMDBlocked, w, h);
+    if (xBegin < xEnd && yBegin < yEnd) {
+        int y = yBegin;
+        for (; y + kBlockRows <= yEnd; y += kBlockRows) {
+            microkernel_rows<kBlockRows, kBlockGroups>(img_in, out, w, packed, m_kW, m_kH, y, xBegin, xSimdEnd);
+        }
+        for (; y < yEnd; ++y) {
+            microkernel_rows<1, kBlockGroups>(img_in, out, w, packed, m_kW, m_kH, y, xBegin, xSimdEnd);
+        }
+
+        // --- Хвост (меньше 4 пикселей в конце строки)
+        for (y = yBegin; y < yEnd; ++y) {
+            for (int x = xSimdEnd; x < xEnd; ++x) {
+                float sumR = 0.f, sumG = 0.f, sumB = 0.f;
+                for (int ky = -kHalfH; ky <= kHalfH; ++ky) {
+                    for (int kx = -kHalfW; kx <= kHalfW; ++kx) {
+                        int srcIdx = ((y + ky) * w + (x + kx)) * 4;
+                        float wgt = m_kernel[(ky + kHalfH) * m_kW + (kx + kHalfW)];
+                        sumR += wgt * img_in[srcIdx + 0];
+                        sumG += wgt * img_in[srcIdx + 1];
+                        sumB += wgt * img_in[srcIdx + 2];
+                    }
+                }
+                int dstIdx = (y * w + x) * 4;
+                out[dstIdx + 0] = (unsigned char)std::clamp(sumR, 0.f, 255.f);
+                out[dstIdx + 1] = (unsigned char)std::clamp(sumG, 0.f, 255.f);
+                out[dstIdx + 2] = (unsigned char)std::clamp(sumB, 0.f, 255.f);
+                out[dstIdx + 3] = img_in[dstIdx + 3];
+            }
+        }
+    }
+    convolveTimer.stop();
+
+    // Обработка границ (копирование)
+    StageTimer borderTimer(m_metrics, MetricStage::Border, MetricVariant::SIMDBlocked, w, h);
+    for (int y = 0; y < h; ++y) {
+        const size_t rowIdx = static_cast<size_t>(y) * w * 4;
+        if (y < kHalfH || y >= h - kHalfH || xBegin >= xEnd) {
+            std::copy(img_in + rowIdx, img_in + rowIdx + static_cast<size_t>(w) * 4, out + rowIdx);
+            continue;
+        }
+        std::copy(img_in + rowIdx, img_in + rowIdx + static_cast<size_t>(xBegin) * 4, out + rowIdx);
+        std::copy(img_in + rowIdx + static_cast<size_t>(xEnd) * 4, img_in + rowIdx + static_cast<size_t>(w) * 4,
+                  out + rowIdx + static_cast<size_t>(xEnd) * 4);
+    }
+}
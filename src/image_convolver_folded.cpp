@@ -0,0 +1,336 @@
+#include "image_convolver.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+
+namespace {
+
+// Допуск сравнения весов относительно наибольшего по модулю веса ядра
+constexpr float kSymmetryTolerance = 1e-6f;
+constexpr float kSeparableTolerance = 1e-5f;
+
+float max_abs(const std::vector<float>& kernel) {
+    float result = 0.f;
+    for (float v : kernel) {
+        result = std::max(result, std::fabs(v));
+    }
+    return result;
+}
+
+// 4 пикселя RGBA -> 16 x int32
+inline __m512i load_px4(const unsigned char* p) {
+    return _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+}
+
+// 16 float -> 4 пикселя RGBA (отбрасывание дробной части, насыщение), альфа из исходных пикселей
+inline void store_px4(unsigned char* dst, const unsigned char* src_alpha, __m512 acc) {
+    __m512i res32 = _mm512_cvttps_epi32(_mm512_max_ps(acc, _mm512_setzero_ps()));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm512_cvtusepi32_epi8(res32));
+    dst[3] = src_alpha[3];
+    dst[7] = src_alpha[7];
+    dst[11] = src_alpha[11];
+    dst[15] = src_alpha[15];
+}
+
+inline unsigned char clamp_u8(float v) {
+    return (unsigned char)std::clamp(v, 0.f, 255.f);
+}
+
+}  // namespace
+
+void ImageConvolver::copy_border(const unsigned char* img_in, int w, int h, unsigned char* out) const {
+    const int kHalfW = m_kW / 2;
+    const int kHalfH = m_kH / 2;
+    const int xBegin = kHalfW;
+    const int xEnd = w - kHalfW;
+    for (int y = 0; y < h; ++y) {
+        const size_t rowIdx = static_cast<size_t>(y) * w * 4;
+        if (y < kHalfH || y >= h - kHalfH || xBegin >= xEnd) {
+            std::copy(img_in + rowIdx, img_in + rowIdx + static_cast<size_t>(w) * 4, out + rowIdx);
+            continue;
+        }
+        std::copy(img_in + rowIdx, img_in + rowIdx + static_cast<size_t>(xBegin) * 4, out + rowIdx);
+        std::copy(img_in + rowIdx + static_cast<size_t>(xEnd) * 4, img_in + rowIdx + static_cast<size_t>(w) * 4,
+                  out + rowIdx + static_cast<size_t>(xEnd) * 4);
+    }
+}
+
+unsigned ImageConvolver::detect_symmetry(const std::vector<float>& kernel, int kW, int kH) {
+    const float tol = kSymmetryTolerance * max_abs(kernel);
+    auto at = [&](int y, int x) { return kernel[static_cast<size_t>(y) * kW + x]; };
+
+    bool horizontal = true;
+    bool vertical = true;
+    bool point = true;
+    for (int y = 0; y < kH; ++y) {
+        for (int x = 0; x < kW; ++x) {
+            horizontal = horizontal && std::fabs(at(y, x) - at(y, kW - 1 - x)) <= tol;
+            vertical = vertical && std::fabs(at(y, x) - at(kH - 1 - y, x)) <= tol;
+            point = point && std::fabs(at(y, x) - at(kH - 1 - y, kW - 1 - x)) <= tol;
+        }
+    }
+    return (horizontal ? kSymmetryHorizontal : 0u) | (vertical ? kSymmetryVertical : 0u) |
+           (point ? kSymmetryPoint : 0u);
+}
+
+std::vector<ImageConvolver::FoldedTap> ImageConvolver::fold_taps(const std::vector<float>& kernel, int kW, int kH,
+                                                                 unsigned symmetry) {
+    const int kHalfW = kW / 2;
+    const int kHalfH = kH / 2;
+    std::vector<char> used(kernel.size(), 0);
+    std::vector<FoldedTap> taps;
+
+    for (int ky = 0; ky < kH; ++ky) {
+        for (int kx = 0; kx < kW; ++kx) {
+            if (used[static_cast<size_t>(ky) * kW + kx]) {
+                continue;
+            }
+
+            // Орбита тапа: он сам и его зеркальные отражения (без повторов на осях)
+            int ys[4] = {ky, ky, kH - 1 - ky, kH - 1 - ky};
+            int xs[4] = {kx, kW - 1 - kx, kx, kW - 1 - kx};
+            bool take[4] = {true, (symmetry & kSymmetryHorizontal) != 0, (symmetry & kSymmetryVertical) != 0,
+                            (symmetry & kSymmetryPoint) != 0};
+
+            FoldedTap tap;
+            float sum = 0.f;
+            for (int m = 0; m < 4; ++m) {
+                const size_t idx = static_cast<size_t>(ys[m]) * kW + xs[m];
+                if (!take[m] || used[idx]) {
+                    continue;
+                }
+                used[idx] = 1;
+                sum += kernel[idx];
+                tap.dx[tap.count] = xs[m] - kHalfW;
+                tap.dy[tap.count] = ys[m] - kHalfH;
+                ++tap.count;
+            }
+            // Веса орбиты равны с точностью до допуска, берем среднее
+            tap.weight = sum / static_cast<float>(tap.count);
+            taps.push_back(tap);
+        }
+    }
+    return taps;
+}
+
+void ImageConvolver::prepare_folded_taps() const {
+    m_symmetry = detect_symmetry(m_kernel, m_kW, m_kH);
+    m_folded_taps = fold_taps(m_kernel, m_kW, m_kH, m_symmetry);
+
+    // Разложение ранга 1 относительно наибольшего по модулю веса: k(y, x) = col(y) * row(x)
+    const float maxAbs = max_abs(m_kernel);
+    if (m_kW < 2 || m_kH < 2 || maxAbs == 0.f) {
+        return;
+    }
+    size_t pivot = 0;
+    for (size_t i = 0; i < m_kernel.size(); ++i) {
+        if (std::fabs(m_kernel[i]) == maxAbs) {
+            pivot = i;
+            break;
+        }
+    }
+    const int py = static_cast<int>(pivot) / m_kW;
+    const int px = static_cast<int>(pivot) % m_kW;
+
+    std::vector<float> row(m_kW);
+    std::vector<float> col(m_kH);
+    for (int x = 0; x < m_kW; ++x) {
+        row[x] = m_kernel[static_cast<size_t>(py) * m_kW + x] / m_kernel[pivot];
+    }
+    for (int y = 0; y < m_kH; ++y) {
+        col[y] = m_kernel[static_cast<size_t>(y) * m_kW + px];
+    }
+
+    const float tol = kSeparableTolerance * maxAbs;
+    for (int y = 0; y < m_kH; ++y) {
+        for (int x = 0; x < m_kW; ++x) {
+            if (std::fabs(m_kernel[static_cast<size_t>(y) * m_kW + x] - col[y] * row[x]) > tol) {
+                return;
+            }
+        }
+    }
+
+    m_separable = true;
+    m_row_taps = fold_taps(row, m_kW, 1, detect_symmetry(row, m_kW, 1));
+    m_col_taps = fold_taps(col, 1, m_kH, detect_symmetry(col, 1, m_kH));
+}
+
+size_t ImageConvolver::folded_multiplies() const {
+    prepare_dense();
+    return m_separable ? m_row_taps.size() + m_col_taps.size() : m_folded_taps.size();
+}
+
+std::vector<unsigned char> ImageConvolver::process_folded(const unsigned char* img_in, int w, int h) {
+    if (!img_in) return {};
+
+    TraceScope trace("process_folded", "ImageConvolver", "w", w, "h", h);
+    prepare_dense();
+    std::vector<unsigned char> img_out(static_cast<size_t>(w) * h * 4);
+
+    StageTimer convolveTimer(m_metrics, MetricStage::Convolve, MetricVariant::Folded, w, h);
+    if (w > 2 * (m_kW / 2) && h > 2 * (m_kH / 2)) {
+        if (m_separable) {
+            process_folded_separable(img_in, w, h, img_out.data());
+        } else {
+            process_folded_2d(img_in, w, h, img_out.data());
+        }
+    }
+    convolveTimer.stop();
+
+    StageTimer borderTimer(m_metrics, MetricStage::Border, MetricVariant::Folded, w, h);
+    copy_border(img_in, w, h, img_out.data());
+    return img_out;
+}
+
+void ImageConvolver::process_folded_2d(const unsigned char* img_in, int w, int h, unsigned char* out) const {
+    const int kHalfW = m_kW / 2;
+    const int kHalfH = m_kH / 2;
+    const int xBegin = kHalfW;
+    const int xEnd = w - kHalfW;
+
+    // Смещения тапов в байтах относительно центрального пикселя
+    const size_t tapCount = m_folded_taps.size();
+    std::vector<long> offsets(tapCount * 4);
+    for (size_t t = 0; t < tapCount; ++t) {
+        const FoldedTap& tap = m_folded_taps[t];
+        for (int m = 0; m < tap.count; ++m) {
+            offsets[t * 4 + m] = (static_cast<long>(tap.dy[m]) * w + tap.dx[m]) * 4;
+        }
+    }
+
+    for (int y = kHalfH; y < h - kHalfH; ++y) {
+        int x = xBegin;
+        for (; x + 4 <= xEnd; x += 4) {
+            const size_t idx = (static_cast<size_t>(y) * w + x) * 4;
+            const unsigned char* center = img_in + idx;
+
+            __m512 acc = _mm512_setzero_ps();
+            for (size_t t = 0; t < tapCount; ++t) {
+                const FoldedTap& tap = m_folded_taps[t];
+                const long* off = &offsets[t * 4];
+                // Сначала целочисленная сумма пикселей с одинаковым весом, затем одно умножение
+                __m512i sum = load_px4(center + off[0]);
+                for (int m = 1; m < tap.count; ++m) {
+                    sum = _mm512_add_epi32(sum, load_px4(center + off[m]));
+                }
+                acc = _mm512_fmadd_ps(_mm512_cvtepi32_ps(sum), _mm512_set1_ps(tap.weight), acc);
+            }
+            store_px4(out + idx, center, acc);
+        }
+
+        // --- Хвост (меньше 4 пикселей в конце строки)
+        for (; x < xEnd; ++x) {
+            const size_t idx = (static_cast<size_t>(y) * w + x) * 4;
+            float sum[3] = {0.f, 0.f, 0.f};
+            for (size_t t = 0; t < tapCount; ++t) {
+                const FoldedTap& tap = m_folded_taps[t];
+                for (int c = 0; c < 3; ++c) {
+                    int pixels = 0;
+                    for (int m = 0; m < tap.count; ++m) {
+                        pixels += img_in[idx + offsets[t * 4 + m] + c];
+                    }
+                    sum[c] += tap.weight * static_cast<float>(pixels);
+                }
+            }
+            out[idx + 0] = clamp_u8(sum[0]);
+            out[idx + 1] = clamp_u8(sum[1]);
+            out[idx + 2] = clamp_u8(sum[2]);
+            out[idx + 3] = img_in[idx + 3];
+        }
+    }
+}
+
+void ImageConvolver::process_folded_separable(const unsigned char* img_in, int w, int h, unsigned char* out) const {
+    const int kHalfW = m_kW / 2;
+    const int kHalfH = m_kH / 2;
+    const int xBegin = kHalfW;
+    const int xEnd = w - kHalfW;
+    const int rowFloats = (xEnd - xBegin) * 4;
+
+    // Кольцо из kH строк горизонтального прохода (float, только внутренние столбцы):
+    // строка r лежит в слоте r % kH, промежуточного буфера на все изображение нет
+    std::vector<float> ring(static_cast<size_t>(m_kH) * rowFloats);
+
+    auto horizontal_pass = [&](int r) {
+        float* dst = ring.data() + static_cast<size_t>(r % m_kH) * rowFloats;
+        const unsigned char* row = img_in + static_cast<size_t>(r) * w * 4;
+        int x = xBegin;
+        for (; x + 4 <= xEnd; x += 4) {
+            const unsigned char* center = row + static_cast<size_t>(x) * 4;
+            __m512 acc = _mm512_setzero_ps();
+            for (const FoldedTap& tap : m_row_taps) {
+                __m512i sum = load_px4(center + tap.dx[0] * 4);
+                for (int m = 1; m < tap.count; ++m) {
+                    sum = _mm512_add_epi32(sum, load_px4(center + tap.dx[m] * 4));
+                }
+                acc = _mm512_fmadd_ps(_mm512_cvtepi32_ps(sum), _mm512_set1_ps(tap.weight), acc);
+            }
+            _mm512_storeu_ps(dst + (x - xBegin) * 4, acc);
+        }
+        for (; x < xEnd; ++x) {
+            const unsigned char* center = row + static_cast<size_t>(x) * 4;
+            for (int c = 0; c < 4; ++c) {
+                float sum = 0.f;
+                for (const FoldedTap& tap : m_row_taps) {
+                    int pixels = 0;
+                    for (int m = 0; m < tap.count; ++m) {
+                        pixels += center[tap.dx[m] * 4 + c];
+                    }
+                    sum += tap.weight * static_cast<float>(pixels);
+                }
+                dst[(x - xBegin) * 4 + c] = sum;
+            }
+        }
+    };
+
+    // Указатели на строки кольца для каждого тапа вертикального прохода
+    const size_t colCount = m_col_taps.size();
+    std::vector<const float*> rows(colCount * 4);
+
+    for (int r = 0; r < 2 * kHalfH; ++r) {
+        horizontal_pass(r);
+    }
+    for (int y = kHalfH; y < h - kHalfH; ++y) {
+        horizontal_pass(y + kHalfH);
+
+        for (size_t t = 0; t < colCount; ++t) {
+            const FoldedTap& tap = m_col_taps[t];
+            for (int m = 0; m < tap.count; ++m) {
+                rows[t * 4 + m] = ring.data() + static_cast<size_t>((y + tap.dy[m]) % m_kH) * rowFloats;
+            }
+        }
+
+        const size_t rowIdx = (static_cast<size_t>(y) * w + xBegin) * 4;
+        int i = 0;
+        for (; i + 16 <= rowFloats; i += 16) {
+            __m512 acc = _mm512_setzero_ps();
+            for (size_t t = 0; t < colCount; ++t) {
+                const FoldedTap& tap = m_col_taps[t];
+                const float* const* src = &rows[t * 4];
+                __m512 sum = _mm512_loadu_ps(src[0] + i);
+                for (int m = 1; m < tap.count; ++m) {
+                    sum = _mm512_add_ps(sum, _mm512_loadu_ps(src[m] + i));
+                }
+                acc = _mm512_fmadd_ps(sum, _mm512_set1_ps(tap.weight), acc);
+            }
+            store_px4(out + rowIdx + i, img_in + rowIdx + i, acc);
+        }
+        for (; i < rowFloats; ++i) {
+            if (i % 4 == 3) {
+                out[rowIdx + i] = img_in[rowIdx + i];
+                continue;
+            }
+            float acc = 0.f;
+            for (size_t t = 0; t < colCount; ++t) {
+                const FoldedTap& tap = m_col_taps[t];
+                float sum = 0.f;
+                for (int m = 0; m < tap.count; ++m) {
+                    sum += rows[t * 4 + m][i];
+                }
+                acc += tap.weight * sum;
+            }
+            out[rowIdx + i] = clamp_u8(acc);
+        }
+    }
+}
@@ -0,0 +1,182 @@
+#include "image_convolver.h"
+#include <algorithm>
+#include <immintrin.h>
+
+namespace {
+
+/**
+ * @brief Загрузка/сохранение 16 компонент заданного типа в регистр из 16 float.
+ */
+template<typename T>
+struct PixelTraits;
+
+template<>
+struct PixelTraits<unsigned char> {
+    static constexpr float kMax = 255.f;
+
+    static __m512 load16(const unsigned char* p) {
+        __m128i v8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(v8));
+    }
+
+    static void store16(unsigned char* p, __m512 v) {
+        v = _mm512_min_ps(_mm512_max_ps(v, _mm512_setzero_ps()), _mm512_set1_ps(kMax));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm512_cvtepi32_epi8(_mm512_cvttps_epi32(v)));
+    }
+
+    static unsigned char from_float(float v) {
+        return static_cast<unsigned char>(std::clamp(v, 0.f, kMax));
+    }
+};
+
+template<>
+struct PixelTraits<unsigned short> {
+    static constexpr float kMax = 65535.f;
+
+    static __m512 load16(const unsigned short* p) {
+        __m256i v16 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        return _mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(v16));
+    }
+
+    static void store16(unsigned short* p, __m512 v) {
+        v = _mm512_min_ps(_mm512_max_ps(v, _mm512_setzero_ps()), _mm512_set1_ps(kMax));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtepi32_epi16(_mm512_cvttps_epi32(v)));
+    }
+
+    static unsigned short from_float(float v) {
+        return static_cast<unsigned short>(std::clamp(v, 0.f, kMax));
+    }
+};
+
+template<>
+struct PixelTraits<float> {
+    static __m512 load16(const float* p) {
+        return _mm512_loadu_ps(p);
+    }
+
+    static void store16(float* p, __m512 v) {
+        _mm512_storeu_ps(p, v);
+    }
+
+    static float from_float(float v) {
+        return v;
+    }
+};
+
+/**
+ * @brief Маска альфа-канала внутри 16 компонент (группа начинается с канала 0).
+ * Для C = 3 альфы нет; для C = 1 и C = 3 все каналы сворачиваются.
+ */
+template<int C>
+constexpr __mmask16 alpha_mask() {
+    if constexpr (C == 4) {
+        return 0x8888;
+    } else if constexpr (C == 2) {
+        return 0xAAAA;
+    } else {
+        return 0;
+    }
+}
+
+template<int C>
+constexpr bool has_alpha() {
+    return C == 2 || C == 4;
+}
+
+}  // namespace
+
+template<typename T, int C>
+std::vector<T> ImageConvolver::process_native(const T* img_in, int w, int h) {
+    static_assert(C >= 1 && C <= 4, "Channel count must be 1..4");
+    using Traits = PixelTraits<T>;
+
+    if (!img_in) return {};
+    prepare_dense();
+
+    const size_t total = static_cast<size_t>(w) * static_cast<size_t>(h) * C;
+    std::vector<T> img_out(total);
+
+    int kHalfW = m_kW / 2;
+    int kHalfH = m_kH / 2;
+    const int stride = w * C;
+
+    // Строка рассматривается как плоский массив из w * C компонент:
+    // компонента j на выходе зависит от компонент j + kx * C соседних строк,
+    // поэтому 16 подряд идущих компонент считаются одним регистром при любом C.
+    int jBegin = kHalfW * C;
+    int jEnd = (w - kHalfW) * C;
+    // Для C = 3 группа из 16 компонент не кратна пикселю, хвост считается скалярно
+    int jSimdEnd = (jEnd > jBegin) ? jBegin + ((jEnd - jBegin) / 16) * 16 : jBegin;
+
+    StageTimer convolveTimer(m_metrics, MetricStage::Convolve, MetricVariant::Native, w, h);
+    for (int y = kHalfH; y < h - kHalfH; ++y) {
+        const T* rowCenter = img_in + static_cast<size_t>(y) * stride;
+        T* rowOut = img_out.data() + static_cast<size_t>(y) * stride;
+
+        int j = jBegin;
+        for (; j < jSimdEnd; j += 16) {
+            __m512 vSum = _mm512_setzero_ps();
+
+            for (int ky = -kHalfH; ky <= kHalfH; ++ky) {
+                const T* row = rowCenter + ky * stride + j;
+                for (int kx = -kHalfW; kx <= kHalfW; ++kx) {
+                    __m512 vWgt = _mm512_set1_ps(m_kernel[(ky + kHalfH) * m_kW + (kx + kHalfW)]);
+                    vSum = _mm512_fmadd_ps(Traits::load16(row + kx * C), vWgt, vSum);
+                }
+            }
+
+            if constexpr (has_alpha<C>()) {
+                // Альфа берется из исходного пикселя без изменений
+                vSum = _mm512_mask_blend_ps(alpha_mask<C>(), vSum, Traits::load16(rowCenter + j));
+            }
+            Traits::store16(rowOut + j, vSum);
+        }
+
+        // --- Хвост (дорабатываем оставшиеся компоненты)
+        for (; j < jEnd; ++j) {
+            int c = j % C;
+            if (has_alpha<C>() && c == C - 1) {
+                rowOut[j] = rowCenter[j];
+                continue;
+            }
+            float sum = 0.f;
+            for (int ky = -kHalfH; ky <= kHalfH; ++ky) {
+                const T* row = rowCenter + ky * stride + j;
+                for (int kx = -kHalfW; kx <= kHalfW; ++kx) {
+                    sum += m_kernel[(ky + kHalfH) * m_kW + (kx + kHalfW)] * static_cast<float>(row[kx * C]);
+                }
+            }
+            rowOut[j] = Traits::from_float(sum);
+        }
+    }
+
+    convolveTimer.stop();
+
+    // Обработка границ (копирование)
+    StageTimer borderTimer(m_metrics, MetricStage::Border, MetricVariant::Native, w, h);
+    for (int y = 0; y < h; ++y) {
+        const T* rowIn = img_in + static_cast<size_t>(y) * stride;
+        T* rowOut = img_out.data() + static_cast<size_t>(y) * stride;
+        if (y < kHalfH || y >= h - kHalfH || jBegin >= jEnd) {
+            std::copy(rowIn, rowIn + stride, rowOut);
+            continue;
+        }
+        std::copy(rowIn, rowIn + jBegin, rowOut);
+        std::copy(rowIn + jEnd, rowIn + stride, rowOut + jEnd);
+    }
+
+    return img_out;
+}
+
+// Явные инстанцирования для всех поддерживаемых форматов
+#define INSTANTIATE_PROCESS_NATIVE(T)                                                          \
+    template std::vector<T> ImageConvolver::process_native<T, 1>(const T*, int, int);          \
+    template std::vector<T> ImageConvolver::process_native<T, 2>(const T*, int, int);          \
+    template std::vector<T> ImageConvolver::process_native<T, 3>(const T*, int, int);          \
+    template std::vector<T> ImageConvolver::process_native<T, 4>(const T*, int, int);
+
+INSTANTIATE_PROCESS_NATIVE(unsigned char)
+INSTANTIATE_PROCESS_NATIVE(unsigned short)
+INSTANTIATE_PROCESS_NATIVE(float)
+
+#undef INSTANTIATE_PROCESS_NATIVE
@@ -0,0 +1,157 @@
+#include "image_convolver.h"
+#include "trace.h"
+#include <algorithm>
+#include <immintrin.h>
+
+namespace {
+
+// 4 пикселя RGBA -> 16 float
+inline __m512 load_px4_ps(const unsigned char* p) {
+    return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+}
+
+// 16 float -> 4 пикселя RGBA (отбрасывание дробной части, насыщение), альфа из исходных пикселей
+inline void store_px4(unsigned char* dst, const unsigned char* src_alpha, __m512 acc) {
+    __m512i res32 = _mm512_cvttps_epi32(_mm512_max_ps(acc, _mm512_setzero_ps()));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm512_cvtusepi32_epi8(res32));
+    dst[3] = src_alpha[3];
+    dst[7] = src_alpha[7];
+    dst[11] = src_alpha[11];
+    dst[15] = src_alpha[15];
+}
+
+}  // namespace
+
+void ImageConvolver::prepare_sparse_taps(const std::vector<float>& kernel, int kW, int kH) {
+    // Смещения от центра разреженного ядра m_kW x m_kH (см. конструктор)
+    const int kHalfW = m_kW / 2;
+    const int kHalfH = m_kH / 2;
+    m_sparse_taps.clear();
+    for (int y = 0; y < kH; ++y) {
+        for (int x = 0; x < kW; ++x) {
+            const float weight = kernel[static_cast<size_t>(y) * kW + x];
+            if (weight != 0.f) {
+                m_sparse_taps.push_back({x * m_dilation - kHalfW, y * m_dilation - kHalfH, weight});
+            }
+        }
+    }
+}
+
+std::vector<unsigned char> ImageConvolver::process_sparse(const unsigned char* img_in, int w, int h) {
+    if (!img_in) return {};
+
+    TraceScope trace("process_sparse", "ImageConvolver", "w", w, "h", h);
+    std::vector<unsigned char> img_out(static_cast<size_t>(w) * h * 4);
+
+    StageTimer convolveTimer(m_metrics, MetricStage::Convolve, MetricVariant::Sparse, w, h);
+    sparse_rows(img_in, w, img_out.data(), m_kH / 2, h - m_kH / 2);
+    convolveTimer.stop();
+
+    StageTimer borderTimer(m_metrics, MetricStage::Border, MetricVariant::Sparse, w, h);
+    copy_border(img_in, w, h, img_out.data());
+    return img_out;
+}
+
+std::vector<unsigned char> ImageConvolver::process_sparse_thread_pool(const unsigned char* img_in, int w, int h,
+                                                                      size_t num_threads) {
+    if (!img_in) return {};
+
+    ThreadPool pool(num_threads);
+    return process_sparse_thread_pool(pool, img_in, w, h);
+}
+
+std::vector<unsigned char> ImageConvolver::process_sparse_thread_pool(ThreadPool& pool, const unsigned char* img_in,
+                                                                      int w, int h, TaskPriority priority) {
+    if (!img_in) return {};
+
+    TraceScope trace("process_sparse_thread_pool", "ImageConvolver", "w", w, "h", h);
+    std::vector<unsigned char> img_out(static_cast<size_t>(w) * h * 4);
+    unsigned char* out = img_out.data();
+
+    StageTimer convolveTimer(m_metrics, MetricStage::Convolve, MetricVariant::Sparse, w, h);
+    TaskGroup group(pool, priority);
+    for (const RowRange& rows : split_rows(m_kH / 2, h - m_kH / 2, pool.get_thread_count())) {
+        group.run([=]() {
+            TraceScope band("sparse_band", "ImageConvolver", "y0", rows.begin, "y1", rows.end);
+            sparse_rows(img_in, w, out, rows.begin, rows.end);
+        });
+    }
+    group.wait();
+    convolveTimer.stop();
+
+    StageTimer borderTimer(m_metrics, MetricStage::Border, MetricVariant::Sparse, w, h);
+    copy_border(img_in, w, h, out);
+    return img_out;
+}
+
+void ImageConvolver::sparse_rows(const unsigned char* img_in, int w, unsigned char* img_out, int y0, int y1) const {
+    const int kHalfW = m_kW / 2;
+    const int xBegin = kHalfW;
+    const int xEnd = w - kHalfW;
+    if (xBegin >= xEnd || y0 >= y1) {
+        return;
+    }
+    // Граница SIMD-групп по 4 пикселя та же, что в process_SIMD (от kHalfW)
+    const int xSimdEnd = xBegin + ((xEnd - xBegin) / 4) * 4;
+
+    // Смещения тапов в байтах относительно центрального пикселя (зависят от w)
+    const size_t tapCount = m_sparse_taps.size();
+    std::vector<long> offsets(tapCount);
+    for (size_t t = 0; t < tapCount; ++t) {
+        offsets[t] = (static_cast<long>(m_sparse_taps[t].dy) * w + m_sparse_taps[t].dx) * 4;
+    }
+
+    for (int y = y0; y < y1; ++y) {
+        int x = xBegin;
+
+        // 16 пикселей за итерацию: 4 независимых аккумулятора на один вес
+        for (; x + 16 <= xSimdEnd; x += 16) {
+            const size_t idx = (static_cast<size_t>(y) * w + x) * 4;
+            const unsigned char* center = img_in + idx;
+            __m512 acc0 = _mm512_setzero_ps();
+            __m512 acc1 = _mm512_setzero_ps();
+            __m512 acc2 = _mm512_setzero_ps();
+            __m512 acc3 = _mm512_setzero_ps();
+            for (size_t t = 0; t < tapCount; ++t) {
+                const __m512 wgt = _mm512_set1_ps(m_sparse_taps[t].weight);
+                const unsigned char* p = center + offsets[t];
+                acc0 = _mm512_fmadd_ps(load_px4_ps(p), wgt, acc0);
+                acc1 = _mm512_fmadd_ps(load_px4_ps(p + 16), wgt, acc1);
+                acc2 = _mm512_fmadd_ps(load_px4_ps(p + 32), wgt, acc2);
+                acc3 = _mm512_fmadd_ps(load_px4_ps(p + 48), wgt, acc3);
+            }
+            store_px4(img_out + idx, center, acc0);
+            store_px4(img_out + idx + 16, center + 16, acc1);
+            store_px4(img_out + idx + 32, center + 32, acc2);
+            store_px4(img_out + idx + 48, center + 48, acc3);
+        }
+
+        // 4 пикселя за итерацию
+        for (; x < xSimdEnd; x += 4) {
+            const size_t idx = (static_cast<size_t>(y) * w + x) * 4;
+            const unsigned char* center = img_in + idx;
+            __m512 acc = _mm512_setzero_ps();
+            for (size_t t = 0; t < tapCount; ++t) {
+                acc = _mm512_fmadd_ps(load_px4_ps(center + offsets[t]), _mm512_set1_ps(m_sparse_taps[t].weight), acc);
+            }
+            store_px4(img_out + idx, center, acc);
+        }
+
+        // --- Хвост (меньше 4 пикселей в конце строки), как в process_SIMD
+        for (; x < xEnd; ++x) {
+            const size_t idx = (static_cast<size_t>(y) * w + x) * 4;
+            float sumR = 0.f, sumG = 0.f, sumB = 0.f;
+            for (size_t t = 0; t < tapCount; ++t) {
+                const unsigned char* p = img_in + idx + offsets[t];
+                const float wgt = m_sparse_taps[t].weight;
+                sumR += wgt * p[0];
+                sumG += wgt * p[1];
+                sumB += wgt * p[2];
+            }
+            img_out[idx + 0] = (unsigned char)std::clamp(sumR, 0.f, 255.f);
+            img_out[idx + 1] = (unsigned char)std::clamp(sumG, 0.f, 255.f);
+            img_out[idx + 2] = (unsigned char)std::clamp(sumB, 0.f, 255.f);
+            img_out[idx + 3] = img_in[idx + 3];
+        }
+    }
+}
@@ -0,0 +1,269 @@
+#include "median_filter.h"
+#include "image_convolver.h"
+#include "trace.h"
+#include <algorithm>
+#include <immintrin.h>
+#include <stdexcept>
+
+namespace {
+
+constexpr int kMaxWindow = MedianFilter::kNetworkMaxSize * MedianFilter::kNetworkMaxSize;
+
+// Гистограмма канала: 256 точных корзин и 16 грубых (по старшим 4 битам)
+constexpr int kFineBins = 256;
+constexpr int kCoarseBins = 16;
+constexpr int kChannels = 3;
+
+struct ColumnHistogram {
+    uint16_t fine[kChannels][kFineBins];
+    uint16_t coarse[kChannels][kCoarseBins];
+};
+
+inline void add_column(ColumnHistogram& dst, const ColumnHistogram& src) {
+    for (int c = 0; c < kChannels; ++c) {
+        for (int i = 0; i < kFineBins; ++i) dst.fine[c][i] += src.fine[c][i];
+        for (int i = 0; i < kCoarseBins; ++i) dst.coarse[c][i] += src.coarse[c][i];
+    }
+}
+
+inline void sub_column(ColumnHistogram& dst, const ColumnHistogram& src) {
+    for (int c = 0; c < kChannels; ++c) {
+        for (int i = 0; i < kFineBins; ++i) dst.fine[c][i] -= src.fine[c][i];
+        for (int i = 0; i < kCoarseBins; ++i) dst.coarse[c][i] -= src.coarse[c][i];
+    }
+}
+
+inline void add_pixel(ColumnHistogram& hist, const unsigned char* px, int delta) {
+    for (int c = 0; c < kChannels; ++c) {
+        hist.fine[c][px[c]] += delta;
+        hist.coarse[c][px[c] >> 4] += delta;
+    }
+}
+
+// Наименьшее значение, у которого накопленная частота больше rank
+inline unsigned char find_median(const ColumnHistogram& hist, int c, int rank) {
+    int seen = 0;
+    int bin = 0;
+    while (seen + hist.coarse[c][bin] <= rank) {
+        seen += hist.coarse[c][bin];
+        ++bin;
+    }
+    int value = bin * 16;
+    while (seen + hist.fine[c][value] <= rank) {
+        seen += hist.fine[c][value];
+        ++value;
+    }
+    return static_cast<unsigned char>(value);
+}
+
+/**
+ * @brief Сеть сравнений Бэтчера (odd-even merge) для n элементов, обрезанная
+ * до тех сравнений, от которых зависит элемент с индексом target.
+ */
+template<typename Comparator>
+std::vector<Comparator> median_network(int n, int target) {
+    std::vector<std::pair<int, int>> full;
+    for (int p = 1; p < n; p <<= 1) {
+        for (int k = p; k >= 1; k >>= 1) {
+            for (int j = k % p; j + k < n; j += 2 * k) {
+                for (int i = 0; i < std::min(k, n - j - k); ++i) {
+                    if ((i + j) / (2 * p) == (i + j + k) / (2 * p)) {
+                        full.emplace_back(i + j, i + j + k);
+                    }
+                }
+            }
+        }
+    }
+
+    // Обратный проход: сравнение нужно, если нужен хотя бы один из его выходов
+    std::vector<bool> live(n, false);
+    live[target] = true;
+    std::vector<Comparator> pruned;
+    for (auto it = full.rbegin(); it != full.rend(); ++it) {
+        const int a = it->first;
+        const int b = it->second;
+        if (!live[a] && !live[b]) {
+            continue;
+        }
+        pruned.push_back({static_cast<uint16_t>(a), static_cast<uint16_t>(b), live[a], live[b]});
+        live[a] = true;
+        live[b] = true;
+    }
+    std::reverse(pruned.begin(), pruned.end());
+    return pruned;
+}
+
+}  // namespace
+
+MedianFilter::MedianFilter(int size)
+    : m_size(size)
+{
+    if (size < 1 || size % 2 == 0) {
+        throw std::invalid_argument("MedianFilter: window size must be odd and positive");
+    }
+    if (uses_sorting_network()) {
+        const int n = size * size;
+        m_network = median_network<Comparator>(n, n / 2);
+    }
+}
+
+size_t MedianFilter::network_ops() const {
+    size_t ops = 0;
+    for (const Comparator& c : m_network) {
+        ops += (c.keep_min ? 1 : 0) + (c.keep_max ? 1 : 0);
+    }
+    return ops;
+}
+
+std::vector<unsigned char> MedianFilter::process(const unsigned char* img_in, int w, int h) {
+    if (!img_in) return {};
+
+    TraceScope trace("median", "MedianFilter", "w", w, "h", h);
+    // Границы и альфа остаются исходными: начинаем с копии входа
+    std::vector<unsigned char> img_out(img_in, img_in + static_cast<size_t>(w) * h * 4);
+    const int r = m_size / 2;
+    process_rows(img_in, w, h, img_out.data(), r, h - r);
+    return img_out;
+}
+
+std::vector<unsigned char> MedianFilter::process_thread_pool(const unsigned char* img_in, int w, int h,
+                                                             size_t num_threads) {
+    if (!img_in) return {};
+
+    ThreadPool pool(num_threads);
+    return process_thread_pool(pool, img_in, w, h);
+}
+
+std::vector<unsigned char> MedianFilter::process_thread_pool(ThreadPool& pool, const unsigned char* img_in,
+                                                             int w, int h) {
+    if (!img_in) return {};
+
+    TraceScope trace("median_thread_pool", "MedianFilter", "w", w, "h", h);
+    std::vector<unsigned char> img_out(img_in, img_in + static_cast<size_t>(w) * h * 4);
+    const int r = m_size / 2;
+
+    TaskGroup group(pool);
+    for (const RowRange& rows : ImageConvolver::split_rows(r, h - r, pool.get_thread_count())) {
+        group.run([=, &img_out]() {
+            TraceScope band("median_band", "MedianFilter", "y0", rows.begin, "y1", rows.end);
+            process_rows(img_in, w, h, img_out.data(), rows.begin, rows.end);
+        });
+    }
+    group.wait();
+    return img_out;
+}
+
+void MedianFilter::process_rows(const unsigned char* img_in, int w, int h, unsigned char* img_out,
+                                int y0, int y1) const {
+    const int r = m_size / 2;
+    if (y0 >= y1 || w <= 2 * r) {
+        return;
+    }
+    if (uses_sorting_network()) {
+        network_rows(img_in, w, h, img_out, y0, y1);
+    } else {
+        histogram_rows(img_in, w, h, img_out, y0, y1);
+    }
+}
+
+void MedianFilter::network_rows(const unsigned char* img_in, int w, int, unsigned char* img_out,
+                                int y0, int y1) const {
+    const int r = m_size / 2;
+    const int n = m_size * m_size;
+    const int xEnd = w - r;
+
+    // Смещения элементов окна в байтах относительно центрального пикселя
+    long offsets[kMaxWindow];
+    for (int dy = -r, k = 0; dy <= r; ++dy) {
+        for (int dx = -r; dx <= r; ++dx, ++k) {
+            offsets[k] = (static_cast<long>(dy) * w + dx) * 4;
+        }
+    }
+    // Каждый 4-й байт - альфа, она берется из исходного пикселя
+    const __mmask64 alphaMask = 0x8888888888888888ULL;
+
+    for (int y = y0; y < y1; ++y) {
+        int x = r;
+        // 16 пикселей (64 байта) за итерацию
+        for (; x + 16 <= xEnd; x += 16) {
+            const size_t idx = (static_cast<size_t>(y) * w + x) * 4;
+            const unsigned char* center = img_in + idx;
+
+            __m512i v[kMaxWindow];
+            for (int k = 0; k < n; ++k) {
+                v[k] = _mm512_loadu_si512(center + offsets[k]);
+            }
+            for (const Comparator& c : m_network) {
+                const __m512i a = v[c.a];
+                const __m512i b = v[c.b];
+                if (c.keep_min) v[c.a] = _mm512_min_epu8(a, b);
+                if (c.keep_max) v[c.b] = _mm512_max_epu8(a, b);
+            }
+            const __m512i result = _mm512_mask_blend_epi8(alphaMask, v[n / 2], _mm512_loadu_si512(center));
+            _mm512_storeu_si512(img_out + idx, result);
+        }
+
+        // --- Хвост (меньше 16 пикселей в конце строки)
+        for (; x < xEnd; ++x) {
+            const size_t idx = (static_cast<size_t>(y) * w + x) * 4;
+            unsigned char values[kMaxWindow];
+            for (int c = 0; c < 3; ++c) {
+                for (int k = 0; k < n; ++k) {
+                    values[k] = img_in[idx + offsets[k] + c];
+                }
+                std::nth_element(values, values + n / 2, values + n);
+                img_out[idx + c] = values[n / 2];
+            }
+        }
+    }
+}
+
+void MedianFilter::histogram_rows(const unsigned char* img_in, int w, int, unsigned char* img_out,
+                                  int y0, int y1) const {
+    const int r = m_size / 2;
+    const int rank = (m_size * m_size) / 2;
+    const size_t stride = static_cast<size_t>(w) * 4;
+
+    // Гистограммы столбцов покрывают строки [y - r, y + r] текущей строки y
+    std::vector<ColumnHistogram> columns(w);
+    for (ColumnHistogram& column : columns) {
+        std::fill_n(&column.fine[0][0], kChannels * kFineBins, uint16_t(0));
+        std::fill_n(&column.coarse[0][0], kChannels * kCoarseBins, uint16_t(0));
+    }
+    for (int yy = y0 - r; yy <= y0 + r; ++yy) {
+        const unsigned char* row = img_in + yy * stride;
+        for (int x = 0; x < w; ++x) {
+            add_pixel(columns[x], row + x * 4, 1);
+        }
+    }
+
+    ColumnHistogram window;
+    for (int y = y0; y < y1; ++y) {
+        if (y > y0) {
+            const unsigned char* removed = img_in + (y - r - 1) * stride;
+            const unsigned char* added = img_in + (y + r) * stride;
+            for (int x = 0; x < w; ++x) {
+                add_pixel(columns[x], removed + x * 4, -1);
+                add_pixel(columns[x], added + x * 4, 1);
+            }
+        }
+
+        std::fill_n(&window.fine[0][0], kChannels * kFineBins, uint16_t(0));
+        std::fill_n(&window.coarse[0][0], kChannels * kCoarseBins, uint16_t(0));
+        for (int x = 0; x < 2 * r + 1; ++x) {
+            add_column(window, columns[x]);
+        }
+
+        unsigned char* outRow = img_out + y * stride;
+        for (int x = r; x < w - r; ++x) {
+            if (x > r) {
+                // Сдвиг окна: одна гистограмма столбца входит, одна выходит
+                add_column(window, columns[x + r]);
+                sub_column(window, columns[x - r - 1]);
+            }
+            for (int c = 0; c < kChannels; ++c) {
+                outRow[x * 4 + c] = find_median(window, c, rank);
+            }
+        }
+    }
+}
@@ -0,0 +1,248 @@
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+
+constexpr size_t kStageCount = static_cast<size_t>(MetricStage::Count);
+constexpr size_t kVariantCount = static_cast<size_t>(MetricVariant::Count);
+constexpr size_t kHistogramCount = kStageCount * kVariantCount * MetricsRegistry::kSizeBuckets;
+
+int highest_bit(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index = 0;
+    _BitScanReverse64(&index, value);
+    return static_cast<int>(index);
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+}  // namespace
+
+uint64_t HistogramSnapshot::quantile_ns(double q) const {
+    if (count == 0 || buckets.empty()) return 0;
+
+    q = std::clamp(q, 0.0, 1.0);
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(count)));
+    rank = std::max<uint64_t>(rank, 1);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            return std::min(LatencyHistogram::bucket_upper(static_cast<int>(i)), max_ns);
+        }
+    }
+    return max_ns;
+}
+
+double HistogramSnapshot::mean_ns() const {
+    return count ? static_cast<double>(sum_ns) / static_cast<double>(count) : 0.0;
+}
+
+int LatencyHistogram::bucket_index(uint64_t value_ns) {
+    if (value_ns < static_cast<uint64_t>(kSubBuckets)) {
+        return static_cast<int>(value_ns);
+    }
+    int exponent = highest_bit(value_ns);
+    if (exponent >= kMaxExponent) {
+        return kBucketCount - 1;
+    }
+    // Старшие kSubBucketBits бит после ведущей единицы задают корзину внутри октавы
+    int sub = static_cast<int>((value_ns >> (exponent - kSubBucketBits)) & (kSubBuckets - 1));
+    return kSubBuckets + (exponent - kSubBucketBits) * kSubBuckets + sub;
+}
+
+uint64_t LatencyHistogram::bucket_upper(int index) {
+    if (index < kSubBuckets) {
+        return static_cast<uint64_t>(index);
+    }
+    int octave = (index - kSubBuckets) / kSubBuckets;
+    int sub = (index - kSubBuckets) % kSubBuckets;
+    uint64_t width = uint64_t(1) << octave;
+    return (static_cast<uint64_t>(kSubBuckets + sub) << octave) + width - 1;
+}
+
+void LatencyHistogram::record(uint64_t value_ns) {
+    m_buckets[bucket_index(value_ns)].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value_ns, std::memory_order_relaxed);
+
+    uint64_t current = m_max.load(std::memory_order_relaxed);
+    while (value_ns > current &&
+           !m_max.compare_exchange_weak(current, value_ns, std::memory_order_relaxed)) {
+    }
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const {
+    HistogramSnapshot result;
+    result.sum_ns = m_sum.load(std::memory_order_relaxed);
+    result.max_ns = m_max.load(std::memory_order_relaxed);
+    result.buckets.resize(kBucketCount);
+    for (int i = 0; i < kBucketCount; ++i) {
+        result.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+        result.count += result.buckets[i];
+    }
+    return result;
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    m_sum.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+MetricsRegistry::MetricsRegistry()
+    : m_histograms(new LatencyHistogram[kHistogramCount])
+{
+}
+
+size_t MetricsRegistry::slot(MetricStage stage, MetricVariant variant, int size_bucket) {
+    return (static_cast<size_t>(stage) * kVariantCount + static_cast<size_t>(variant)) * kSizeBuckets +
+           static_cast<size_t>(size_bucket);
+}
+
+int MetricsRegistry::size_bucket(int w, int h) {
+    int64_t pixels = static_cast<int64_t>(std::max(w, 0)) * std::max(h, 0);
+    if (pixels <= 64 * 64) return 0;
+    if (pixels <= 256 * 256) return 1;
+    if (pixels <= 1024 * 1024) return 2;
+    if (pixels <= 4096 * 4096) return 3;
+    return 4;
+}
+
+void MetricsRegistry::record(MetricStage stage, MetricVariant variant, int w, int h, uint64_t duration_ns) {
+    m_histograms[slot(stage, variant, size_bucket(w, h))].record(duration_ns);
+}
+
+const LatencyHistogram& MetricsRegistry::histogram(MetricStage stage, MetricVariant variant, int size_bucket) const {
+    return m_histograms[slot(stage, variant, size_bucket)];
+}
+
+MetricsSnapshot MetricsRegistry::snapshot() const {
+    MetricsSnapshot result;
+    for (size_t s = 0; s < kStageCount; ++s) {
+        for (size_t v = 0; v < kVariantCount; ++v) {
+            for (int b = 0; b < kSizeBuckets; ++b) {
+                auto stage = static_cast<MetricStage>(s);
+                auto variant = static_cast<MetricVariant>(v);
+                HistogramSnapshot hist = histogram(stage, variant, b).snapshot();
+                if (hist.count == 0) {
+                    continue;
+                }
+                result.entries.push_back({stage, variant, b, std::move(hist)});
+            }
+        }
+    }
+    return result;
+}
+
+void MetricsRegistry::reset() {
+    for (size_t i = 0; i < kHistogramCount; ++i) {
+        m_histograms[i].reset();
+    }
+}
+
+std::string MetricsRegistry::expose_text() const {
+    static const double kQuantiles[] = {0.5, 0.9, 0.99, 0.999};
+
+    std::string out;
+    out += "# HELP blur_stage_latency_seconds Latency of ImageConvolver stages.\n";
+    out += "# TYPE blur_stage_latency_seconds summary\n";
+
+    char line[256];
+    MetricsSnapshot snap = snapshot();
+    for (const auto& entry : snap.entries) {
+        char labels[128];
+        std::snprintf(labels, sizeof(labels), "stage=\"%s\",variant=\"%s\",size=\"%s\"",
+                      stage_name(entry.stage), variant_name(entry.variant), size_bucket_name(entry.size_bucket));
+
+        for (double q : kQuantiles) {
+            std::snprintf(line, sizeof(line), "blur_stage_latency_seconds{%s,quantile=\"%g\"} %.9g\n",
+                          labels, q, entry.histogram.quantile_ns(q) * 1e-9);
+            out += line;
+        }
+        std::snprintf(line, sizeof(line), "blur_stage_latency_seconds_sum{%s} %.9g\n",
+                      labels, entry.histogram.sum_ns * 1e-9);
+        out += line;
+        std::snprintf(line, sizeof(line), "blur_stage_latency_seconds_count{%s} %llu\n",
+                      labels, static_cast<unsigned long long>(entry.histogram.count));
+        out += line;
+    }
+
+    out += "# HELP blur_stage_latency_max_seconds Maximum latency of ImageConvolver stages.\n";
+    out += "# TYPE blur_stage_latency_max_seconds gauge\n";
+    for (const auto& entry : snap.entries) {
+        std::snprintf(line, sizeof(line),
+                      "blur_stage_latency_max_seconds{stage=\"%s\",variant=\"%s\",size=\"%s\"} %.9g\n",
+                      stage_name(entry.stage), variant_name(entry.variant), size_bucket_name(entry.size_bucket),
+                      entry.histogram.max_ns * 1e-9);
+        out += line;
+    }
+    return out;
+}
+
+const char* MetricsRegistry::stage_name(MetricStage stage) {
+    switch (stage) {
+        case MetricStage::Load:
+            return "load";
+        case MetricStage::Convolve:
+            return "convolve";
+        case MetricStage::Border:
+            return "border";
+        case MetricStage::Save:
+            return "save";
+        case MetricStage::Count:
+            break;
+    }
+    return "unknown";
+}
+
+const char* MetricsRegistry::variant_name(MetricVariant variant) {
+    switch (variant) {
+        case MetricVariant::Io:
+            return "io";
+        case MetricVariant::Default:
+            return "default";
+        case MetricVariant::SIMD:
+            return "simd";
+        case MetricVariant::SIMDBlocked:
+            return "simd_blocked";
+        case MetricVariant::ThreadPool:
+            return "thread_pool";
+        case MetricVariant::ThreadPoolFull:
+            return "thread_pool_full";
+        case MetricVariant::Native:
+            return "native";
+        case MetricVariant::Decimate:
+            return "decimate";
+        case MetricVariant::Folded:
+            return "folded";
+        case MetricVariant::Sparse:
+            return "sparse";
+        case MetricVariant::Batch:
+            return "batch";
+        case MetricVariant::Count:
+            break;
+    }
+    return "unknown";
+}
+
+const char* MetricsRegistry::size_bucket_name(int size_bucket) {
+    static const char* kNames[kSizeBuckets] = {"le64", "le256", "le1024", "le4096", "gt4096"};
+    if (size_bucket < 0 || size_bucket >= kSizeBuckets) return "unknown";
+    return kNames[size_bucket];
+}
+
+uint64_t MetricsRegistry::now_ns() {
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+}
@@ -0,0 +1,150 @@
+#include "perf_counters.h"
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#if defined(__linux__)
+struct EventConfig {
+    uint32_t type;
+    uint64_t config;
+};
+
+EventConfig event_config(PerfCounters::Event event) {
+    switch (event) {
+        case PerfCounters::Cycles:
+            return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES};
+        case PerfCounters::Instructions:
+            return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS};
+        case PerfCounters::L1DMisses:
+            return {PERF_TYPE_HW_CACHE,
+                    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+        case PerfCounters::LLCMisses:
+            return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES};
+        case PerfCounters::BranchMisses:
+            return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES};
+        case PerfCounters::EventCount:
+            break;
+    }
+    return {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES};
+}
+
+int open_counter(PerfCounters::Event event) {
+    EventConfig cfg = event_config(event);
+
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = cfg.type;
+    attr.config = cfg.config;
+    attr.disabled = 1;
+    attr.inherit = 1;          // Считаем и потоки, созданные после start()
+    attr.exclude_kernel = 1;   // Не требует perf_event_paranoid < 2
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    long fd = syscall(__NR_perf_event_open, &attr, 0 /* этот процесс */, -1 /* любой CPU */, -1, 0);
+    return static_cast<int>(fd);
+}
+#endif
+
+}  // namespace
+
+PerfCounters::PerfCounters() {
+    m_fds.fill(-1);
+#if defined(__linux__)
+    for (int e = 0; e < EventCount; ++e) {
+        m_fds[e] = open_counter(static_cast<Event>(e));
+    }
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#if defined(__linux__)
+    for (int fd : m_fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+#endif
+}
+
+bool PerfCounters::available() const {
+    for (int fd : m_fds) {
+        if (fd >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PerfCounters::start() {
+#if defined(__linux__)
+    for (int fd : m_fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+void PerfCounters::stop() {
+#if defined(__linux__)
+    for (int fd : m_fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+#endif
+}
+
+PerfCounters::Values PerfCounters::read() const {
+    Values result;
+#if defined(__linux__)
+    for (int e = 0; e < EventCount; ++e) {
+        if (m_fds[e] < 0) {
+            continue;
+        }
+        // value, time_enabled, time_running
+        uint64_t data[3] = {0, 0, 0};
+        if (::read(m_fds[e], data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) {
+            continue;
+        }
+        // Если событий больше, чем физических счетчиков, ядро их мультиплексирует:
+        // экстраполируем на полное время
+        uint64_t value = data[0];
+        if (data[2] > 0 && data[2] < data[1]) {
+            value = static_cast<uint64_t>(static_cast<double>(value) * data[1] / data[2]);
+        }
+        result.value[e] = value;
+        result.valid[e] = data[2] > 0 || data[0] > 0;
+    }
+#endif
+    return result;
+}
+
+const char* PerfCounters::event_name(Event event) {
+    switch (event) {
+        case Cycles:
+            return "cycles";
+        case Instructions:
+            return "instructions";
+        case L1DMisses:
+            return "l1d_misses";
+        case LLCMisses:
+            return "llc_misses";
+        case BranchMisses:
+            return "branch_misses";
+        case EventCount:
+            break;
+    }
+    return "unknown";
+}
@@ -0,0 +1,419 @@
+#include "process_shard.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+#if defined(__linux__)
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <fcntl.h>
+#include <new>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+
+namespace {
+
+constexpr size_t kPageSize = 4096;
+
+// Период проверки рабочих, пока координатор ждет конца кадра
+constexpr long kLivenessPollNs = 20 * 1000 * 1000;
+
+std::atomic<unsigned> g_segment_counter{0};
+
+std::runtime_error system_error(const char* what) {
+    return std::runtime_error(std::string("ProcessShardConvolver: ") + what + ": " + std::strerror(errno));
+}
+
+}  // namespace
+
+/**
+ * @brief Управляющий блок в анонимной MAP_SHARED-памяти (наследуется при fork).
+ * За ним лежат 2 * workers полос RowRange (полосы свертки, затем полосы границ)
+ * и workers семафоров запуска, по одному на рабочего.
+ */
+struct ProcessShardConvolver::Control {
+    sem_t done;                ///< Каждый рабочий поднимает один раз за кадр
+    size_t workers = 0;
+    int halo = 0;              ///< kH / 2
+    int stop = 0;
+
+    // Параметры кадра (пишет координатор до start)
+    int w = 0;
+    int h = 0;
+    int convolve_strips = 0;
+    int border_strips = 0;
+
+    // Текущий сегмент данных: рабочий переотображает его, когда меняется generation
+    uint64_t generation = 0;
+    size_t half_capacity = 0;
+    char segment_name[64] = {};
+
+    std::atomic<int> failed{0};   ///< Рабочий не смог отобразить сегмент
+
+    RowRange* strips() { return reinterpret_cast<RowRange*>(this + 1); }
+    /// Координатор выложил кадр (или stop) для рабочего index
+    sem_t* start(size_t index) { return reinterpret_cast<sem_t*>(strips() + 2 * workers) + index; }
+
+    static size_t bytes(size_t workers) { return sizeof(Control) + 2 * workers * sizeof(RowRange) + workers * sizeof(sem_t); }
+};
+
+ProcessShardConvolver::ProcessShardConvolver(const std::vector<float>& kernel, int kW, int kH, size_t num_workers)
+    : m_convolver(kernel, kW, kH)
+{
+    if (num_workers == 0) {
+        num_workers = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    m_control_size = Control::bytes(num_workers);
+    void* p = mmap(nullptr, m_control_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        throw system_error("mmap control block");
+    }
+    m_control = new (p) Control();
+    m_control->workers = num_workers;
+    m_control->halo = kH / 2;
+
+    // Семафоры вместо процессного барьера: ожидание с таймаутом позволяет заметить
+    // умершего рабочего (барьер ждал бы его вечно)
+    if (sem_init(&m_control->done, 1, 0) != 0) {
+        int err = errno;
+        destroy_control(0, false);
+        errno = err;
+        throw system_error("sem_init");
+    }
+    for (size_t i = 0; i < num_workers; ++i) {
+        if (sem_init(m_control->start(i), 1, 0) != 0) {
+            int err = errno;
+            destroy_control(i, true);
+            errno = err;
+            throw system_error("sem_init");
+        }
+    }
+
+    // После fork в рабочем процессе живет только вызвавший поток, поэтому
+    // рабочий не выделяет память: все, что ему нужно, подготовлено здесь
+    m_workers.reserve(num_workers);
+    const pid_t parent = getpid();
+    for (size_t i = 0; i < num_workers; ++i) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            if (getppid() != parent) {
+                _exit(0);
+            }
+            worker_main(m_control, m_convolver, i);
+            _exit(0);
+        }
+        if (pid < 0) {
+            int err = errno;
+            // Барьер рассчитан на всех рабочих: уже запущенных не дождаться штатно
+            kill_workers();
+            destroy_control(num_workers, true);
+            errno = err;
+            throw system_error("fork");
+        }
+        m_workers.push_back(pid);
+    }
+}
+
+ProcessShardConvolver::~ProcessShardConvolver() {
+    stop_workers();
+    unmap_segment();
+    unlink_segment();
+    destroy_control(m_control->workers, true);
+}
+
+void ProcessShardConvolver::destroy_control(size_t start_semaphores, bool done_semaphore) {
+    for (size_t i = 0; i < start_semaphores; ++i) {
+        sem_destroy(m_control->start(i));
+    }
+    if (done_semaphore) {
+        sem_destroy(&m_control->done);
+    }
+    m_control->~Control();
+    munmap(m_control, m_control_size);
+    m_control = nullptr;
+}
+
+void ProcessShardConvolver::stop_workers() {
+    // Рабочие ждут только свой семафор запуска, поэтому остановка не зависит
+    // от того, живы ли остальные
+    m_control->stop = 1;
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        sem_post(m_control->start(i));
+    }
+    for (int worker : m_workers) {
+        while (waitpid(worker, nullptr, 0) < 0 && errno == EINTR) {
+        }
+    }
+    m_workers.clear();
+}
+
+void ProcessShardConvolver::kill_workers() {
+    for (int worker : m_workers) {
+        kill(worker, SIGKILL);
+    }
+    for (int worker : m_workers) {
+        while (waitpid(worker, nullptr, 0) < 0 && errno == EINTR) {
+        }
+    }
+    m_workers.clear();
+}
+
+std::string ProcessShardConvolver::find_exited_worker() {
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        int status = 0;
+        pid_t rc = waitpid(m_workers[i], &status, WNOHANG);
+        if (rc == 0 || (rc < 0 && errno == EINTR)) {
+            continue;
+        }
+        // Процесс уже собран (ECHILD, например при SIGCHLD = SIG_IGN) - тоже мертв
+        m_workers.erase(m_workers.begin() + static_cast<std::ptrdiff_t>(i));
+        std::string reason = "worker " + std::to_string(i) + " exited";
+        if (rc > 0 && WIFSIGNALED(status)) {
+            reason += " (signal " + std::to_string(WTERMSIG(status)) + ")";
+        } else if (rc > 0 && WIFEXITED(status)) {
+            reason += " (status " + std::to_string(WEXITSTATUS(status)) + ")";
+        }
+        return reason;
+    }
+    return {};
+}
+
+void ProcessShardConvolver::wait_frame_done() {
+    size_t finished = 0;
+    while (finished < m_control->workers) {
+        timespec deadline{};
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += kLivenessPollNs;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        if (sem_timedwait(&m_control->done, &deadline) == 0) {
+            ++finished;
+            continue;
+        }
+        if (errno != ETIMEDOUT && errno != EINTR) {
+            throw system_error("sem_timedwait");
+        }
+        // Кадр затянулся: жив ли каждый рабочий? Полоса умершего не будет посчитана никогда
+        std::string exited = find_exited_worker();
+        if (!exited.empty()) {
+            // Остальные могут еще писать в выход: объект дальше непригоден
+            kill_workers();
+            m_broken = true;
+            throw std::runtime_error("ProcessShardConvolver: " + exited);
+        }
+    }
+}
+
+void ProcessShardConvolver::worker_main(Control* control, ImageConvolver& convolver, size_t index) {
+    const RowRange* strips = control->strips();
+    uint64_t generation = 0;
+    unsigned char* segment = nullptr;
+    size_t segment_size = 0;
+
+    while (true) {
+        while (sem_wait(control->start(index)) != 0 && errno == EINTR) {
+        }
+        if (control->stop) {
+            break;
+        }
+
+        if (control->generation != generation) {
+            if (segment) {
+                munmap(segment, segment_size);
+                segment = nullptr;
+            }
+            segment_size = control->half_capacity * 2;
+            int fd = shm_open(control->segment_name, O_RDWR, 0);
+            if (fd >= 0) {
+                void* p = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                close(fd);
+                if (p != MAP_FAILED) {
+                    segment = static_cast<unsigned char*>(p);
+                    generation = control->generation;
+                }
+            }
+        }
+
+        if (!segment) {
+            control->failed.store(1, std::memory_order_relaxed);
+        } else {
+            const int w = control->w;
+            const int h = control->h;
+            const unsigned char* in = segment;
+            unsigned char* out = segment + control->half_capacity;
+
+            // Полоса свертки: ореол по kH/2 строк сверху и снизу читается прямо из общего входа
+            if (static_cast<int>(index) < control->convolve_strips) {
+                const RowRange rows = strips[index];
+                convolver.process_region(in, w, h, out, 0, rows.begin, w, rows.end);
+            }
+            // Верхние и нижние строки границы, попавшие в полосу этого рабочего
+            if (static_cast<int>(index) < control->border_strips) {
+                const RowRange rows = strips[control->workers + index];
+                const size_t rowBytes = static_cast<size_t>(w) * 4;
+                for (int y = rows.begin; y < rows.end; ++y) {
+                    if (y < control->halo || y >= h - control->halo) {
+                        std::memcpy(out + y * rowBytes, in + y * rowBytes, rowBytes);
+                    }
+                }
+            }
+        }
+
+        sem_post(&control->done);
+    }
+
+    if (segment) {
+        munmap(segment, segment_size);
+    }
+}
+
+void ProcessShardConvolver::map_segment(size_t half_capacity) {
+    char name[64];
+    std::snprintf(name, sizeof(name), "/blur_shard_%d_%u", static_cast<int>(getpid()),
+                  g_segment_counter.fetch_add(1, std::memory_order_relaxed));
+
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        throw system_error("shm_open");
+    }
+    const size_t size = half_capacity * 2;
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        int err = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = err;
+        throw system_error("ftruncate");
+    }
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (p == MAP_FAILED) {
+        shm_unlink(name);
+        errno = err;
+        throw system_error("mmap segment");
+    }
+
+    m_segment = static_cast<unsigned char*>(p);
+    m_segment_size = size;
+    m_segment_name = name;
+    m_segment_linked = true;
+    m_segment_failed = false;
+
+    std::memcpy(m_control->segment_name, name, sizeof(name));
+    m_control->half_capacity = half_capacity;
+    ++m_control->generation;
+}
+
+void ProcessShardConvolver::unmap_segment() {
+    if (m_segment) {
+        munmap(m_segment, m_segment_size);
+        m_segment = nullptr;
+        m_segment_size = 0;
+    }
+}
+
+void ProcessShardConvolver::unlink_segment() {
+    if (m_segment_linked) {
+        shm_unlink(m_segment_name.c_str());
+        m_segment_linked = false;
+    }
+}
+
+unsigned char* ProcessShardConvolver::input_buffer(int w, int h) {
+    if (w < 0 || h < 0) {
+        throw std::invalid_argument("ProcessShardConvolver: negative image size");
+    }
+    const size_t bytes = static_cast<size_t>(w) * h * 4;
+    if (!m_segment || m_segment_failed || bytes > m_control->half_capacity) {
+        unmap_segment();
+        unlink_segment();
+        map_segment(std::max((bytes + kPageSize - 1) / kPageSize * kPageSize, kPageSize));
+    }
+    m_w = w;
+    m_h = h;
+    return m_segment;
+}
+
+const unsigned char* ProcessShardConvolver::run() {
+    if (m_broken) {
+        throw std::runtime_error("ProcessShardConvolver: worker processes are gone after a failed run");
+    }
+    if (!m_segment) {
+        throw std::runtime_error("ProcessShardConvolver: input_buffer() was not called");
+    }
+
+    // Те же полосы, что у process_thread_pool: свертка по внутренним строкам, границы по всем
+    const size_t workers = m_control->workers;
+    std::vector<RowRange> convolve = ImageConvolver::split_rows(m_control->halo, m_h - m_control->halo, workers);
+    std::vector<RowRange> border = ImageConvolver::split_rows(0, m_h, workers);
+    RowRange* strips = m_control->strips();
+    std::copy(convolve.begin(), convolve.end(), strips);
+    std::copy(border.begin(), border.end(), strips + workers);
+
+    m_control->w = m_w;
+    m_control->h = m_h;
+    m_control->convolve_strips = static_cast<int>(convolve.size());
+    m_control->border_strips = static_cast<int>(border.size());
+    m_control->failed.store(0, std::memory_order_relaxed);
+
+    for (size_t i = 0; i < workers; ++i) {
+        sem_post(m_control->start(i));
+    }
+    wait_frame_done();
+
+    if (m_control->failed.load(std::memory_order_relaxed)) {
+        // Имя не удаляется: не отобразившие сегмент рабочие повторят попытку в следующем
+        // run(). Если имени уже нет (удалено извне), повтор бесполезен, поэтому следующий
+        // input_buffer() создает новый сегмент
+        m_segment_failed = true;
+        throw std::runtime_error("ProcessShardConvolver: worker failed to map shared segment");
+    }
+    // Все рабочие отобразили сегмент: имя больше не нужно
+    unlink_segment();
+    return m_segment + m_control->half_capacity;
+}
+
+#else
+
+struct ProcessShardConvolver::Control {};
+
+ProcessShardConvolver::ProcessShardConvolver(const std::vector<float>& kernel, int kW, int kH, size_t)
+    : m_convolver(kernel, kW, kH)
+{
+    throw std::runtime_error("ProcessShardConvolver: POSIX shared memory is not supported on this platform");
+}
+
+ProcessShardConvolver::~ProcessShardConvolver() = default;
+
+unsigned char* ProcessShardConvolver::input_buffer(int, int) {
+    return nullptr;
+}
+
+const unsigned char* ProcessShardConvolver::run() {
+    return nullptr;
+}
+
+#endif
+
+std::vector<unsigned char> ProcessShardConvolver::process(const unsigned char* img_in, int w, int h) {
+    if (!img_in) return {};
+
+    const size_t bytes = static_cast<size_t>(w) * h * 4;
+    std::memcpy(input_buffer(w, h), img_in, bytes);
+    const unsigned char* out = run();
+    return std::vector<unsigned char>(out, out + bytes);
+}
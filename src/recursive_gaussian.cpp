@@ -0,0 +1,248 @@
+#include "recursive_gaussian.h"
+#include "image_convolver.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+#include <stdexcept>
+
+namespace {
+
+// Пиксель n из 4 строк: 16 float [R0 G0 B0 A0 | R1 ... | R3 G3 B3 A3]
+inline __m512 load_px_4rows(const unsigned char* const rows[4], int n) {
+    uint32_t px[4];
+    for (int k = 0; k < 4; ++k) {
+        std::memcpy(&px[k], rows[k] + static_cast<size_t>(n) * 4, 4);
+    }
+    __m128i packed = _mm_set_epi32(static_cast<int>(px[3]), static_cast<int>(px[2]),
+                                   static_cast<int>(px[1]), static_cast<int>(px[0]));
+    return _mm512_cvtepi32_ps(_mm512_cvtepu8_epi32(packed));
+}
+
+}  // namespace
+
+RecursiveGaussian::RecursiveGaussian(float sigma)
+    : m_sigma(sigma)
+{
+    // Формула q Young - van Vliet выведена для sigma >= 0.5: ниже q < 0, a1 < 0 и B > 1,
+    // и фильтр вместо размытия повышает резкость
+    if (!(sigma >= kMinSigma)) {
+        throw std::invalid_argument("RecursiveGaussian: sigma must be at least 0.5");
+    }
+
+    // Young, van Vliet (1995): q по сигме, затем коэффициенты полинома 3-го порядка
+    const double s = sigma;
+    const double q = (s >= 2.5) ? 0.98711 * s - 0.96330 : 3.97156 - 4.14554 * std::sqrt(1.0 - 0.26891 * s);
+    const double q2 = q * q;
+    const double q3 = q2 * q;
+    const double b0 = 1.57825 + 2.44413 * q + 1.4281 * q2 + 0.422205 * q3;
+    const double b1 = 2.44413 * q + 2.85619 * q2 + 1.26661 * q3;
+    const double b2 = -(1.4281 * q2 + 1.26661 * q3);
+    const double b3 = 0.422205 * q3;
+
+    m_a1 = static_cast<float>(b1 / b0);
+    m_a2 = static_cast<float>(b2 / b0);
+    m_a3 = static_cast<float>(b3 / b0);
+    m_B = static_cast<float>(1.0 - (b1 + b2 + b3) / b0);
+
+    // Triggs, Sdika (2006): начальное состояние обратного прохода для края,
+    // продолженного повтором последнего пикселя u. Отклонение прямого прохода
+    // d = (w[N-1] - u, w[N-2] - u, w[N-3] - u) затухает линейно, поэтому
+    // (y[N], y[N+1], y[N+2]) = u + M * d. Столбцы M получаем, прогоняя единичные
+    // отклонения через продолжение прямого и затем обратного фильтра.
+    const double a[3] = {b1 / b0, b2 / b0, b3 / b0};
+    const double gain = 1.0 - (a[0] + a[1] + a[2]);
+    const int tail = static_cast<int>(std::ceil(10.0 * s)) + 64;
+    std::vector<double> fwd(tail + 3);
+    std::vector<double> bwd(tail + 3, 0.0);
+    for (int j = 0; j < 3; ++j) {
+        // fwd[k + 2] = отклонение w[N - 1 + k]; fwd[0..2] = w[N-3], w[N-2], w[N-1]
+        fwd[0] = (j == 2) ? 1.0 : 0.0;
+        fwd[1] = (j == 1) ? 1.0 : 0.0;
+        fwd[2] = (j == 0) ? 1.0 : 0.0;
+        for (int k = 3; k < tail + 3; ++k) {
+            fwd[k] = a[0] * fwd[k - 1] + a[1] * fwd[k - 2] + a[2] * fwd[k - 3];
+        }
+        std::fill(bwd.begin(), bwd.end(), 0.0);
+        for (int k = tail + 2; k >= 3; --k) {
+            const double y1 = (k + 1 < tail + 3) ? bwd[k + 1] : 0.0;
+            const double y2 = (k + 2 < tail + 3) ? bwd[k + 2] : 0.0;
+            const double y3 = (k + 3 < tail + 3) ? bwd[k + 3] : 0.0;
+            bwd[k] = gain * fwd[k] + a[0] * y1 + a[1] * y2 + a[2] * y3;
+        }
+        // bwd[3] = y[N], bwd[4] = y[N+1], bwd[5] = y[N+2]
+        for (int i = 0; i < 3; ++i) {
+            m_edge[i][j] = static_cast<float>(bwd[3 + i]);
+        }
+    }
+}
+
+std::vector<unsigned char> RecursiveGaussian::process(const unsigned char* img_in, int w, int h) {
+    if (!img_in) return {};
+
+    TraceScope trace("recursive_gaussian", "RecursiveGaussian", "w", w, "h", h);
+    std::vector<unsigned char> img_out(static_cast<size_t>(w) * h * 4);
+    if (w <= 0 || h <= 0) return img_out;
+
+    std::vector<float> tmp(static_cast<size_t>(w) * h * 4);
+    horizontal_rows(img_in, w, h, tmp.data(), 0, h);
+    vertical_columns(img_in, w, h, tmp.data(), img_out.data(), 0, (w + 3) / 4);
+    return img_out;
+}
+
+std::vector<unsigned char> RecursiveGaussian::process_thread_pool(const unsigned char* img_in, int w, int h,
+                                                                  size_t num_threads) {
+    if (!img_in) return {};
+
+    ThreadPool pool(num_threads);
+    return process_thread_pool(pool, img_in, w, h);
+}
+
+std::vector<unsigned char> RecursiveGaussian::process_thread_pool(ThreadPool& pool, const unsigned char* img_in,
+                                                                  int w, int h) {
+    if (!img_in) return {};
+
+    TraceScope trace("recursive_gaussian_thread_pool", "RecursiveGaussian", "w", w, "h", h);
+    std::vector<unsigned char> img_out(static_cast<size_t>(w) * h * 4);
+    if (w <= 0 || h <= 0) return img_out;
+
+    std::vector<float> tmp(static_cast<size_t>(w) * h * 4);
+    float* tmpData = tmp.data();
+    const size_t threads = pool.get_thread_count();
+
+    TaskGroup group(pool);
+    for (const RowRange& rows : ImageConvolver::split_rows(0, h, threads)) {
+        group.run([=]() {
+            TraceScope band("iir_rows", "RecursiveGaussian", "y0", rows.begin, "y1", rows.end);
+            horizontal_rows(img_in, w, h, tmpData, rows.begin, rows.end);
+        });
+    }
+    group.wait();
+
+    // Проход по столбцам начинается только после всех строк
+    unsigned char* out = img_out.data();
+    for (const RowRange& groups : ImageConvolver::split_rows(0, (w + 3) / 4, threads)) {
+        group.run([=]() {
+            TraceScope band("iir_columns", "RecursiveGaussian", "g0", groups.begin, "g1", groups.end);
+            vertical_columns(img_in, w, h, tmpData, out, groups.begin, groups.end);
+        });
+    }
+    group.wait();
+    return img_out;
+}
+
+void RecursiveGaussian::edge_state(__m512 last, __m512 w1, __m512 w2, __m512 w3,
+                                   __m512& y1, __m512& y2, __m512& y3) const {
+    const __m512 d0 = _mm512_sub_ps(w1, last);
+    const __m512 d1 = _mm512_sub_ps(w2, last);
+    const __m512 d2 = _mm512_sub_ps(w3, last);
+    __m512* out[3] = {&y1, &y2, &y3};
+    for (int i = 0; i < 3; ++i) {
+        *out[i] = _mm512_fmadd_ps(_mm512_set1_ps(m_edge[i][2]), d2,
+                      _mm512_fmadd_ps(_mm512_set1_ps(m_edge[i][1]), d1,
+                          _mm512_fmadd_ps(_mm512_set1_ps(m_edge[i][0]), d0, last)));
+    }
+}
+
+void RecursiveGaussian::horizontal_rows(const unsigned char* img_in, int w, int, float* tmp,
+                                        int y0, int y1) const {
+    const __m512 B = _mm512_set1_ps(m_B);
+    const __m512 a1 = _mm512_set1_ps(m_a1);
+    const __m512 a2 = _mm512_set1_ps(m_a2);
+    const __m512 a3 = _mm512_set1_ps(m_a3);
+
+    // Результаты прямого прохода 4 строк: по zmm на пиксель
+    std::vector<float> line(static_cast<size_t>(w) * 16);
+
+    for (int y = y0; y < y1; y += 4) {
+        const int count = std::min(4, y1 - y);
+        // Недостающие строки последней группы дублируют последнюю (результат не пишется)
+        const unsigned char* rows[4];
+        for (int k = 0; k < 4; ++k) {
+            rows[k] = img_in + static_cast<size_t>(y + std::min(k, count - 1)) * w * 4;
+        }
+
+        // --- Прямой проход, край продолжается повтором первого пикселя
+        const __m512 last = load_px_4rows(rows, w - 1);
+        __m512 w1 = load_px_4rows(rows, 0);
+        __m512 w2 = w1;
+        __m512 w3 = w1;
+        for (int n = 0; n < w; ++n) {
+            __m512 x = load_px_4rows(rows, n);
+            __m512 v = _mm512_fmadd_ps(a3, w3, _mm512_fmadd_ps(a2, w2, _mm512_fmadd_ps(a1, w1, _mm512_mul_ps(B, x))));
+            _mm512_storeu_ps(line.data() + static_cast<size_t>(n) * 16, v);
+            w3 = w2;
+            w2 = w1;
+            w1 = v;
+        }
+
+        // --- Обратный проход от состояния Triggs - Sdika на правом краю
+        __m512 y1v, y2v, y3v;
+        edge_state(last, w1, w2, w3, y1v, y2v, y3v);
+        for (int n = w - 1; n >= 0; --n) {
+            __m512 x = _mm512_loadu_ps(line.data() + static_cast<size_t>(n) * 16);
+            __m512 v = _mm512_fmadd_ps(a3, y3v, _mm512_fmadd_ps(a2, y2v, _mm512_fmadd_ps(a1, y1v, _mm512_mul_ps(B, x))));
+            y3v = y2v;
+            y2v = y1v;
+            y1v = v;
+
+            float* dst = tmp + (static_cast<size_t>(y) * w + n) * 4;
+            const size_t rowStride = static_cast<size_t>(w) * 4;
+            _mm_storeu_ps(dst, _mm512_extractf32x4_ps(v, 0));
+            if (count > 1) _mm_storeu_ps(dst + rowStride, _mm512_extractf32x4_ps(v, 1));
+            if (count > 2) _mm_storeu_ps(dst + 2 * rowStride, _mm512_extractf32x4_ps(v, 2));
+            if (count > 3) _mm_storeu_ps(dst + 3 * rowStride, _mm512_extractf32x4_ps(v, 3));
+        }
+    }
+}
+
+void RecursiveGaussian::vertical_columns(const unsigned char* img_in, int w, int h, float* tmp,
+                                         unsigned char* img_out, int g0, int g1) const {
+    const __m512 B = _mm512_set1_ps(m_B);
+    const __m512 a1 = _mm512_set1_ps(m_a1);
+    const __m512 a2 = _mm512_set1_ps(m_a2);
+    const __m512 a3 = _mm512_set1_ps(m_a3);
+    const size_t stride = static_cast<size_t>(w) * 4;
+
+    for (int g = g0; g < g1; ++g) {
+        const int x = g * 4;
+        const int count = std::min(4, w - x);
+        // Последняя группа может быть неполной: маска на 4 * count float / байт
+        const __mmask16 mask = static_cast<__mmask16>((1u << (4 * count)) - 1);
+        float* column = tmp + static_cast<size_t>(x) * 4;
+
+        // --- Прямой проход сверху вниз (на месте)
+        const __m512 last = _mm512_maskz_loadu_ps(mask, column + (h - 1) * stride);
+        __m512 w1 = _mm512_maskz_loadu_ps(mask, column);
+        __m512 w2 = w1;
+        __m512 w3 = w1;
+        for (int y = 0; y < h; ++y) {
+            float* p = column + y * stride;
+            __m512 v = _mm512_fmadd_ps(a3, w3, _mm512_fmadd_ps(a2, w2,
+                           _mm512_fmadd_ps(a1, w1, _mm512_mul_ps(B, _mm512_maskz_loadu_ps(mask, p)))));
+            _mm512_mask_storeu_ps(p, mask, v);
+            w3 = w2;
+            w2 = w1;
+            w1 = v;
+        }
+
+        // --- Обратный проход снизу вверх, сразу в u8
+        __m512 y1v, y2v, y3v;
+        edge_state(last, w1, w2, w3, y1v, y2v, y3v);
+        for (int y = h - 1; y >= 0; --y) {
+            __m512 v = _mm512_fmadd_ps(a3, y3v, _mm512_fmadd_ps(a2, y2v,
+                           _mm512_fmadd_ps(a1, y1v, _mm512_mul_ps(B, _mm512_maskz_loadu_ps(mask, column + y * stride)))));
+            y3v = y2v;
+            y2v = y1v;
+            y1v = v;
+
+            const size_t idx = y * stride + static_cast<size_t>(x) * 4;
+            __m128i res8 = _mm512_cvtusepi32_epi8(_mm512_cvttps_epi32(_mm512_max_ps(v, _mm512_setzero_ps())));
+            _mm_mask_storeu_epi8(img_out + idx, mask, res8);
+            for (int k = 0; k < count; ++k) {
+                img_out[idx + k * 4 + 3] = img_in[idx + k * 4 + 3];
+            }
+        }
+    }
+}
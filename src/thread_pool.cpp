@@ -1,4 +1,6 @@
 #include "thread_pool.h"
+#include "trace.h"
+#include <algorithm>
 #include <iostream>
 
 ThreadPool::ThreadPool(size_t num_threads) : m_stop(false) {
@@ -14,7 +16,7 @@ ThreadPool::ThreadPool(size_t num_threads) : m_stop(false) {
     // Создаем рабочие потоки
     m_workers.reserve(num_threads);
     for (size_t i = 0; i < num_threads; ++i) {
-        m_workers.emplace_back(&ThreadPool::worker_thread, this);
+        m_workers.emplace_back(&ThreadPool::worker_thread, this, i);
     }
 }
 
@@ -38,7 +40,71 @@ void ThreadPool::stop_all_threads() {
     m_condition.notify_all();
 }
 
-void ThreadPool::worker_thread() {
+void ThreadPool::enqueue_task(std::function<void()> func, TaskPriority priority, Clock::time_point deadline) {
+    Task task(std::move(func));
+    task.deadline = deadline;
+    task.priority = priority;
+    if (Trace::enabled()) {
+        task.enqueue_ns = Trace::now_ns();
+        task.flow_id = Trace::next_flow_id();
+        Trace::flow_begin("task", task.flow_id, task.enqueue_ns);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_queue_mutex);
+        if (m_stop) {
+            throw std::runtime_error("Cannot dispatch task: ThreadPool is stopped");
+        }
+        task.seq = m_next_seq++;
+        std::vector<Task>& queue = m_tasks[static_cast<size_t>(priority)];
+        queue.push_back(std::move(task));
+        std::push_heap(queue.begin(), queue.end(), TaskLater{});
+    }
+
+    m_condition.notify_one();
+}
+
+ThreadPool::Task ThreadPool::pop_task() {
+    // Класс, исчерпавший квоту пропусков, обслуживается вне очереди (более высокий первым);
+    // иначе строгий приоритет
+    size_t chosen = kPriorityCount;
+    for (size_t c = 1; c < kPriorityCount; ++c) {
+        if (!m_tasks[c].empty() && m_skipped[c] >= kStarvationQuota) {
+            chosen = c;
+            break;
+        }
+    }
+    if (chosen == kPriorityCount) {
+        chosen = 0;
+        while (m_tasks[chosen].empty()) {
+            ++chosen;
+        }
+    }
+
+    m_skipped[chosen] = 0;
+    for (size_t c = chosen + 1; c < kPriorityCount; ++c) {
+        if (!m_tasks[c].empty()) {
+            ++m_skipped[c];
+        }
+    }
+
+    std::vector<Task>& queue = m_tasks[chosen];
+    std::pop_heap(queue.begin(), queue.end(), TaskLater{});
+    Task task = std::move(queue.back());
+    queue.pop_back();
+    return task;
+}
+
+size_t ThreadPool::queued_tasks() const {
+    size_t total = 0;
+    for (const std::vector<Task>& queue : m_tasks) {
+        total += queue.size();
+    }
+    return total;
+}
+
+void ThreadPool::worker_thread(size_t index) {
+    Trace::set_thread_name("ThreadPool worker " + std::to_string(index));
     while (true) {
         Task task;
 
@@ -48,24 +114,102 @@ void ThreadPool::worker_thread() {
 
             // Ожидаем задачу или сигнал остановки
             m_condition.wait(lock, [this]() {
-                return m_stop || !m_tasks.empty();
+                return m_stop || queued_tasks() != 0;
             });
 
             // Если пул остановлен и задач нет, выходим
-            if (m_stop && m_tasks.empty()) {
+            if (m_stop && queued_tasks() == 0) {
                 return;
             }
 
-            // Извлекаем задачу из очереди
-            if (!m_tasks.empty()) {
-                task = std::move(m_tasks.front());
-                m_tasks.pop();
+            // Извлекаем задачу самого высокого класса с учетом квоты
+            if (queued_tasks() != 0) {
+                task = pop_task();
             }
         }
 
         // Выполняем задачу вне критической секции
-        if (task.func) {
-            task.func();
+        execute(task);
+    }
+}
+
+void ThreadPool::execute(Task& task) {
+    if (!task.func) {
+        return;
+    }
+    if (task.enqueue_ns == 0 || !Trace::enabled()) {
+        task.func();
+        return;
+    }
+
+    uint64_t start = Trace::now_ns();
+    Trace::flow_end("task", task.flow_id, start);
+    task.func();
+    // Время ожидания в очереди по классам - основной показатель для подбора квоты
+    Trace::complete("task", "ThreadPool", start, Trace::now_ns(),
+                    "queue_wait_us", static_cast<int64_t>((start - task.enqueue_ns) / 1000),
+                    "priority", static_cast<int64_t>(task.priority));
+}
+
+TaskGroup::~TaskGroup() {
+    help_until_done();
+}
+
+void TaskGroup::wait() {
+    help_until_done();
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(m_state->mutex);
+        std::swap(error, m_state->error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+bool TaskGroup::run_one(State& state) {
+    std::function<void()> func;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.queue.empty()) {
+            return false;
+        }
+        func = std::move(state.queue.front());
+        state.queue.pop_front();
+    }
+
+    std::exception_ptr error;
+    try {
+        func();
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // Уведомление под мьютексом: ожидающий не разрушит группу между декрементом
+    // и notify (State после разрушения группы держат только билеты)
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (error && !state.error) {
+        state.error = error;
+    }
+    if (--state.pending == 0) {
+        state.changed.notify_all();
+    }
+    return true;
+}
+
+void TaskGroup::help_until_done() {
+    State& state = *m_state;
+    while (true) {
+        // Только задачи своей группы: чужие (в том числе более низкого приоритета)
+        // остаются рабочим потокам
+        if (run_one(state)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(state.mutex);
+        state.changed.wait(lock, [&state]() { return state.pending == 0 || !state.queue.empty(); });
+        if (state.pending == 0) {
+            return;
         }
     }
 }
@@ -76,5 +220,5 @@ size_t ThreadPool::get_thread_count() const {
 
 size_t ThreadPool::get_queue_size() const {
     std::unique_lock<std::mutex> lock(m_queue_mutex);
-    return m_tasks.size();
+    return queued_tasks();
 }
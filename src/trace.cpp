@@ -0,0 +1,186 @@
+#include "trace.h"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    char phase;            ///< 'X' - интервал, 's'/'f' - стрелка
+    uint64_t ts_ns;
+    uint64_t dur_ns;
+    uint64_t id;           ///< Идентификатор стрелки
+    const char* arg_names[2];
+    int64_t args[2];
+};
+
+/**
+ * @brief Буфер событий одного потока. Пишет только поток-владелец.
+ */
+struct ThreadBuffer {
+    int tid = 0;
+    std::string name;
+    std::vector<TraceEvent> events;
+};
+
+/**
+ * @brief Реестр буферов всех потоков. Буферы живут дольше потоков
+ * (рабочие потоки пула завершаются до выгрузки трассы).
+ */
+struct Registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    int next_tid = 1;
+};
+
+Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+// Увеличивается в start(): буферы прошлой сессии больше не используются
+std::atomic<uint64_t> g_generation{1};
+std::atomic<uint64_t> g_next_flow_id{1};
+
+thread_local std::shared_ptr<ThreadBuffer> t_buffer;
+thread_local uint64_t t_generation = 0;
+// Имя потока живет дольше буфера: после start() буфер создается заново с тем же именем
+thread_local std::string t_name;
+
+ThreadBuffer& local_buffer() {
+    uint64_t generation = g_generation.load(std::memory_order_acquire);
+    if (!t_buffer || t_generation != generation) {
+        auto buffer = std::make_shared<ThreadBuffer>();
+        buffer->events.reserve(1024);
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        buffer->tid = reg.next_tid++;
+        buffer->name = t_name.empty() ? "thread " + std::to_string(buffer->tid) : t_name;
+        reg.buffers.push_back(buffer);
+        t_buffer = std::move(buffer);
+        t_generation = generation;
+    }
+    return *t_buffer;
+}
+
+const std::chrono::steady_clock::time_point g_epoch = std::chrono::steady_clock::now();
+
+void write_escaped(FILE* f, const std::string& s) {
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', f);
+        }
+        std::fputc(c, f);
+    }
+}
+
+}  // namespace
+
+void Trace::start() {
+    Registry& reg = registry();
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.buffers.clear();
+        reg.next_tid = 1;
+    }
+    // Потоки перерегистрируют буферы при следующей записи
+    g_generation.fetch_add(1, std::memory_order_acq_rel);
+    s_enabled.store(true, std::memory_order_release);
+}
+
+void Trace::stop() {
+    s_enabled.store(false, std::memory_order_release);
+}
+
+uint64_t Trace::now_ns() {
+    auto elapsed = std::chrono::steady_clock::now() - g_epoch;
+    // +1, чтобы 0 однозначно означал "время не снято"
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) + 1;
+}
+
+void Trace::complete(const char* name, const char* category, uint64_t start_ns, uint64_t end_ns,
+                     const char* arg0_name, int64_t arg0, const char* arg1_name, int64_t arg1) {
+    if (!enabled()) return;
+    TraceEvent ev{name, category, 'X', start_ns, end_ns > start_ns ? end_ns - start_ns : 0, 0,
+                  {arg0_name, arg1_name}, {arg0, arg1}};
+    local_buffer().events.push_back(ev);
+}
+
+uint64_t Trace::next_flow_id() {
+    return g_next_flow_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Trace::flow_begin(const char* name, uint64_t id, uint64_t ts_ns) {
+    if (!enabled()) return;
+    TraceEvent ev{name, "flow", 's', ts_ns, 0, id, {nullptr, nullptr}, {0, 0}};
+    local_buffer().events.push_back(ev);
+}
+
+void Trace::flow_end(const char* name, uint64_t id, uint64_t ts_ns) {
+    if (!enabled()) return;
+    TraceEvent ev{name, "flow", 'f', ts_ns, 0, id, {nullptr, nullptr}, {0, 0}};
+    local_buffer().events.push_back(ev);
+}
+
+void Trace::set_thread_name(const std::string& name) {
+    t_name = name;
+    if (!enabled()) return;
+    local_buffer().name = name;
+}
+
+bool Trace::write_json(const char* path) {
+    FILE* f = std::fopen(path, "w");
+    if (!f) return false;
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    std::fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    auto separator = [&]() {
+        if (!first) std::fprintf(f, ",\n");
+        first = false;
+    };
+
+    for (const auto& buffer : reg.buffers) {
+        separator();
+        std::fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"",
+                     buffer->tid);
+        write_escaped(f, buffer->name);
+        std::fprintf(f, "\"}}");
+
+        for (const TraceEvent& ev : buffer->events) {
+            separator();
+            // Chrome ожидает микросекунды; дробная часть сохраняет точность до нс
+            std::fprintf(f, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f",
+                         ev.name, ev.category, ev.phase, buffer->tid, ev.ts_ns / 1000.0);
+            if (ev.phase == 'X') {
+                std::fprintf(f, ",\"dur\":%.3f", ev.dur_ns / 1000.0);
+            } else {
+                std::fprintf(f, ",\"id\":%llu", static_cast<unsigned long long>(ev.id));
+                if (ev.phase == 'f') {
+                    std::fprintf(f, ",\"bp\":\"e\"");
+                }
+            }
+            if (ev.arg_names[0] || ev.arg_names[1]) {
+                std::fprintf(f, ",\"args\":{");
+                bool firstArg = true;
+                for (int i = 0; i < 2; ++i) {
+                    if (!ev.arg_names[i]) continue;
+                    std::fprintf(f, "%s\"%s\":%lld", firstArg ? "" : ",", ev.arg_names[i],
+                                 static_cast<long long>(ev.args[i]));
+                    firstArg = false;
+                }
+                std::fprintf(f, "}");
+            }
+            std::fprintf(f, "}");
+        }
+    }
+
+    std::fprintf(f, "\n]}\n");
+    return std::fclose(f) == 0;
+}
@@ -6,6 +6,7 @@
 
 #include "image_convolver.h"
 #include "stb_image.h"
+#include "trace.h"
 
 namespace {
 
@@ -76,7 +77,11 @@ bool process_and_save(ImageConvolver& convolver,
     int h = 0;
     int channels = 0;
 
-    unsigned char* img = convolver.loadImage(input_path.c_str(), w, h, channels);
+    unsigned char* img = nullptr;
+    {
+        TraceScope trace("load", "io");
+        img = convolver.loadImage(input_path.c_str(), w, h, channels);
+    }
     if (!img) {
         std::cerr << "Failed to load image: " << input_path << std::endl;
         return false;
@@ -90,6 +95,7 @@ bool process_and_save(ImageConvolver& convolver,
         return false;
     }
 
+    TraceScope trace("save", "io");
     if (!convolver.saveImage(output_path.c_str(), w, h, out.data())) {
         std::cerr << "Failed to save image: " << output_path << std::endl;
         return false;
@@ -103,6 +109,12 @@ bool process_and_save(ImageConvolver& convolver,
 
 int main(int argc, char** argv) {
     const std::string input_path = (argc > 1) ? argv[1] : "img.jpg";
+    // Второй аргумент: файл трассы (chrome://tracing или ui.perfetto.dev)
+    const std::string trace_path = (argc > 2) ? argv[2] : "";
+    if (!trace_path.empty()) {
+        Trace::start();
+        Trace::set_thread_name("main");
+    }
 
     const std::vector<float> kernel = gaussian_kernel_3x3();
     ImageConvolver convolver(kernel, 3, 3);
@@ -129,5 +141,15 @@ int main(int argc, char** argv) {
                                return c.process_thread_pool_full(img, w, h, 0);
                            });
 
+    if (!trace_path.empty()) {
+        Trace::stop();
+        if (Trace::write_json(trace_path.c_str())) {
+            std::cout << "Saved trace: " << trace_path << std::endl;
+        } else {
+            std::cerr << "Failed to save trace: " << trace_path << std::endl;
+            ok = false;
+        }
+    }
+
     return ok ? 0 : 1;
 }
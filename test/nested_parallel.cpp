@@ -0,0 +1,289 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "image_convolver.h"
+#include "thread_pool.h"
+
+// Вложенный параллелизм на ThreadPool: TaskGroup::wait и parallel_for выполняют задачи
+// своей группы, пока ждут, поэтому задачи пула могут ставить и ждать подзадачи на любой
+// глубине даже на пуле из одного потока. Взаимная блокировка ловится сторожевым
+// таймером. Там же проверяется порядок классов приоритета.
+// Код возврата 0 - все проверки прошли, 1 - есть ошибки.
+
+namespace {
+
+using Image = std::vector<unsigned char>;
+
+constexpr auto kWatchdog = std::chrono::seconds(60);
+
+// Дерево TaskGroup: каждый узел ставит fanout подзадач и ждет их
+void group_tree(ThreadPool& pool, int depth, int fanout, std::atomic<long>& leaves) {
+    if (depth == 0) {
+        leaves.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TaskGroup group(pool);
+    for (int i = 0; i < fanout; ++i) {
+        group.run([&pool, depth, fanout, &leaves]() { group_tree(pool, depth - 1, fanout, leaves); });
+    }
+    group.wait();
+}
+
+// То же через parallel_for: каждый элемент диапазона - поддерево
+void parallel_for_tree(ThreadPool& pool, int depth, int fanout, std::atomic<long>& leaves) {
+    if (depth == 0) {
+        leaves.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    pool.parallel_for(0, fanout, [&pool, depth, fanout, &leaves](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            parallel_for_tree(pool, depth - 1, fanout, leaves);
+        }
+    });
+}
+
+long expected_leaves(int depth, int fanout) {
+    long result = 1;
+    for (int i = 0; i < depth; ++i) {
+        result *= fanout;
+    }
+    return result;
+}
+
+Image random_image(int w, int h, unsigned seed) {
+    Image img(static_cast<size_t>(w) * static_cast<size_t>(h) * 4);
+    unsigned state = seed * 2654435761u + 1u;
+    for (unsigned char& v : img) {
+        state = state * 1664525u + 1013904223u;
+        v = static_cast<unsigned char>(state >> 24);
+    }
+    return img;
+}
+
+// Порядок выполнения на пуле из одного потока: рабочий поток занят задачей-затвором,
+// пока ставятся low_count задач Low, затем (через 150 мс) high_count задач High.
+// Возвращает последовательность классов в порядке выполнения.
+std::string priority_order(int low_count, int high_count) {
+    ThreadPool pool(1);
+    std::promise<void> gate;
+    std::promise<void> started;
+    std::shared_future<void> opened = gate.get_future().share();
+    std::future<void> blocker = pool.dispatch_task([opened, &started]() {
+        started.set_value();
+        opened.wait();
+    });
+    // Затвор должен быть взят до постановки остальных задач (иначе он учтется в квоте)
+    started.get_future().wait();
+
+    std::mutex order_mutex;
+    std::string order;
+    std::vector<std::future<void>> futures;
+    auto enqueue = [&](TaskPriority priority, char tag) {
+        futures.push_back(pool.dispatch_task([&order_mutex, &order, tag]() {
+            std::lock_guard<std::mutex> lock(order_mutex);
+            order.push_back(tag);
+        }, priority));
+    };
+    for (int i = 0; i < low_count; ++i) {
+        enqueue(TaskPriority::Low, 'L');
+    }
+    // Строки фонового задания успевают "постареть" дольше прежнего бюджета Low (100 мс)
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    for (int i = 0; i < high_count; ++i) {
+        enqueue(TaskPriority::High, 'H');
+    }
+
+    gate.set_value();
+    blocker.get();
+    for (auto& future : futures) {
+        future.get();
+    }
+    return order;
+}
+
+// Ожидание группы High, у которой не осталось не взятых задач (ее единственная задача
+// выполняется на втором рабочем), когда в очереди пула лежит задача Low другого клиента,
+// а первый рабочий занят. wait() выполняет только задачи своей группы, поэтому задачу Low
+// должен выполнить рабочий поток после освобождения, а не ожидающий поток.
+bool high_wait_skips_low_task() {
+    ThreadPool pool(2);
+    std::promise<void> gate;
+    std::promise<void> blocker_started;
+    std::shared_future<void> opened = gate.get_future().share();
+    std::future<void> blocker = pool.dispatch_task([opened, &blocker_started]() {
+        blocker_started.set_value();
+        opened.wait();
+    });
+    blocker_started.get_future().wait();
+
+    TaskGroup group(pool, TaskPriority::High);
+    std::promise<void> high_started;
+    group.run([&high_started]() {
+        high_started.set_value();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    });
+    high_started.get_future().wait();
+
+    std::thread::id low_thread;
+    std::future<void> low = pool.dispatch_task([&low_thread]() { low_thread = std::this_thread::get_id(); },
+                                               TaskPriority::Low);
+    group.wait();
+
+    gate.set_value();
+    blocker.get();
+    low.get();
+    return low_thread != std::this_thread::get_id();
+}
+
+int run_checks() {
+    int checks = 0;
+    int failures = 0;
+
+    // Ожидание группы не выполняет чужие задачи
+    ++checks;
+    if (!high_wait_skips_low_task()) {
+        std::cerr << "FAIL TaskGroup High wait ran a queued Low task of another client" << std::endl;
+        ++failures;
+    }
+
+    // Строгие классы: High обгоняет давно ждущие задачи Low
+    ++checks;
+    const std::string strict = priority_order(16, 3);
+    if (strict.compare(0, 3, "HHH") != 0) {
+        std::cerr << "FAIL High tasks did not overtake queued Low tasks: " << strict << std::endl;
+        ++failures;
+    }
+
+    // Квота: Low получает одну выборку после kStarvationQuota выборок High подряд
+    ++checks;
+    const int quota = static_cast<int>(ThreadPool::kStarvationQuota);
+    const std::string fair = priority_order(2, quota * 3);
+    if (fair.find('L') != static_cast<size_t>(quota) ||
+        fair.find('L', quota + 1) != static_cast<size_t>(quota * 2 + 1)) {
+        std::cerr << "FAIL Low class starved under High load: " << fair << std::endl;
+        ++failures;
+    }
+
+    for (size_t threads : {1, 2, 4}) {
+        ThreadPool pool(threads);
+
+        // Глубокая вложенность: 4^7 листьев, на каждом уровне все потоки ждут подзадачи
+        std::atomic<long> leaves{0};
+        group_tree(pool, 7, 4, leaves);
+        ++checks;
+        if (leaves.load() != expected_leaves(7, 4)) {
+            std::cerr << "FAIL TaskGroup tree, " << threads << " threads: " << leaves.load() << " leaves" << std::endl;
+            ++failures;
+        }
+
+        leaves = 0;
+        parallel_for_tree(pool, 6, 5, leaves);
+        ++checks;
+        if (leaves.load() != expected_leaves(6, 5)) {
+            std::cerr << "FAIL parallel_for tree, " << threads << " threads: " << leaves.load() << " leaves" << std::endl;
+            ++failures;
+        }
+
+        // Все рабочие потоки заняты задачами dispatch_task, каждая из которых ждет свою группу
+        std::vector<std::future<long>> outer;
+        for (size_t i = 0; i < threads * 2; ++i) {
+            outer.push_back(pool.dispatch_task([&pool]() {
+                std::atomic<long> inner{0};
+                group_tree(pool, 4, 3, inner);
+                return inner.load();
+            }));
+        }
+        for (auto& future : outer) {
+            ++checks;
+            if (future.get() != expected_leaves(4, 3)) {
+                std::cerr << "FAIL nested group inside dispatch_task, " << threads << " threads" << std::endl;
+                ++failures;
+            }
+        }
+
+        // Исключение вложенной задачи доходит до внешнего wait
+        ++checks;
+        try {
+            TaskGroup group(pool);
+            group.run([&pool]() {
+                TaskGroup inner(pool);
+                inner.run([]() { throw std::runtime_error("inner"); });
+                inner.wait();
+            });
+            group.wait();
+            std::cerr << "FAIL TaskGroup exception was not rethrown, " << threads << " threads" << std::endl;
+            ++failures;
+        } catch (const std::runtime_error& e) {
+            if (std::string(e.what()) != "inner") {
+                std::cerr << "FAIL TaskGroup rethrew '" << e.what() << "'" << std::endl;
+                ++failures;
+            }
+        }
+
+        // Внешний цикл по изображениям, внутренний - полосы строк того же пула
+        ImageConvolver convolver({0.f, -1.f, 0.f, -1.f, 5.f, -1.f, 0.f, -1.f, 0.f}, 3, 3);
+        std::vector<Image> images;
+        for (int i = 0; i < 6; ++i) {
+            images.push_back(random_image(37 + i, 29, static_cast<unsigned>(i + 1)));
+        }
+        std::vector<Image> results(images.size());
+        std::vector<Image> results_full(images.size());
+        std::vector<std::vector<PyramidLevel>> pyramids(images.size());
+        pool.parallel_for(0, static_cast<int>(images.size()), [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                results[i] = convolver.process_thread_pool(pool, images[i].data(), 37 + i, 29);
+                results_full[i] = convolver.process_thread_pool_full(pool, images[i].data(), 37 + i, 29);
+                pyramids[i] = convolver.build_pyramid(pool, images[i].data(), 37 + i, 29, 2);
+            }
+        });
+        for (size_t i = 0; i < images.size(); ++i) {
+            const int w = 37 + static_cast<int>(i);
+            const Image expected = convolver.process_default(images[i].data(), w, 29);
+            ++checks;
+            if (results[i] != expected || results_full[i] != expected) {
+                std::cerr << "FAIL nested process_thread_pool, image " << i << ", " << threads << " threads" << std::endl;
+                ++failures;
+            }
+
+            const std::vector<PyramidLevel> serial = convolver.build_pyramid(images[i].data(), w, 29, 2, 1);
+            bool same = pyramids[i].size() == serial.size() && !serial.empty();
+            for (size_t l = 0; same && l < serial.size(); ++l) {
+                same = pyramids[i][l].w == serial[l].w && pyramids[i][l].h == serial[l].h &&
+                       pyramids[i][l].data == serial[l].data;
+            }
+            ++checks;
+            if (!same) {
+                std::cerr << "FAIL nested build_pyramid, image " << i << ", " << threads << " threads" << std::endl;
+                ++failures;
+            }
+        }
+    }
+
+    std::cout << "Nested parallel checks: " << checks << ", failures: " << failures << std::endl;
+    return failures == 0 ? 0 : 1;
+}
+
+} // namespace
+
+int main() {
+    // Проверки в отдельном потоке: при взаимной блокировке пул нельзя разрушить,
+    // поэтому по таймеру процесс завершается сразу
+    std::packaged_task<int()> task(run_checks);
+    std::future<int> result = task.get_future();
+    std::thread runner(std::move(task));
+    if (result.wait_for(kWatchdog) != std::future_status::ready) {
+        std::cerr << "FAIL deadlock: checks did not finish in " << kWatchdog.count() << " s" << std::endl;
+        std::_Exit(1);
+    }
+    runner.join();
+    return result.get();
+}
@@ -0,0 +1,1261 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <new>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "blur_client.h"
+#include "blur_daemon.h"
+#include "frame_stream.h"
+#include "image_convolver.h"
+#include "median_filter.h"
+#include "metrics.h"
+#include "process_shard.h"
+#include "recursive_gaussian.h"
+#include "stb_image.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Сравнение всех вариантов process_* с эталонным process_default на сырых буферах.
+// Код возврата 0 - все варианты в пределах допусков, 1 - есть расхождения.
+
+// Байты, выделенные через operator new: проверка, что конструктор ImageConvolver
+// с большим dilation не строит плотное ядро
+static std::atomic<size_t> g_allocated_bytes{0};
+
+void* operator new(size_t size) {
+    g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+using Image = std::vector<unsigned char>;
+using VariantFn = std::function<Image(ImageConvolver&, const unsigned char*, int, int)>;
+
+struct Variant {
+    std::string name;
+    VariantFn run;
+    int max_error;      ///< Допустимое отклонение одного канала
+    double mean_error;  ///< Допустимое среднее отклонение по всем каналам
+};
+
+struct KernelCase {
+    std::string name;
+    std::vector<float> weights;
+    int dim;
+};
+
+struct ErrorStats {
+    int max_error = 0;
+    double mean_error = 0.0;
+};
+
+std::vector<float> gaussian_kernel(int dim) {
+    std::vector<float> k(dim * dim);
+    float sigma = std::max(dim / 6.0f, 1.0f);
+    float sum = 0.0f;
+    int half = dim / 2;
+    for (int y = -half; y <= half; ++y) {
+        for (int x = -half; x <= half; ++x) {
+            float val = std::exp(-(x * x + y * y) / (2 * sigma * sigma));
+            k[(y + half) * dim + (x + half)] = val;
+            sum += val;
+        }
+    }
+    for (float& v : k) v /= sum;
+    return k;
+}
+
+std::vector<KernelCase> kernel_cases() {
+    std::vector<KernelCase> cases;
+    for (int dim : {1, 3, 5, 7, 9}) {
+        cases.push_back({"gauss" + std::to_string(dim), gaussian_kernel(dim), dim});
+    }
+    // Ядро с отрицательными весами: проверяет насыщение снизу и сверху
+    cases.push_back({"sharpen3", {0.f, -1.f, 0.f, -1.f, 5.f, -1.f, 0.f, -1.f, 0.f}, 3});
+    // Несимметричное ядро и сепарабельное с антисимметричной строкой (Собель)
+    cases.push_back({"emboss3", {-2.f, -1.f, 0.f, -1.f, 1.f, 1.f, 0.f, 1.f, 2.f}, 3});
+    cases.push_back({"sobel3", {-1.f, 0.f, 1.f, -2.f, 0.f, 2.f, -1.f, 0.f, 1.f}, 3});
+    return cases;
+}
+
+Image random_image(int w, int h, unsigned seed) {
+    Image img(static_cast<size_t>(w) * static_cast<size_t>(h) * 4);
+    unsigned state = seed * 2654435761u + 1u;
+    for (unsigned char& v : img) {
+        state = state * 1664525u + 1013904223u;
+        v = static_cast<unsigned char>(state >> 24);
+    }
+    return img;
+}
+
+ErrorStats compare(const Image& expected, const Image& actual) {
+    ErrorStats stats;
+    if (expected.empty()) return stats;
+    double sum = 0.0;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        int diff = std::abs(static_cast<int>(expected[i]) - static_cast<int>(actual[i]));
+        stats.max_error = std::max(stats.max_error, diff);
+        sum += diff;
+    }
+    stats.mean_error = sum / static_cast<double>(expected.size());
+    return stats;
+}
+
+std::vector<Variant> variants(ThreadPool& shared_pool) {
+    // Скалярные многопоточные варианты должны совпадать с эталоном побитово.
+    // SIMD-варианты используют FMA, поэтому на границе целого допускается +-1.
+    return {
+        {"process_SIMD",
+         [](ImageConvolver& c, const unsigned char* img, int w, int h) { return c.process_SIMD(img, w, h); },
+         1, 0.02},
+        {"process_SIMD(pool)",
+         [](ImageConvolver& c, const unsigned char* img, int w, int h) {
+             // Буферы переиспользуются между проверками, поэтому мусор прошлых результатов
+             // в непереписанных байтах был бы замечен
+             static BufferPool pool;
+             PooledBuffer out = c.process_SIMD(pool, img, w, h);
+             return Image(out.data(), out.data() + out.size());
+         },
+         1, 0.02},
+        {"process_SIMD_blocked",
+         [](ImageConvolver& c, const unsigned char* img, int w, int h) { return c.process_SIMD_blocked(img, w, h); },
+         1, 0.02},
+        // Другой порядок сложения (и разложение на два прохода): возможна разница в единицу
+        {"process_folded",
+         [](ImageConvolver& c, const unsigned char* img, int w, int h) { return c.process_folded(img, w, h); },
+         1, 0.02},
+        // Только ненулевые тапы в порядке process_SIMD: та же сумма, что у process_SIMD
+        {"process_sparse",
+         [](ImageConvolver& c, const unsigned char* img, int w, int h) { return c.process_sparse(img, w, h); },
+         1, 0.02},
+        {"process_sparse_thread_pool(shared)",
+         [&shared_pool](ImageConvolver& c, const unsigned char* img, int w, int h) {
+             return c.process_sparse_thread_pool(shared_pool, img, w, h);
+         },
+         1, 0.02},
+        {"process_thread_pool(1)",
+         [](ImageConvolver& c, const unsigned char* img, int w, int h) { return c.process_thread_pool(img, w, h, 1); },
+         0, 0.0},
+        {"process_thread_pool(3)",
+         [](ImageConvolver& c, const unsigned char* img, int w, int h) { return c.process_thread_pool(img, w, h, 3); },
+         0, 0.0},
+        {"process_thread_pool(shared)",
+         [&shared_pool](ImageConvolver& c, const unsigned char* img, int w, int h) {
+             return c.process_thread_pool(shared_pool, img, w, h, TaskPriority::High);
+         },
+         0, 0.0},
+        {"process_thread_pool_full(3)",
+         [](ImageConvolver& c, const unsigned char* img, int w, int h) {
+             return c.process_thread_pool_full(img, w, h, 3);
+         },
+         0, 0.0},
+        {"process_thread_pool_full(shared)",
+         [&shared_pool](ImageConvolver& c, const unsigned char* img, int w, int h) {
+             return c.process_thread_pool_full(shared_pool, img, w, h, TaskPriority::Low);
+         },
+         0, 0.0},
+        {"process_native<u8,4>",
+         [](ImageConvolver& c, const unsigned char* img, int w, int h) {
+             return c.process_native<unsigned char, 4>(img, w, h);
+         },
+         1, 0.02},
+        {"process_decimate(1)",
+         [](ImageConvolver& c, const unsigned char* img, int w, int h) {
+             int ow = 0;
+             int oh = 0;
+             return c.process_decimate(img, w, h, 1, ow, oh);
+         },
+         1, 0.02},
+    };
+}
+
+// Входные данные process_native: полный диапазон целых T, для float - [0, 1)
+template<typename T>
+std::vector<T> random_native_image(int w, int h, int channels, unsigned seed) {
+    std::vector<T> img(static_cast<size_t>(w) * static_cast<size_t>(h) * channels);
+    unsigned state = seed * 2654435761u + 1u;
+    for (T& v : img) {
+        state = state * 1664525u + 1013904223u;
+        if constexpr (std::is_same_v<T, float>) {
+            v = static_cast<float>(state >> 8) / 16777216.f;
+        } else {
+            v = static_cast<T>(state >> (32 - 8 * sizeof(T)));
+        }
+    }
+    return img;
+}
+
+// Скалярный эталон process_native: сумма в double, отбрасывание дробной части и насыщение
+// по диапазону целого T (float не насыщается); при C = 2 и C = 4 последний канал - альфа,
+// граница копируется
+template<typename T, int C>
+std::vector<T> native_reference(const std::vector<T>& input, int w, int h, const KernelCase& kc) {
+    std::vector<T> out(input);
+    const int half = kc.dim / 2;
+    const bool has_alpha = C == 2 || C == 4;
+    for (int y = half; y < h - half; ++y) {
+        for (int x = half; x < w - half; ++x) {
+            for (int c = 0; c < C; ++c) {
+                if (has_alpha && c == C - 1) {
+                    continue;
+                }
+                double sum = 0.0;
+                for (int ky = -half; ky <= half; ++ky) {
+                    for (int kx = -half; kx <= half; ++kx) {
+                        const size_t idx = (static_cast<size_t>(y + ky) * w + (x + kx)) * C + c;
+                        sum += static_cast<double>(kc.weights[(ky + half) * kc.dim + (kx + half)]) * input[idx];
+                    }
+                }
+                T& dst = out[(static_cast<size_t>(y) * w + x) * C + c];
+                if constexpr (std::is_same_v<T, float>) {
+                    dst = static_cast<float>(sum);
+                } else {
+                    dst = static_cast<T>(std::clamp(sum, 0.0, static_cast<double>(std::numeric_limits<T>::max())));
+                }
+            }
+        }
+    }
+    return out;
+}
+
+// Максимальное отклонение process_native<T, C> от эталона (бесконечность при несовпадении размера)
+template<typename T, int C>
+double native_max_error(ImageConvolver& convolver, const KernelCase& kc, int w, int h) {
+    const std::vector<T> input = random_native_image<T>(w, h, C, static_cast<unsigned>(w * 131 + h * 7 + C));
+    const std::vector<T> expected = native_reference<T, C>(input, w, h, kc);
+    const std::vector<T> actual = convolver.process_native<T, C>(input.data(), w, h);
+    if (actual.size() != expected.size()) {
+        return std::numeric_limits<double>::infinity();
+    }
+    double max_error = 0.0;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        max_error = std::max(max_error, std::abs(static_cast<double>(expected[i]) - static_cast<double>(actual[i])));
+    }
+    return max_error;
+}
+
+struct NativeCase {
+    std::string name;
+    std::function<double(ImageConvolver&, const KernelCase&, int, int)> max_error_of;
+    double max_error;  ///< Допустимое отклонение одной компоненты
+};
+
+// Все явные инстанцирования process_native. У целых типов FMA в float может сдвинуть
+// сумму через границу целого (+-1); у float - ошибки округления порядка 1e-6
+std::vector<NativeCase> native_cases() {
+    return {
+        {"process_native<u8,1>", native_max_error<unsigned char, 1>, 1.0},
+        {"process_native<u8,2>", native_max_error<unsigned char, 2>, 1.0},
+        {"process_native<u8,3>", native_max_error<unsigned char, 3>, 1.0},
+        {"process_native<u8,4>", native_max_error<unsigned char, 4>, 1.0},
+        {"process_native<u16,1>", native_max_error<unsigned short, 1>, 1.0},
+        {"process_native<u16,2>", native_max_error<unsigned short, 2>, 1.0},
+        {"process_native<u16,3>", native_max_error<unsigned short, 3>, 1.0},
+        {"process_native<u16,4>", native_max_error<unsigned short, 4>, 1.0},
+        {"process_native<f32,1>", native_max_error<float, 1>, 1e-4},
+        {"process_native<f32,2>", native_max_error<float, 2>, 1e-4},
+        {"process_native<f32,3>", native_max_error<float, 3>, 1e-4},
+        {"process_native<f32,4>", native_max_error<float, 4>, 1e-4},
+    };
+}
+
+// Пиксели (x * factor, y * factor): эталон для прореживания
+Image subsample(const Image& img, int w, int h, int factor) {
+    const int out_w = (w + factor - 1) / factor;
+    const int out_h = (h + factor - 1) / factor;
+    Image out(static_cast<size_t>(out_w) * out_h * 4);
+    for (int oy = 0; oy < out_h; ++oy) {
+        for (int ox = 0; ox < out_w; ++ox) {
+            const size_t src = (static_cast<size_t>(oy) * factor * w + static_cast<size_t>(ox) * factor) * 4;
+            std::copy(img.begin() + src, img.begin() + src + 4, out.begin() + (static_cast<size_t>(oy) * out_w + ox) * 4);
+        }
+    }
+    return out;
+}
+
+// Кадровый поток: после серии частичных изменений результат обязан совпадать с process_SIMD
+bool check_frame_stream(const KernelCase& kc, int w, int h) {
+    FrameStreamConvolver stream(kc.weights, kc.dim, kc.dim, 8);
+    ImageConvolver convolver(kc.weights, kc.dim, kc.dim);
+    Image frame = random_image(w, h, 7);
+    stream.process_frame(frame.data(), w, h);
+
+    for (int step = 0; step < 4; ++step) {
+        DirtyRect rect{(step * 5) % w, (step * 3) % h, std::max(1, w / 3), std::max(1, h / 4)};
+        for (int y = rect.y; y < std::min(h, rect.y + rect.h); ++y) {
+            for (int x = rect.x; x < std::min(w, rect.x + rect.w); ++x) {
+                frame[(static_cast<size_t>(y) * w + x) * 4 + step % 4] ^= 0x5a;
+            }
+        }
+        const Image& out = (step % 2 == 0) ? stream.process_frame(frame.data(), w, h, {rect})
+                                           : stream.process_frame(frame.data(), w, h);
+        if (out != convolver.process_SIMD(frame.data(), w, h)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Эталон медианы: сортировка окна для каждого пикселя и канала
+Image median_reference(const Image& input, int w, int h, int size) {
+    Image out = input;
+    const int r = size / 2;
+    std::vector<unsigned char> values;
+    for (int y = r; y < h - r; ++y) {
+        for (int x = r; x < w - r; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                values.clear();
+                for (int dy = -r; dy <= r; ++dy) {
+                    for (int dx = -r; dx <= r; ++dx) {
+                        values.push_back(input[(static_cast<size_t>(y + dy) * w + (x + dx)) * 4 + c]);
+                    }
+                }
+                std::sort(values.begin(), values.end());
+                out[(static_cast<size_t>(y) * w + x) * 4 + c] = values[values.size() / 2];
+            }
+        }
+    }
+    return out;
+}
+
+// Эталон гауссианы: раздельная свертка в double с повтором краевых пикселей, радиус 4 sigma
+Image gaussian_reference(const Image& input, int w, int h, float sigma) {
+    const int r = static_cast<int>(std::ceil(4.0 * sigma));
+    std::vector<double> taps(2 * r + 1);
+    double sum = 0.0;
+    for (int i = -r; i <= r; ++i) {
+        taps[i + r] = std::exp(-(i * i) / (2.0 * sigma * sigma));
+        sum += taps[i + r];
+    }
+    for (double& t : taps) t /= sum;
+
+    std::vector<double> rows(input.size());
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                double acc = 0.0;
+                for (int i = -r; i <= r; ++i) {
+                    const int xx = std::clamp(x + i, 0, w - 1);
+                    acc += taps[i + r] * input[(static_cast<size_t>(y) * w + xx) * 4 + c];
+                }
+                rows[(static_cast<size_t>(y) * w + x) * 4 + c] = acc;
+            }
+        }
+    }
+    Image out = input;
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            for (int c = 0; c < 3; ++c) {
+                double acc = 0.0;
+                for (int i = -r; i <= r; ++i) {
+                    const int yy = std::clamp(y + i, 0, h - 1);
+                    acc += taps[i + r] * rows[(static_cast<size_t>(yy) * w + x) * 4 + c];
+                }
+                out[(static_cast<size_t>(y) * w + x) * 4 + c] = static_cast<unsigned char>(std::clamp(acc, 0.0, 255.0));
+            }
+        }
+    }
+    return out;
+}
+
+#if !defined(_WIN32)
+bool check_daemon(BlurClient& client, const KernelCase& kc, const Image& input, int w, int h, const Image& expected) {
+    SharedImage image(w, h);
+    std::copy(input.begin(), input.end(), image.input());
+    BlurJobReply reply = client.blur_shared(kc.weights, kc.dim, image);
+    return reply.status == BlurJobStatus::Ok && reply.w == w && reply.h == h &&
+           std::equal(expected.begin(), expected.end(), image.output());
+}
+#endif
+
+
+// Минимальный разбор JSON для проверки трассы: значение - число, строка, массив или объект
+struct Json {
+    enum class Type { Null, Bool, Number, String, Array, Object } type = Type::Null;
+    double number = 0.0;
+    std::string text;
+    std::vector<Json> items;
+    std::map<std::string, Json> fields;
+
+    const Json* get(const std::string& key) const {
+        auto it = fields.find(key);
+        return it == fields.end() ? nullptr : &it->second;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(std::string text) : m_text(std::move(text)) {}
+
+    // Весь текст - одно значение (пробелы по краям допустимы)
+    bool parse(Json& out) {
+        return value(out) && (skip_spaces(), m_pos == m_text.size());
+    }
+
+private:
+    void skip_spaces() {
+        while (m_pos < m_text.size() && std::isspace(static_cast<unsigned char>(m_text[m_pos]))) ++m_pos;
+    }
+
+    bool literal(const char* word) {
+        const size_t len = std::char_traits<char>::length(word);
+        if (m_text.compare(m_pos, len, word) != 0) return false;
+        m_pos += len;
+        return true;
+    }
+
+    bool string(std::string& out) {
+        if (m_text[m_pos] != '"') return false;
+        for (++m_pos; m_pos < m_text.size(); ++m_pos) {
+            const char c = m_text[m_pos];
+            if (c == '"') {
+                ++m_pos;
+                return true;
+            }
+            if (static_cast<unsigned char>(c) < 0x20) return false;
+            if (c == '\\') {
+                if (++m_pos == m_text.size() || std::string("\"\\/bfnrt").find(m_text[m_pos]) == std::string::npos) {
+                    return false;  // \u в трассе не используется
+                }
+            }
+            out.push_back(m_text[m_pos]);
+        }
+        return false;
+    }
+
+    bool value(Json& out) {
+        skip_spaces();
+        if (m_pos == m_text.size()) return false;
+        const char c = m_text[m_pos];
+        if (c == '{' || c == '[') {
+            const bool object = c == '{';
+            out.type = object ? Json::Type::Object : Json::Type::Array;
+            ++m_pos;
+            skip_spaces();
+            if (m_pos < m_text.size() && m_text[m_pos] == (object ? '}' : ']')) {
+                ++m_pos;
+                return true;
+            }
+            while (true) {
+                Json item;
+                if (object) {
+                    std::string key;
+                    skip_spaces();
+                    if (m_pos == m_text.size() || !string(key)) return false;
+                    skip_spaces();
+                    if (m_pos == m_text.size() || m_text[m_pos++] != ':') return false;
+                    if (!value(item)) return false;
+                    out.fields[key] = std::move(item);
+                } else {
+                    if (!value(item)) return false;
+                    out.items.push_back(std::move(item));
+                }
+                skip_spaces();
+                if (m_pos == m_text.size()) return false;
+                const char next = m_text[m_pos++];
+                if (next == (object ? '}' : ']')) return true;
+                if (next != ',') return false;
+            }
+        }
+        if (c == '"') {
+            out.type = Json::Type::String;
+            return string(out.text);
+        }
+        if (literal("true") || literal("false")) {
+            out.type = Json::Type::Bool;
+            return true;
+        }
+        if (literal("null")) return true;
+        const char* begin = m_text.c_str() + m_pos;
+        char* end = nullptr;
+        out.number = std::strtod(begin, &end);
+        if (end == begin) return false;
+        out.type = Json::Type::Number;
+        m_pos += static_cast<size_t>(end - begin);
+        return true;
+    }
+
+    std::string m_text;
+    size_t m_pos = 0;
+};
+
+// Трасса из write_json: разбирается как JSON, есть интервалы X и стрелки s/f с парными id
+// (задача, поставленная до start(), может закончить стрелку без начала), у каждого потока есть метаданные thread_name, и ни один поток не остался безымянным
+// ("thread N" - имя по умолчанию, которое получают потоки без set_thread_name)
+std::string check_trace_json(const std::string& path) {
+    std::ifstream file(path);
+    std::stringstream content;
+    content << file.rdbuf();
+    Json root;
+    if (!file || !JsonParser(content.str()).parse(root)) return "write_json output is not valid JSON";
+    const Json* events = root.get("traceEvents");
+    if (!events || events->type != Json::Type::Array) return "no traceEvents array";
+
+    std::map<int, std::string> names;
+    std::set<int> tids;
+    std::set<double> flow_begins;
+    std::set<double> flow_ends;
+    int intervals = 0;
+    bool worker_named = false;
+    for (const Json& ev : events->items) {
+        const Json* ph = ev.get("ph");
+        const Json* tid = ev.get("tid");
+        if (!ph || ph->type != Json::Type::String || !tid || tid->type != Json::Type::Number || !ev.get("name")) {
+            return "event without ph/tid/name";
+        }
+        const int t = static_cast<int>(tid->number);
+        if (ph->text == "M") {
+            const Json* args = ev.get("args");
+            const Json* name = args ? args->get("name") : nullptr;
+            if (ev.get("name")->text != "thread_name" || !name) return "bad thread_name metadata";
+            names[t] = name->text;
+            worker_named = worker_named || name->text.rfind("ThreadPool worker ", 0) == 0;
+            continue;
+        }
+        tids.insert(t);
+        if (!ev.get("ts")) return "event without ts";
+        if (ph->text == "X") {
+            if (!ev.get("dur")) return "X event without dur";
+            ++intervals;
+        } else if (ph->text == "s" || ph->text == "f") {
+            const Json* id = ev.get("id");
+            if (!id) return "flow event without id";
+            (ph->text == "s" ? flow_begins : flow_ends).insert(id->number);
+        } else {
+            return "unexpected phase " + ph->text;
+        }
+    }
+    if (intervals == 0 || flow_begins.empty() || flow_ends.empty()) return "no X or s/f events";
+    if (std::none_of(flow_ends.begin(), flow_ends.end(), [&](double id) { return flow_begins.count(id) != 0; })) {
+        return "no flow end matches a flow begin";
+    }
+    for (int t : tids) {
+        auto it = names.find(t);
+        if (it == names.end()) return "tid " + std::to_string(t) + " has no thread_name";
+        if (it->second.rfind("thread ", 0) == 0) return "tid " + std::to_string(t) + " is unnamed: " + it->second;
+    }
+    return worker_named ? std::string{} : "no ThreadPool worker thread_name";
+}
+
+
+// Корзины LatencyHistogram: 0..15 точные, дальше 16 корзин на октаву без дыр и перекрытий,
+// ширина корзины не больше 1/16 ее нижней границы; большие значения - в последнюю корзину
+std::string check_histogram_buckets() {
+    for (int i = 0; i < LatencyHistogram::kSubBuckets; ++i) {
+        if (LatencyHistogram::bucket_index(i) != i || LatencyHistogram::bucket_upper(i) != static_cast<uint64_t>(i)) {
+            return "exact bucket " + std::to_string(i);
+        }
+    }
+    for (int i = 0; i + 1 < LatencyHistogram::kBucketCount; ++i) {
+        const uint64_t upper = LatencyHistogram::bucket_upper(i);
+        if (LatencyHistogram::bucket_index(upper) != i || LatencyHistogram::bucket_index(upper + 1) != i + 1) {
+            return "bucket " + std::to_string(i) + " is not contiguous at " + std::to_string(upper);
+        }
+        if (i >= LatencyHistogram::kSubBuckets) {
+            const uint64_t lower = LatencyHistogram::bucket_upper(i - 1) + 1;
+            if ((upper - lower + 1) * LatencyHistogram::kSubBuckets > lower) {
+                return "bucket " + std::to_string(i) + " is wider than 1/16";
+            }
+        }
+    }
+    const uint64_t top = uint64_t(1) << LatencyHistogram::kMaxExponent;
+    for (uint64_t value : {top - 1, top, std::numeric_limits<uint64_t>::max()}) {
+        if (LatencyHistogram::bucket_index(value) != LatencyHistogram::kBucketCount - 1) {
+            return "value " + std::to_string(value) + " is not in the last bucket";
+        }
+    }
+    return {};
+}
+
+// Квантили снимка против точных (ранг ceil(q * n)) на лог-равномерных значениях
+// 100 нс..10 мс: не меньше точного и не больше него на 1/16; reset() обнуляет все
+std::string check_histogram_quantiles() {
+    LatencyHistogram histogram;
+    std::vector<uint64_t> values;
+    unsigned state = 12345u;
+    uint64_t sum = 0;
+    for (int i = 0; i < 20000; ++i) {
+        state = state * 1664525u + 1013904223u;
+        const double exponent = 2.0 + 5.0 * static_cast<double>(state >> 8) / 16777216.0;
+        values.push_back(static_cast<uint64_t>(std::pow(10.0, exponent)));
+        histogram.record(values.back());
+        sum += values.back();
+    }
+    std::sort(values.begin(), values.end());
+
+    const HistogramSnapshot snap = histogram.snapshot();
+    if (snap.count != values.size() || snap.sum_ns != sum || snap.max_ns != values.back()) {
+        return "snapshot count/sum/max";
+    }
+    for (double q : {0.001, 0.25, 0.5, 0.9, 0.99, 0.999}) {
+        const size_t rank = static_cast<size_t>(std::ceil(q * static_cast<double>(values.size())));
+        const uint64_t exact = values[std::max<size_t>(rank, 1) - 1];
+        const uint64_t reported = snap.quantile_ns(q);
+        if (reported < exact || static_cast<double>(reported) > static_cast<double>(exact) * (1.0 + 1.0 / 16.0)) {
+            return "quantile " + std::to_string(q) + ": " + std::to_string(reported) + " vs " + std::to_string(exact);
+        }
+    }
+    if (snap.quantile_ns(1.0) != values.back()) return "quantile 1.0 is not the maximum";
+
+    histogram.reset();
+    const HistogramSnapshot empty = histogram.snapshot();
+    if (empty.count != 0 || empty.sum_ns != 0 || empty.max_ns != 0 || empty.quantile_ns(0.5) != 0 ||
+        std::any_of(empty.buckets.begin(), empty.buckets.end(), [](uint64_t b) { return b != 0; })) {
+        return "reset() left samples";
+    }
+    return {};
+}
+
+// Экспозиция Prometheus: каждая строка - комментарий или имя{метки} значение;
+// ключ карты - "имя{метки}"
+bool parse_exposition(const std::string& text, std::map<std::string, double>& samples) {
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.rfind("# HELP ", 0) == 0 || line.rfind("# TYPE ", 0) == 0) continue;
+        const size_t open = line.find('{');
+        const size_t close = line.find("} ");
+        if (open == std::string::npos || close == std::string::npos || open == 0 || close < open) return false;
+        for (size_t i = 0; i < open; ++i) {
+            if (!std::isalnum(static_cast<unsigned char>(line[i])) && line[i] != '_') return false;
+        }
+        // Метки: key="value" через запятую
+        std::istringstream labels(line.substr(open + 1, close - open - 1));
+        std::string label;
+        while (std::getline(labels, label, ',')) {
+            const size_t eq = label.find("=\"");
+            if (eq == std::string::npos || eq == 0 || label.back() != '"' || label.size() < eq + 3) return false;
+        }
+        char* end = nullptr;
+        const std::string value = line.substr(close + 2);
+        const double number = std::strtod(value.c_str(), &end);
+        if (value.empty() || *end != '\0') return false;
+        samples[line.substr(0, close + 1)] = number;
+    }
+    return true;
+}
+
+std::string check_expose_text() {
+    MetricsRegistry metrics;
+    for (uint64_t ns : {1000u, 2000u, 3000u}) {
+        metrics.record(MetricStage::Convolve, MetricVariant::SIMD, 96, 64, ns);
+    }
+    metrics.record(MetricStage::Load, MetricVariant::Io, 4096, 4097, 5000);
+
+    const std::string text = metrics.expose_text();
+    std::map<std::string, double> samples;
+    if (!parse_exposition(text, samples)) return "malformed exposition line";
+    if (text.find("# TYPE blur_stage_latency_seconds summary\n") == std::string::npos ||
+        text.find("# TYPE blur_stage_latency_max_seconds gauge\n") == std::string::npos) {
+        return "missing TYPE lines";
+    }
+
+    const std::string simd = "stage=\"convolve\",variant=\"simd\",size=\"le256\"";
+    const std::string load = "stage=\"load\",variant=\"io\",size=\"gt4096\"";
+    const HistogramSnapshot simd_hist =
+        metrics.histogram(MetricStage::Convolve, MetricVariant::SIMD, MetricsRegistry::size_bucket(96, 64)).snapshot();
+    const std::map<std::string, double> expected = {
+        {"blur_stage_latency_seconds{" + simd + ",quantile=\"0.5\"}", simd_hist.quantile_ns(0.5) * 1e-9},
+        {"blur_stage_latency_seconds{" + simd + ",quantile=\"0.9\"}", simd_hist.quantile_ns(0.9) * 1e-9},
+        {"blur_stage_latency_seconds{" + simd + ",quantile=\"0.99\"}", 3e-6},
+        {"blur_stage_latency_seconds{" + simd + ",quantile=\"0.999\"}", 3e-6},
+        {"blur_stage_latency_seconds_sum{" + simd + "}", 6e-6},
+        {"blur_stage_latency_seconds_count{" + simd + "}", 3},
+        {"blur_stage_latency_max_seconds{" + simd + "}", 3e-6},
+        {"blur_stage_latency_seconds{" + load + ",quantile=\"0.5\"}", 5e-6},
+        {"blur_stage_latency_seconds{" + load + ",quantile=\"0.9\"}", 5e-6},
+        {"blur_stage_latency_seconds{" + load + ",quantile=\"0.99\"}", 5e-6},
+        {"blur_stage_latency_seconds{" + load + ",quantile=\"0.999\"}", 5e-6},
+        {"blur_stage_latency_seconds_sum{" + load + "}", 5e-6},
+        {"blur_stage_latency_seconds_count{" + load + "}", 1},
+        {"blur_stage_latency_max_seconds{" + load + "}", 5e-6},
+    };
+    // Пустые гистограммы не выводятся: ровно ожидаемый набор серий
+    if (samples.size() != expected.size()) return "unexpected series count " + std::to_string(samples.size());
+    for (const auto& [key, value] : expected) {
+        auto it = samples.find(key);
+        if (it == samples.end()) return "missing " + key;
+        if (std::abs(it->second - value) > 1e-15) return key + " = " + std::to_string(it->second);
+    }
+    if (simd_hist.quantile_ns(0.5) < 2000 || simd_hist.quantile_ns(0.5) > 2000 + 2000 / 16) {
+        return "median of 1/2/3 us is not ~2 us";
+    }
+
+    metrics.reset();
+    samples.clear();
+    if (!parse_exposition(metrics.expose_text(), samples) || !samples.empty()) return "reset() left series";
+    return {};
+}
+
+} // namespace
+
+int main() {
+    // Нечетные ширины, ширины меньше ядра и неквадратные изображения
+    const std::vector<std::pair<int, int>> sizes = {
+        {1, 1}, {2, 3}, {3, 3}, {4, 9}, {5, 4}, {7, 7}, {8, 2}, {9, 13},
+        {13, 5}, {17, 31}, {33, 17}, {64, 3}, {101, 67}, {256, 129}
+    };
+
+    ThreadPool shared_pool(2);
+    const std::vector<Variant> all_variants = variants(shared_pool);
+    const std::vector<NativeCase> all_native = native_cases();
+
+    int checks = 0;
+    int failures = 0;
+
+#if !defined(_WIN32)
+    BlurDaemon::Options daemon_options;
+    daemon_options.socket_path = "/tmp/blur_regression_" +
+                                 std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + ".sock";
+    daemon_options.threads = 2;
+    daemon_options.max_cached_kernels = 2;  // 5 ядер по кругу - вытеснение тоже проверяется
+    BlurDaemon daemon(daemon_options);
+    std::thread daemon_thread([&daemon]() { daemon.run(); });
+    auto daemon_client = std::make_unique<BlurClient>(daemon_options.socket_path);
+#endif
+
+    for (const KernelCase& kc : kernel_cases()) {
+        ImageConvolver convolver(kc.weights, kc.dim, kc.dim);
+#if defined(__linux__)
+        // Рабочих больше, чем строк у маленьких изображений: часть полос пуста
+        ProcessShardConvolver sharded(kc.weights, kc.dim, kc.dim, 3);
+#endif
+
+        for (const auto& [w, h] : sizes) {
+            Image input = random_image(w, h, static_cast<unsigned>(w * 131 + h));
+            Image expected = convolver.process_default(input.data(), w, h);
+
+            for (const Variant& v : all_variants) {
+                Image actual = v.run(convolver, input.data(), w, h);
+                ++checks;
+
+                if (actual.size() != expected.size()) {
+                    std::cerr << "FAIL " << v.name << " " << kc.name << " " << w << "x" << h
+                              << ": size " << actual.size() << " != " << expected.size() << std::endl;
+                    ++failures;
+                    continue;
+                }
+
+                ErrorStats stats = compare(expected, actual);
+                if (stats.max_error > v.max_error || stats.mean_error > v.mean_error) {
+                    std::cerr << "FAIL " << v.name << " " << kc.name << " " << w << "x" << h
+                              << ": max " << stats.max_error << " (limit " << v.max_error << ")"
+                              << ", mean " << stats.mean_error << " (limit " << v.mean_error << ")"
+                              << std::endl;
+                    ++failures;
+                }
+            }
+
+            // Все форматы process_native против скалярного эталона того же формата
+            for (const NativeCase& nc : all_native) {
+                ++checks;
+                const double error = nc.max_error_of(convolver, kc, w, h);
+                if (!(error <= nc.max_error)) {
+                    std::cerr << "FAIL " << nc.name << " " << kc.name << " " << w << "x" << h
+                              << ": max " << error << " (limit " << nc.max_error << ")" << std::endl;
+                    ++failures;
+                }
+            }
+
+            // Прореживание: четные пиксели через перестановку (factor 2), gather для остальных
+            // factor и правого края; сравнение с process_SIMD в точках (x * N, y * N).
+            // Хвосты считаются скалярно в другом порядке сложения, поэтому +-1
+            const Image simd = convolver.process_SIMD(input.data(), w, h);
+            for (int factor : {2, 3, 4}) {
+                int ow = 0;
+                int oh = 0;
+                const Image decimated = convolver.process_decimate(input.data(), w, h, factor, ow, oh);
+                const Image reference = subsample(simd, w, h, factor);
+                ++checks;
+                const ErrorStats stats = decimated.size() == reference.size() ? compare(reference, decimated)
+                                                                               : ErrorStats{256, 256.0};
+                if (stats.max_error > 1 || stats.mean_error > 0.02) {
+                    std::cerr << "FAIL process_decimate(" << factor << ") " << kc.name << " " << w << "x" << h
+                              << ": max " << stats.max_error << ", mean " << stats.mean_error << std::endl;
+                    ++failures;
+                }
+            }
+
+            // Пирамида: каждый уровень - process_SIMD предыдущего уровня, прореженный в 2 раза
+            {
+                const std::vector<PyramidLevel> levels = convolver.build_pyramid(input.data(), w, h, 1, 2);
+                const Image* prev = &input;
+                int pw = w;
+                int ph = h;
+                for (size_t l = 0; l < levels.size(); ++l) {
+                    const Image reference = subsample(convolver.process_SIMD(prev->data(), pw, ph), pw, ph, 2);
+                    ++checks;
+                    const ErrorStats stats = levels[l].data.size() == reference.size()
+                                                 ? compare(reference, levels[l].data)
+                                                 : ErrorStats{256, 256.0};
+                    if (stats.max_error > 1 || stats.mean_error > 0.02) {
+                        std::cerr << "FAIL build_pyramid level " << l + 1 << " " << kc.name << " " << w << "x" << h
+                                  << ": max " << stats.max_error << ", mean " << stats.mean_error << std::endl;
+                        ++failures;
+                    }
+                    prev = &levels[l].data;
+                    pw = levels[l].w;
+                    ph = levels[l].h;
+                }
+            }
+
+            // Блочное микроядро меняет только порядок обхода, но не порядок накопления
+            ++checks;
+            if (convolver.process_SIMD_blocked(input.data(), w, h) != convolver.process_SIMD(input.data(), w, h)) {
+                std::cerr << "FAIL process_SIMD_blocked " << kc.name << " " << w << "x" << h
+                          << ": differs from process_SIMD" << std::endl;
+                ++failures;
+            }
+
+#if defined(__linux__)
+            // Полосы в рабочих процессах; сегмент пересоздается по мере роста размеров
+            ++checks;
+            if (sharded.process(input.data(), w, h) != convolver.process_SIMD(input.data(), w, h)) {
+                std::cerr << "FAIL ProcessShardConvolver " << kc.name << " " << w << "x" << h
+                          << ": differs from process_SIMD" << std::endl;
+                ++failures;
+            }
+#endif
+
+#if !defined(_WIN32)
+            // Демон: изображение в разделяемой памяти, результат пишется туда же
+            ++checks;
+            if (!check_daemon(*daemon_client, kc, input, w, h, convolver.process_SIMD(input.data(), w, h))) {
+                std::cerr << "FAIL BlurDaemon " << kc.name << " " << w << "x" << h
+                          << ": differs from process_SIMD" << std::endl;
+                ++failures;
+            }
+#endif
+
+            ++checks;
+            if (!check_frame_stream(kc, w, h)) {
+                std::cerr << "FAIL FrameStreamConvolver " << kc.name << " " << w << "x" << h
+                          << ": differs from process_SIMD" << std::endl;
+                ++failures;
+            }
+        }
+
+        // Пакетная свертка: неполные четверки изображений и ширины меньше 4 пикселей
+        for (const auto& [w, h] : {std::pair<int, int>{1, 1}, {3, 3}, {6, 5}, {9, 13}, {33, 17}}) {
+            for (int count : {1, 4, 7}) {
+                const size_t frame = static_cast<size_t>(w) * h * 4;
+                Image tensor;
+                for (int i = 0; i < count; ++i) {
+                    Image img = random_image(w, h, static_cast<unsigned>(i * 17 + w * 3 + h));
+                    tensor.insert(tensor.end(), img.begin(), img.end());
+                }
+                const Image batch = convolver.process_batch(tensor.data(), count, w, h);
+                const Image pooled = convolver.process_batch(shared_pool, tensor.data(), count, w, h);
+
+                for (int i = 0; i < count; ++i) {
+                    const unsigned char* img = tensor.data() + frame * i;
+                    Image actual(batch.begin() + frame * i, batch.begin() + frame * (i + 1));
+                    ErrorStats stats = compare(convolver.process_default(img, w, h), actual);
+                    ++checks;
+                    if (stats.max_error > 1 || stats.mean_error > 0.02) {
+                        std::cerr << "FAIL process_batch " << kc.name << " " << w << "x" << h << " image " << i
+                                  << "/" << count << ": max " << stats.max_error << ", mean " << stats.mean_error
+                                  << std::endl;
+                        ++failures;
+                    }
+                }
+                ++checks;
+                if (pooled != batch) {
+                    std::cerr << "FAIL process_batch(pool) " << kc.name << " " << w << "x" << h << " x" << count
+                              << ": differs from process_batch" << std::endl;
+                    ++failures;
+                }
+            }
+        }
+    }
+
+    // Разреженное (a trous) ядро: B3-сплайн 5x5 с шагом dilation против того же ядра,
+    // явно дополненного нулями; process_sparse обязан совпадать с process_SIMD побитово
+    const float spline[5] = {1.f / 16, 4.f / 16, 6.f / 16, 4.f / 16, 1.f / 16};
+    std::vector<float> atrous(25);
+    for (int y = 0; y < 5; ++y) {
+        for (int x = 0; x < 5; ++x) {
+            atrous[y * 5 + x] = spline[y] * spline[x];
+        }
+    }
+    for (int dilation : {1, 2, 3, 8}) {
+        const int dim = 4 * dilation + 1;
+        std::vector<float> padded(static_cast<size_t>(dim) * dim, 0.f);
+        for (int y = 0; y < 5; ++y) {
+            for (int x = 0; x < 5; ++x) {
+                padded[static_cast<size_t>(y) * dilation * dim + static_cast<size_t>(x) * dilation] = atrous[y * 5 + x];
+            }
+        }
+        ImageConvolver dilated(atrous, 5, 5, dilation);
+        ImageConvolver dense(padded, dim, dim);
+        for (const auto& [w, h] : {std::pair<int, int>{7, 5}, {dim + 3, dim}, {101, 67}}) {
+            Image input = random_image(w, h, static_cast<unsigned>(dilation * 31 + w));
+            Image expected = dense.process_SIMD(input.data(), w, h);
+
+            // Сначала разреженный путь: плотное ядро dilated еще не построено
+            ++checks;
+            if (dilated.process_sparse(input.data(), w, h) != expected) {
+                std::cerr << "FAIL dilation " << dilation << " " << w << "x" << h
+                          << ": process_sparse before any dense variant" << std::endl;
+                ++failures;
+            }
+            ++checks;
+            if (dilated.sparse_tap_count() != 25 || dilated.process_SIMD(input.data(), w, h) != expected) {
+                std::cerr << "FAIL dilation " << dilation << " " << w << "x" << h
+                          << ": process_SIMD differs from padded kernel" << std::endl;
+                ++failures;
+            }
+            ++checks;
+            if (dilated.process_sparse(input.data(), w, h) != expected ||
+                dilated.process_sparse_thread_pool(shared_pool, input.data(), w, h) != expected) {
+                std::cerr << "FAIL dilation " << dilation << " " << w << "x" << h
+                          << ": process_sparse differs from process_SIMD" << std::endl;
+                ++failures;
+            }
+        }
+    }
+
+    // Большой dilation: конструктор хранит только 81 тап (9x9 при dilation 32 в плотном
+    // виде - 66k весов, с упаковкой ~4 МБ). Плотное ядро появляется при первом
+    // плотном варианте и дает тот же результат
+    {
+        const std::vector<float> kernel = gaussian_kernel(9);
+        const size_t before = g_allocated_bytes.load();
+        ImageConvolver dilated(kernel, 9, 9, 32);
+        const size_t constructed = g_allocated_bytes.load() - before;
+        ++checks;
+        if (constructed > 64 * 1024 || dilated.sparse_tap_count() != 81) {
+            std::cerr << "FAIL dilation 32: constructor allocated " << constructed << " bytes" << std::endl;
+            ++failures;
+        }
+        const Image input = random_image(300, 280, 3);
+        const Image sparse = dilated.process_sparse(input.data(), 300, 280);
+        ++checks;
+        if (dilated.process_SIMD(input.data(), 300, 280) != sparse) {
+            std::cerr << "FAIL dilation 32: process_SIMD differs from process_sparse" << std::endl;
+            ++failures;
+        }
+    }
+
+    // Сохранение без потери формата: 16-битный PNG читается обратно побитно (200x100x4
+    // не влезает в один stored-блок deflate), HDR - с точностью RGBE (8 бит мантиссы
+    // от наибольшего канала пикселя); из HDR всегда читается RGB, серое - в три канала
+    {
+        ImageConvolver io({1.f}, 1, 1);
+        const std::string stamp = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+        const std::filesystem::path dir = std::filesystem::temp_directory_path();
+
+        for (const auto& [w, h] : {std::pair<int, int>{1, 1}, {37, 23}, {200, 100}}) {
+            for (int channels = 1; channels <= 4; ++channels) {
+                const std::vector<unsigned short> image =
+                    random_native_image<unsigned short>(w, h, channels, static_cast<unsigned>(w * 7 + channels));
+                const std::string path = (dir / ("regression16_" + stamp + ".png")).string();
+                ++checks;
+                int rw = 0;
+                int rh = 0;
+                int rc = 0;
+                unsigned short* loaded = io.saveImage16(path.c_str(), w, h, channels, image.data())
+                                             ? io.loadImage16(path.c_str(), rw, rh, rc)
+                                             : nullptr;
+                if (!loaded || rw != w || rh != h || rc != channels ||
+                    !std::equal(image.begin(), image.end(), loaded)) {
+                    std::cerr << "FAIL saveImage16/loadImage16 " << w << "x" << h << "x" << channels << std::endl;
+                    ++failures;
+                }
+                if (loaded) stbi_image_free(loaded);
+                std::filesystem::remove(path);
+            }
+        }
+
+        for (int channels : {1, 3, 4}) {
+            const int w = 37;
+            const int h = 23;
+            std::vector<float> image = random_native_image<float>(w, h, channels, static_cast<unsigned>(channels));
+            for (size_t i = 0; i < image.size(); ++i) {
+                image[i] *= (i % 5 == 0) ? 1000.f : 1.f;  // значения за пределами [0, 1]
+            }
+            const std::string path = (dir / ("regressionF_" + stamp + ".hdr")).string();
+            ++checks;
+            int rw = 0;
+            int rh = 0;
+            int rc = 0;
+            float* loaded = io.saveImageF(path.c_str(), w, h, channels, image.data())
+                                ? io.loadImageF(path.c_str(), rw, rh, rc)
+                                : nullptr;
+            bool ok = loaded && rw == w && rh == h && rc == 3;
+            for (size_t p = 0; ok && p < static_cast<size_t>(w) * h; ++p) {
+                const float* src = image.data() + p * channels;
+                const float rgb[3] = {src[0], src[channels >= 3 ? 1 : 0], src[channels >= 3 ? 2 : 0]};
+                const float limit = std::max({rgb[0], rgb[1], rgb[2]}) / 128.f;
+                for (int c = 0; c < 3; ++c) {
+                    ok = ok && std::abs(loaded[p * 3 + c] - rgb[c]) <= limit;
+                }
+            }
+            if (!ok) {
+                std::cerr << "FAIL saveImageF/loadImageF " << w << "x" << h << "x" << channels << std::endl;
+                ++failures;
+            }
+            if (loaded) stbi_image_free(loaded);
+            std::filesystem::remove(path);
+        }
+    }
+
+    // Медианный фильтр: сети сравнений (до 7x7) и гистограммы (9x9 и больше) точны
+    for (int size : {1, 3, 5, 7, 9, 15}) {
+        MedianFilter median(size);
+        for (const auto& [w, h] : {std::pair<int, int>{5, 4}, {17, 31}, {40, 23}, {101, 67}}) {
+            Image input = random_image(w, h, static_cast<unsigned>(size * 977 + w));
+            Image expected = median_reference(input, w, h, size);
+
+            ++checks;
+            if (median.process(input.data(), w, h) != expected) {
+                std::cerr << "FAIL MedianFilter(" << size << ") " << w << "x" << h << std::endl;
+                ++failures;
+            }
+            ++checks;
+            if (median.process_thread_pool(shared_pool, input.data(), w, h) != expected) {
+                std::cerr << "FAIL MedianFilter(" << size << ") thread_pool " << w << "x" << h << std::endl;
+                ++failures;
+            }
+        }
+    }
+
+    // Рекурсивная гауссиана: приближение, сравнение с точной сверткой по допускам
+    // (на шуме при малых sigma Young - van Vliet заметно отклоняется от гауссианы)
+    // на всем диапазоне 0.5..50; многопоточный вариант выполняет те же проходы
+    // и должен совпадать побитно. Ниже 0.5 коэффициенты неверны - конструктор бросает
+    for (float sigma : {0.3f, 0.0f, -1.0f}) {
+        ++checks;
+        try {
+            RecursiveGaussian iir(sigma);
+            std::cerr << "FAIL RecursiveGaussian(" << sigma << ") accepted sigma below 0.5" << std::endl;
+            ++failures;
+        } catch (const std::invalid_argument&) {
+        }
+    }
+    struct IirCase {
+        float sigma;
+        int max_error;
+        double mean_error;
+    };
+    for (const IirCase& ic : {IirCase{0.5f, 20, 5.0}, {1.0f, 16, 2.5}, {2.0f, 5, 0.7}, {3.5f, 2, 0.4}, {8.0f, 1, 0.3}, {50.0f, 4, 1.0}}) {
+        const float sigma = ic.sigma;
+        RecursiveGaussian iir(sigma);
+        for (const auto& [w, h] : {std::pair<int, int>{1, 1}, {6, 3}, {17, 31}, {101, 67}}) {
+            Image input = random_image(w, h, static_cast<unsigned>(sigma * 100 + w));
+            Image actual = iir.process(input.data(), w, h);
+            ErrorStats stats = compare(gaussian_reference(input, w, h, sigma), actual);
+
+            ++checks;
+            if (stats.max_error > ic.max_error || stats.mean_error > ic.mean_error) {
+                std::cerr << "FAIL RecursiveGaussian(" << sigma << ") " << w << "x" << h
+                          << ": max " << stats.max_error << ", mean " << stats.mean_error << std::endl;
+                ++failures;
+            }
+            ++checks;
+            if (iir.process_thread_pool(shared_pool, input.data(), w, h) != actual) {
+                std::cerr << "FAIL RecursiveGaussian(" << sigma << ") thread_pool " << w << "x" << h << std::endl;
+                ++failures;
+            }
+        }
+    }
+
+    // Гистограмма латентности и экспозиция Prometheus
+    for (const auto& [name, check] : {std::pair<const char*, std::string (*)()>{"buckets", check_histogram_buckets},
+                                      {"quantiles", check_histogram_quantiles},
+                                      {"expose_text", check_expose_text}}) {
+        ++checks;
+        if (const std::string error = check(); !error.empty()) {
+            std::cerr << "FAIL LatencyHistogram " << name << ": " << error << std::endl;
+            ++failures;
+        }
+    }
+
+    // Метрики process_SIMD: один замер свертки и один замер границ на кадр. process_region
+    // (полосы ProcessShardConvolver, плитки FrameStream) считает долю кадра и не пишет
+    // замеры, иначе полоса попала бы в гистограмму полного кадра SIMD
+    {
+        MetricsRegistry metrics;
+        const KernelCase kc = kernel_cases().front();
+        ImageConvolver convolver(kc.weights, kc.dim, kc.dim);
+        convolver.set_metrics(&metrics);
+        const int w = 96;
+        const int h = 64;
+        const Image input = random_image(w, h, 11);
+        const int bucket = MetricsRegistry::size_bucket(w, h);
+        auto samples = [&](MetricStage stage) {
+            return metrics.histogram(stage, MetricVariant::SIMD, bucket).snapshot().count;
+        };
+
+        Image strip(input.size());
+        convolver.process_region(input.data(), w, h, strip.data(), 0, 8, w, 24);
+        ++checks;
+        if (samples(MetricStage::Convolve) != 0 || samples(MetricStage::Border) != 0) {
+            std::cerr << "FAIL process_region recorded a full-frame SIMD sample" << std::endl;
+            ++failures;
+        }
+
+        convolver.process_SIMD(input.data(), w, h);
+        BufferPool pool;
+        convolver.process_SIMD(pool, input.data(), w, h);
+        ++checks;
+        if (samples(MetricStage::Convolve) != 2 || samples(MetricStage::Border) != 2) {
+            std::cerr << "FAIL process_SIMD samples: convolve " << samples(MetricStage::Convolve)
+                      << ", border " << samples(MetricStage::Border) << " (expected 2 and 2)" << std::endl;
+            ++failures;
+        }
+    }
+
+    // Трасса: две сессии Trace::start/stop на одном и том же пуле. Вторая сессия
+    // перерегистрирует буферы рабочих потоков, имена потоков при этом сохраняются
+    {
+        const KernelCase kc = kernel_cases().front();
+        ImageConvolver convolver(kc.weights, kc.dim, kc.dim);
+        const Image input = random_image(512, 256, 7);
+        Trace::set_thread_name("regression main");
+        const std::string stamp = std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+        const std::string path = (std::filesystem::temp_directory_path() / ("regression_trace_" + stamp + ".json")).string();
+        for (int session = 0; session < 2; ++session) {
+            Trace::start();
+            for (int i = 0; i < 4; ++i) {
+                convolver.process_thread_pool(shared_pool, input.data(), 512, 256);
+            }
+            Trace::stop();
+            ++checks;
+            const std::string error = Trace::write_json(path.c_str()) ? check_trace_json(path)
+                                                                     : std::string("write_json failed");
+            if (!error.empty()) {
+                std::cerr << "FAIL Trace session " << session << ": " << error << std::endl;
+                ++failures;
+            }
+        }
+        std::filesystem::remove(path);
+    }
+
+#if defined(__linux__)
+    // Убитый рабочий процесс: run() обязан завершиться исключением, а не ждать его
+    // вечно, деструктор - не зависнуть. Проверка под сторожевым таймером
+    auto killed_worker = std::async(std::launch::async, []() -> std::string {
+        const std::vector<float> kernel = gaussian_kernel(3);
+        ProcessShardConvolver sharded(kernel, 3, 3, 3);
+        Image input = random_image(64, 48, 7);
+        if (sharded.process(input.data(), 64, 48) != ImageConvolver(kernel, 3, 3).process_SIMD(input.data(), 64, 48)) {
+            return "differs from process_SIMD before the kill";
+        }
+        kill(sharded.worker_pids()[1], SIGKILL);
+        try {
+            sharded.process(input.data(), 64, 48);
+            return "run() did not throw after a worker was killed";
+        } catch (const std::runtime_error&) {
+        }
+        if (!sharded.worker_pids().empty()) {
+            return "surviving workers were not stopped";
+        }
+        try {
+            sharded.process(input.data(), 64, 48);
+            return "run() on a broken convolver did not throw";
+        } catch (const std::runtime_error&) {
+        }
+        return {};
+    });
+    ++checks;
+    if (killed_worker.wait_for(std::chrono::seconds(30)) != std::future_status::ready) {
+        std::cerr << "FAIL ProcessShardConvolver hangs after a worker was killed" << std::endl;
+        std::_Exit(1);
+    }
+    if (const std::string error = killed_worker.get(); !error.empty()) {
+        std::cerr << "FAIL ProcessShardConvolver killed worker: " << error << std::endl;
+        ++failures;
+    }
+
+    // Рабочие не смогли отобразить сегмент (имя удалено извне до первого run()): run()
+    // бросает, но объект остается рабочим, и следующий кадр идет через новый сегмент
+    {
+        const std::vector<float> kernel = gaussian_kernel(3);
+        ProcessShardConvolver sharded(kernel, 3, 3, 3);
+        const Image input = random_image(64, 48, 9);
+        const Image expected = ImageConvolver(kernel, 3, 3).process_SIMD(input.data(), 64, 48);
+        const std::string prefix = "blur_shard_" + std::to_string(getpid()) + "_";
+        auto segment_names = [&prefix]() {
+            std::set<std::string> names;
+            for (const auto& entry : std::filesystem::directory_iterator("/dev/shm")) {
+                const std::string name = entry.path().filename().string();
+                if (name.rfind(prefix, 0) == 0) names.insert(name);
+            }
+            return names;
+        };
+
+        const std::set<std::string> before = segment_names();
+        std::copy(input.begin(), input.end(), sharded.input_buffer(64, 48));
+        for (const std::string& name : segment_names()) {
+            if (before.count(name) == 0) shm_unlink(("/" + name).c_str());
+        }
+
+        ++checks;
+        std::string error;
+        try {
+            sharded.run();
+            error = "run() did not throw when workers could not map the segment";
+        } catch (const std::runtime_error&) {
+        }
+        try {
+            for (int frame = 0; error.empty() && frame < 2; ++frame) {
+                if (sharded.worker_pids().size() != 3) {
+                    error = "workers were stopped after a map failure";
+                } else if (sharded.process(input.data(), 64, 48) != expected) {
+                    error = "frame " + std::to_string(frame) + " after the failure differs from process_SIMD";
+                }
+            }
+        } catch (const std::runtime_error& e) {
+            error = std::string("frame after the failure threw: ") + e.what();
+        }
+        if (!error.empty()) {
+            std::cerr << "FAIL ProcessShardConvolver map failure: " << error << std::endl;
+            ++failures;
+        }
+    }
+#endif
+
+#if !defined(_WIN32)
+    daemon_client.reset();
+    daemon.stop();
+    daemon_thread.join();
+#endif
+
+    std::cout << "Regression checks: " << checks << ", failures: " << failures << std::endl;
+    return failures == 0 ? 0 : 1;
+}
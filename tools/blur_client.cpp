@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "blur_client.h"
+
+// Клиент демона: blur_client <socket> <input> <output> [kernel_dim]
+// Файлы читает и пишет сам демон, поэтому пути должны быть доступны ему.
+
+namespace {
+
+std::vector<float> gaussian_kernel(int dim) {
+    std::vector<float> k(static_cast<size_t>(dim) * dim);
+    const float sigma = std::max(dim / 6.0f, 1.0f);
+    const int half = dim / 2;
+    float sum = 0.0f;
+    for (int y = -half; y <= half; ++y) {
+        for (int x = -half; x <= half; ++x) {
+            float val = std::exp(-(x * x + y * y) / (2 * sigma * sigma));
+            k[(y + half) * dim + (x + half)] = val;
+            sum += val;
+        }
+    }
+    for (float& v : k) v /= sum;
+    return k;
+}
+
+const char* status_name(BlurJobStatus status) {
+    switch (status) {
+        case BlurJobStatus::Ok:
+            return "ok";
+        case BlurJobStatus::BadRequest:
+            return "bad request";
+        case BlurJobStatus::LoadFailed:
+            return "load failed";
+        case BlurJobStatus::SaveFailed:
+            return "save failed";
+        case BlurJobStatus::MapFailed:
+            return "map failed";
+    }
+    return "unknown";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " <socket> <input> <output> [kernel_dim]" << std::endl;
+        return 1;
+    }
+    const int dim = argc > 4 ? std::atoi(argv[4]) : 3;
+
+    try {
+        BlurClient client(argv[1]);
+        BlurJobReply reply = client.blur_file(gaussian_kernel(dim), dim, argv[2], argv[3]);
+        if (reply.status != BlurJobStatus::Ok) {
+            std::cerr << "Job failed: " << status_name(reply.status) << std::endl;
+            return 1;
+        }
+        std::cout << reply.w << "x" << reply.h << " -> " << argv[3]
+                  << " (queue " << reply.queue_ns / 1000 << " us, service " << reply.service_ns / 1000
+                  << " us, batch " << reply.batch_size << ")" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
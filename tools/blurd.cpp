@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "blur_daemon.h"
+
+// Демон свертки: blurd <socket> [threads] [max_batch]
+// Завершается по SIGINT/SIGTERM.
+
+namespace {
+
+BlurDaemon* g_daemon = nullptr;
+
+void handle_signal(int) {
+    if (g_daemon) {
+        g_daemon->stop();
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <socket> [threads] [max_batch]" << std::endl;
+        return 1;
+    }
+
+    BlurDaemon::Options options;
+    options.socket_path = argv[1];
+    if (argc > 2) {
+        options.threads = static_cast<size_t>(std::strtoul(argv[2], nullptr, 10));
+    }
+    if (argc > 3) {
+        options.max_batch = std::max<size_t>(std::strtoul(argv[3], nullptr, 10), 1);
+    }
+
+    try {
+        BlurDaemon daemon(options);
+        g_daemon = &daemon;
+        std::signal(SIGINT, handle_signal);
+        std::signal(SIGTERM, handle_signal);
+
+        std::cout << "blurd listening on " << options.socket_path << std::endl;
+        daemon.run();
+        g_daemon = nullptr;
+
+        BlurDaemon::Stats stats = daemon.stats();
+        std::cout << "jobs: " << stats.jobs << ", batches: " << stats.batches
+                  << ", kernel cache hits: " << stats.kernel_cache_hits
+                  << ", misses: " << stats.kernel_cache_misses << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}